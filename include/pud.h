@@ -155,9 +155,35 @@ typedef enum
 typedef enum
 {
    PUD_PIXEL_FORMAT_RGBA, /**< Pixels are 8 bits each, RGBA ordered */
-   PUD_PIXEL_FORMAT_ARGB, /**< Pixels are 8 bits each, ARGB ordered */
+   PUD_PIXEL_FORMAT_ARGB, /**< Pixels are 8 bits each, ARGB ordered as
+                            32-bits little-endian words (B, G, R, A in
+                            memory, like cairo) */
+   PUD_PIXEL_FORMAT_BGRA, /**< Pixels are 8 bits each, BGRA ordered in
+                            memory (the same bytes as
+                            #PUD_PIXEL_FORMAT_ARGB) */
+   PUD_PIXEL_FORMAT_RGB, /**< Pixels are 8 bits each, RGB ordered,
+                           without alpha (3 bytes per pixel) */
+   PUD_PIXEL_FORMAT_RGB565, /**< Pixels are 16-bits native words, with 5
+                              bits of red (most significant), 6 bits of
+                              green and 5 bits of blue */
 } Pud_Pixel_Format;
 
+/**
+ * @typedef Pud_Minimap_Render_Flags
+ * Flags that alter how minimaps are rendered
+ * @see pud_minimap_render()
+ * @since 1.0.0
+ */
+typedef enum
+{
+   PUD_MINIMAP_RENDER_DEFAULT  = 0,        /**< Tiles and units, box-filtered
+                                             when downscaling */
+   PUD_MINIMAP_RENDER_NO_UNITS = (1 << 0), /**< Only render the tiles */
+   PUD_MINIMAP_RENDER_NEAREST  = (1 << 1)  /**< Pick the nearest tile
+                                             instead of averaging them when
+                                             downscaling */
+} Pud_Minimap_Render_Flags;
+
 /**
  * @typedef Pud_Player
  * Type that holds a player ID
@@ -979,6 +1005,63 @@ typedef struct
    uint16_t obsolete_udta[508]; /**< Obsolete data in the UDTA section */
 } Pud;
 
+/**
+ * Describes a rectangular area of a map, in cells
+ * @since 1.0.0
+ */
+typedef struct
+{
+   unsigned int x; /**< X coordinate of the top-left cell */
+   unsigned int y; /**< Y coordinate of the top-left cell */
+   unsigned int w; /**< Width of the area */
+   unsigned int h; /**< Height of the area */
+} Pud_Rect;
+
+/**
+ * @typedef Pud_Change_Type
+ * Kinds of modifications notified to change callbacks
+ * @see pud_change_callback_add()
+ * @since 1.0.0
+ */
+typedef enum
+{
+   PUD_CHANGE_TILE      = 0, /**< Tiles were set */
+   PUD_CHANGE_UNIT_ADD  = 1, /**< A unit was added */
+   PUD_CHANGE_UNIT_DEL  = 2, /**< A unit was removed */
+   PUD_CHANGE_UNIT_MOVE = 3, /**< A unit was moved */
+} Pud_Change_Type;
+
+/**
+ * Describes a modification of a Pud file
+ * @since 1.0.0
+ */
+typedef struct
+{
+   Pud_Change_Type type; /**< What happened */
+   unsigned int    x; /**< X coordinate of the first modified cell */
+   unsigned int    y; /**< Y coordinate of the first modified cell */
+   unsigned int    w; /**< Width (in cells) of the modified area */
+   unsigned int    h; /**< Height (in cells) of the modified area */
+   unsigned int    unit; /**< For unit changes, index of the unit in the
+                           @c units array of the Pud. For removals, the
+                           index the unit had */
+   unsigned int    from_x; /**< For moves, former X coordinate of the unit */
+   unsigned int    from_y; /**< For moves, former Y coordinate of the unit */
+   const Pud_Unit_Info *info; /**< For unit changes, the unit. For
+                                removals, a copy of the removed unit that
+                                is only valid during the callback */
+} Pud_Change;
+
+/**
+ * @typedef Pud_Change_Cb
+ * Callback called after a Pud file has been modified
+ * @param data User data
+ * @param pud The modified Pud
+ * @param change The description of the modification
+ * @since 1.0.0
+ */
+typedef void (*Pud_Change_Cb)(void *data, Pud *pud, const Pud_Change *change);
+
 /**
  * Type that holds a 32-bits color
  * @since 1.0.0
@@ -1470,6 +1553,22 @@ PUDAPI Pud_Side pud_unit_side_get(Pud_Unit unit);
  */
 PUDAPI uint8_t pud_random_tile_get(uint16_t tile_base);
 
+/**
+ * Randomize the variations of the tiles of a Pud
+ *
+ * The 4 least significant bits of each tile are replaced by a random,
+ * VALID variation, like pud_random_tile_get() does. The random numbers
+ * do not come from the libc generator: the result only depends on
+ * @p seed. Tiles that have no valid variations are left untouched.
+ *
+ * @param pud A valid pud handle
+ * @param seed The seed of the random numbers
+ * @param region The area to randomize. NULL for the whole map.
+ * @return PUD_TRUE on success, PUD_FALSE on failure
+ * @since 1.0.0
+ */
+PUDAPI Pud_Bool pud_tiles_randomize(Pud *pud, uint32_t seed, const Pud_Rect *region);
+
 /**
  * Get the icon of a given unit
  *
@@ -1763,6 +1862,155 @@ PUDAPI uint16_t pud_tile_get(const Pud *pud, unsigned int x, unsigned int y);
  */
 PUDAPI Pud_Bool pud_unit_add(Pud *pud, unsigned int x, unsigned int y, Pud_Player player, Pud_Unit unit, uint16_t alter);
 
+/**
+ * Add several units in the Pud at once
+ *
+ * This is equivalent to calling pud_unit_add() for each unit, but the
+ * units array is grown only once. The coordinates of all the units are
+ * checked first: if one of them is out of the map, no unit is added.
+ *
+ * @param pud A valid pud handle
+ * @param units The units to add
+ * @param count The number of units in @p units
+ * @return PUD_TRUE on success, PUD_FALSE on failure
+ * @see pud_units_reserve()
+ * @since 1.0.0
+ */
+PUDAPI Pud_Bool pud_units_add_array(Pud *pud, const Pud_Unit_Info *units, unsigned int count);
+
+/**
+ * Reserve room for units in the Pud
+ *
+ * Units can then be added without the units array being reallocated,
+ * until the Pud holds @p count units.
+ *
+ * @param pud A valid pud handle
+ * @param count The total number of units the Pud will hold
+ * @return PUD_TRUE on success, PUD_FALSE on failure
+ * @since 1.0.0
+ */
+PUDAPI Pud_Bool pud_units_reserve(Pud *pud, unsigned int count);
+
+/**
+ * Remove a unit from the Pud
+ *
+ * This is done in constant time: the last unit of the @c units array
+ * takes the place of the removed one, and is notified to the change
+ * callbacks as a #PUD_CHANGE_UNIT_MOVE to the cell it already occupies.
+ * The other units keep their index.
+ *
+ * @param pud A valid pud handle
+ * @param index The index of the unit in the @c units array of the Pud
+ * @return PUD_TRUE on success, PUD_FALSE on failure
+ * @since 1.0.0
+ */
+PUDAPI Pud_Bool pud_unit_remove(Pud *pud, unsigned int index);
+
+/**
+ * Enable or disable the occupancy grid of the units of a Pud
+ *
+ * The grid indexes the units by the cells their footprint covers (given
+ * by the @c size_w and @c size_h of their @c units_descr), so that
+ * pud_units_at(), pud_units_in_rect() and pud_footprint_free() do not
+ * have to go through all the units. It is kept up to date by
+ * pud_unit_add(), pud_units_add_array(), pud_unit_remove() and
+ * pud_unit_move(). Direct modifications of the units of the Pud, or of
+ * their descriptions, require the grid to be enabled again.
+ *
+ * @param pud A valid pud handle
+ * @param enable PUD_TRUE to build the grid, PUD_FALSE to free it
+ * @return PUD_TRUE on success, PUD_FALSE on failure
+ * @since 1.0.0
+ */
+PUDAPI Pud_Bool pud_units_grid_enable(Pud *pud, Pud_Bool enable);
+
+/**
+ * Get the units that occupy a given cell
+ *
+ * @param pud A valid pud handle
+ * @param x The X coordinate of the cell
+ * @param y The Y coordinate of the cell
+ * @param indexes Stores the indexes of the units, in no particular order.
+ * May be NULL.
+ * @param max The maximum number of indexes stored in @p indexes
+ * @return The number of units that occupy the cell, which may be greater
+ * than @p max
+ * @see pud_units_grid_enable()
+ * @since 1.0.0
+ */
+PUDAPI unsigned int pud_units_at(const Pud *pud, unsigned int x, unsigned int y, unsigned int *indexes, unsigned int max);
+
+/**
+ * Get the units whose footprint intersects an area of the map
+ *
+ * @param pud A valid pud handle
+ * @param rect The area of the map
+ * @param indexes Stores the indexes of the units, in no particular order.
+ * May be NULL.
+ * @param max The maximum number of indexes stored in @p indexes
+ * @return The number of units in the area, which may be greater than
+ * @p max
+ * @see pud_units_grid_enable()
+ * @since 1.0.0
+ */
+PUDAPI unsigned int pud_units_in_rect(const Pud *pud, const Pud_Rect *rect, unsigned int *indexes, unsigned int max);
+
+/**
+ * Check that an area of the map is free of units
+ *
+ * This is what placing a new building requires.
+ *
+ * @param pud A valid pud handle
+ * @param rect The area of the map
+ * @return PUD_TRUE if @p rect is within the map and no unit occupies it,
+ * PUD_FALSE otherwise
+ * @see pud_units_grid_enable()
+ * @since 1.0.0
+ */
+PUDAPI Pud_Bool pud_footprint_free(const Pud *pud, const Pud_Rect *rect);
+
+/**
+ * Move a unit of the Pud
+ *
+ * The top-left coordinate of the unit will be placed at @c x, @c y.
+ *
+ * @param pud A valid pud handle
+ * @param index The index of the unit in the @c units array of the Pud
+ * @param x The new X coordinate of the unit
+ * @param y The new Y coordinate of the unit
+ * @return PUD_TRUE on success, PUD_FALSE on failure
+ * @since 1.0.0
+ */
+PUDAPI Pud_Bool pud_unit_move(Pud *pud, unsigned int index, unsigned int x, unsigned int y);
+
+/**
+ * Register a callback to be notified of the modifications of a Pud
+ *
+ * Callbacks are called, in the order they were added, after
+ * pud_tile_set(), pud_tiles_randomize(), pud_unit_add(), pud_unit_remove()
+ * and pud_unit_move() have modified the Pud. Direct modifications of the
+ * fields of the Pud are not notified.
+ *
+ * @param pud A valid pud handle
+ * @param cb The callback to be called
+ * @param data The data to be passed to @p cb
+ * @return PUD_TRUE on success, PUD_FALSE on failure
+ * @see pud_change_callback_del()
+ * @since 1.0.0
+ */
+PUDAPI Pud_Bool pud_change_callback_add(Pud *pud, Pud_Change_Cb cb, const void *data);
+
+/**
+ * Unregister a callback added with pud_change_callback_add()
+ *
+ * @param pud A valid pud handle
+ * @param cb The callback to be removed
+ * @param data The data it was added with
+ * @return PUD_TRUE if the callback was found, PUD_FALSE otherwise
+ * @since 1.0.0
+ */
+PUDAPI Pud_Bool pud_change_callback_del(Pud *pud, Pud_Change_Cb cb, const void *data);
+
 /**
  * Get the side of a player in a given Pud file
  *
@@ -1860,6 +2108,114 @@ PUDAPI Pud_Color pud_minimap_color_for_unit(Pud_Unit unit, Pud_Player player);
  */
 PUDAPI unsigned char *pud_minimap_bitmap_generate(const Pud *pud, unsigned int *size_ret, Pud_Pixel_Format pfmt);
 
+/**
+ * Render the minimap of a given Pud in a caller-provided bitmap
+ *
+ * The minimap can be rendered at any size: when @p dst_w (or @p dst_h) is
+ * smaller than the map, each pixel is the average of the tiles it covers
+ * (box filter). When it is larger, each pixel has the color of its
+ * nearest tile. Units are not averaged: they fill every pixel that
+ * covers a part of their footprint, which is clipped to the map. Nothing
+ * is allocated.
+ *
+ * @param pud A valid pud handle
+ * @param dst The bitmap to render into, at least @p stride * @p dst_h
+ *            bytes big
+ * @param dst_w The width of @p dst, in pixels
+ * @param dst_h The height of @p dst, in pixels
+ * @param stride The size in bytes of a row of @p dst. 0 means rows are
+ *               packed (@p dst_w * pud_pixel_format_size_get(@p pfmt))
+ * @param pfmt The pixel format of @p dst
+ * @param flags Rendering flags
+ * @return PUD_TRUE on success, PUD_FALSE on failure
+ * @see pud_minimap_bitmap_generate()
+ * @since 1.0.0
+ */
+PUDAPI Pud_Bool pud_minimap_render(const Pud *pud, unsigned char *dst, unsigned int dst_w, unsigned int dst_h, unsigned int stride, Pud_Pixel_Format pfmt, Pud_Minimap_Render_Flags flags);
+
+/**
+ * Get the size of a pixel in a given pixel format
+ *
+ * @param pfmt A pixel format
+ * @return The size in bytes of a pixel, 0 if @p pfmt is invalid
+ * @since 1.0.0
+ */
+PUDAPI unsigned int pud_pixel_format_size_get(Pud_Pixel_Format pfmt);
+
+/**
+ * @typedef Pud_Minimap
+ * Opaque type of a live minimap, which follows the modifications of a Pud
+ * @see pud_minimap_new()
+ * @since 1.0.0
+ */
+typedef struct _Pud_Minimap Pud_Minimap;
+
+/**
+ * Create a live minimap of a Pud
+ *
+ * The minimap has one pixel per tile. It is rendered once, then kept up
+ * to date by repainting only the cells modified by pud_tile_set(),
+ * pud_tiles_randomize(), pud_unit_add(), pud_unit_remove() and
+ * pud_unit_move(), including the tiles uncovered by a removed or moved
+ * unit. Other modifications (such
+ * as pud_era_set()) require a call to pud_minimap_refresh().
+ *
+ * The minimap must be freed before @p pud is closed.
+ *
+ * @param pud A valid pud handle
+ * @param pfmt The pixel format of the minimap
+ * @return The minimap. NULL on failure.
+ * @see pud_minimap_free()
+ * @since 1.0.0
+ */
+PUDAPI Pud_Minimap *pud_minimap_new(Pud *pud, Pud_Pixel_Format pfmt);
+
+/**
+ * Free a live minimap
+ *
+ * @param mm A minimap created by pud_minimap_new(). May be NULL.
+ * @since 1.0.0
+ */
+PUDAPI void pud_minimap_free(Pud_Minimap *mm);
+
+/**
+ * Get the pixels of a live minimap
+ *
+ * The bitmap holds @c map_w x @c map_h pixels and remains valid until
+ * @p mm is freed.
+ *
+ * @param mm A valid minimap
+ * @param stride Stores the size in bytes of a row. Ignored if NULL.
+ * @return The pixels of the minimap. NULL on failure.
+ * @since 1.0.0
+ */
+PUDAPI const unsigned char *pud_minimap_pixels_get(const Pud_Minimap *mm, unsigned int *stride);
+
+/**
+ * Get the area of a live minimap repainted since the last call
+ *
+ * This allows to upload only the modified pixels. The area is reset by
+ * each call.
+ *
+ * @param mm A valid minimap
+ * @param x Stores the X coordinate of the area. Ignored if NULL.
+ * @param y Stores the Y coordinate of the area. Ignored if NULL.
+ * @param w Stores the width of the area. Ignored if NULL.
+ * @param h Stores the height of the area. Ignored if NULL.
+ * @return PUD_TRUE if pixels were repainted, PUD_FALSE otherwise
+ * @since 1.0.0
+ */
+PUDAPI Pud_Bool pud_minimap_damage_get(Pud_Minimap *mm, unsigned int *x, unsigned int *y, unsigned int *w, unsigned int *h);
+
+/**
+ * Repaint a whole live minimap
+ *
+ * @param mm A valid minimap
+ * @return PUD_TRUE on success, PUD_FALSE on failure
+ * @since 1.0.0
+ */
+PUDAPI Pud_Bool pud_minimap_refresh(Pud_Minimap *mm);
+
 /**
  * @}
  */ /* End of Pud_Minimap group */
@@ -29,6 +29,7 @@
 #include <string.h>
 #include <errno.h>
 #include <stdint.h>
+#include <limits.h>
 #include <setjmp.h>
 #include <time.h>
 
@@ -37,6 +38,18 @@
 
 #include "common.h"
 
+/* Entries of the dense minimap tables: all the tiles IDs of the tilesets
+ * fit below, see pud_minimap_lut_get() */
+#define PUD_MINIMAP_LUT_SIZE 0x0a00
+
+typedef struct _Pud_Grid Pud_Grid;
+
+typedef struct
+{
+   Pud_Change_Cb  cb;
+   void          *data;
+} Pud_Change_Callback;
+
 struct _Pud_Private
 {
    Pud_Open_Mode  open_mode;
@@ -55,6 +68,18 @@ struct _Pud_Private
    Pud_Bool default_allow; /* [defaults] */
    Pud_Bool default_udta; /* [defaults] */
    Pud_Bool default_ugrd; /* [defaults] */
+
+   /* Capacity of the units array */
+   unsigned int units_alloc;
+
+   /* Occupancy grid of the units, NULL when disabled (see grid.c) */
+   Pud_Grid *grid;
+
+   /* Observers of the modifications */
+   Pud_Change_Callback *change_cbs;
+   unsigned int         change_cbs_count;
+   unsigned int         change_emitting; /* Depth of nested emissions */
+   Pud_Bool             change_cbs_removed; /* Cleared slots to compact */
 };
 
 /* Visual hint when returning nothing */
@@ -102,6 +127,16 @@ PUDAPI_INTERNAL const char *long2bin(uint32_t x);
 PUDAPI_INTERNAL Pud_Color color_make(uint8_t r, uint8_t g, uint8_t b, uint8_t a);
 PUDAPI_INTERNAL const char *mode2str(Pud_Open_Mode mode);
 PUDAPI_INTERNAL uint32_t pud_go_to_section(Pud *pud, Pud_Section sec);
+PUDAPI_INTERNAL uint32_t pud_minimap_color_pack(Pud_Color c, Pud_Pixel_Format pfmt);
+PUDAPI_INTERNAL const uint32_t *pud_minimap_lut_get(Pud_Era era, Pud_Pixel_Format pfmt, unsigned int *handled);
+PUDAPI_INTERNAL void pud_change_emit(Pud *pud, const Pud_Change *change);
+PUDAPI_INTERNAL void pud_unit_footprint_get(const Pud *pud, const Pud_Unit_Info *u, unsigned int *w, unsigned int *h);
+PUDAPI_INTERNAL Pud_Bool pud_grid_build(Pud *pud);
+PUDAPI_INTERNAL void pud_grid_free(Pud *pud);
+PUDAPI_INTERNAL Pud_Bool pud_grid_reserve(Pud *pud, unsigned int count);
+PUDAPI_INTERNAL void pud_grid_unit_add(Pud *pud, unsigned int index);
+PUDAPI_INTERNAL void pud_grid_unit_move(Pud *pud, unsigned int index, const Pud_Unit_Info *from);
+PUDAPI_INTERNAL void pud_grid_unit_remove(Pud *pud, unsigned int index, const Pud_Unit_Info *removed, unsigned int last);
 
 
 #endif /* ! _PRIVATE_H_ */
@@ -68,6 +68,88 @@ typedef enum
    WAR2_SPRITES_SYSTEM    = 0x103  /**< System sprites (i.e. start locations) */
 } War2_Sprites;
 
+/**
+ * @typedef War2_Sprites_Decode_Flags
+ * Flags that alter how sprites are decoded
+ * @since 1.0.0
+ */
+typedef enum
+{
+   WAR2_SPRITES_DECODE_NONE      = 0,        /**< Plain decoding */
+   WAR2_SPRITES_DECODE_FLIP_X    = (1 << 0), /**< Mirror frames horizontally */
+   WAR2_SPRITES_DECODE_MASK      = (1 << 1), /**< Provide the opacity mask of frames */
+   WAR2_SPRITES_DECODE_NO_PIXELS = (1 << 2), /**< Do not decode pixels (the bitmap will be NULL) */
+   WAR2_SPRITES_DECODE_TRIM      = (1 << 3), /**< Crop frames (and masks) to the bounding box of their opaque pixels */
+   WAR2_SPRITES_DECODE_INDEXED   = (1 << 4)  /**< Provide the palette indexes of frames instead of their bitmap (which will be NULL) */
+} War2_Sprites_Decode_Flags;
+
+/**
+ * Type that holds a 1-bit per pixel opacity mask
+ *
+ * Bit @c x of row @c y is stored in the byte @c (y * stride + x / 8),
+ * at position @c (x % 8) (least significant bit first).
+ * @see war2_mask_hit()
+ * @since 1.0.0
+ */
+typedef struct
+{
+   unsigned int   w; /**< Width of the mask */
+   unsigned int   h; /**< Height of the mask */
+   unsigned int   stride; /**< Size in bytes of a row */
+   unsigned char *bits; /**< The bits, set for opaque pixels */
+} War2_Mask;
+
+/**
+ * @def WAR2_PLAYERS_MASK_ALL
+ * Player mask that selects the 8 players
+ * @see war2_sprites_decode_multi()
+ * @since 1.0.0
+ */
+#define WAR2_PLAYERS_MASK_ALL 0xff
+
+/**
+ * @def WAR2_ERA_MASK
+ * Era mask that selects the era @p era
+ * @see war2_tileset_decode_parallel()
+ * @since 1.0.0
+ */
+#define WAR2_ERA_MASK(era) (1u << (era))
+
+/**
+ * @def WAR2_ERA_MASK_ALL
+ * Era mask that selects the 4 eras
+ * @see war2_tileset_decode_parallel()
+ * @since 1.0.0
+ */
+#define WAR2_ERA_MASK_ALL 0x0f
+
+/**
+ * @def WAR2_PYRAMID_TILE_SIZE
+ * The width and height of the tiles of a map pyramid, in pixels
+ * @see war2_map_pyramid_render()
+ * @since 1.0.0
+ */
+#define WAR2_PYRAMID_TILE_SIZE 256
+
+/**
+ * @typedef War2_Direction
+ * The 8 directions a unit can face. Only the directions from north to
+ * south (clockwise) are stored in the data file. The others are mirrors.
+ * @see war2_sprites_frame_for_direction()
+ * @since 1.0.0
+ */
+typedef enum
+{
+   WAR2_DIRECTION_NORTH      = 0, /**< North */
+   WAR2_DIRECTION_NORTH_EAST = 1, /**< North East */
+   WAR2_DIRECTION_EAST       = 2, /**< East */
+   WAR2_DIRECTION_SOUTH_EAST = 3, /**< South East */
+   WAR2_DIRECTION_SOUTH      = 4, /**< South */
+   WAR2_DIRECTION_SOUTH_WEST = 5, /**< South West (mirror of South East) */
+   WAR2_DIRECTION_WEST       = 6, /**< West (mirror of East) */
+   WAR2_DIRECTION_NORTH_WEST = 7  /**< North West (mirror of North East) */
+} War2_Direction;
+
 /**
  * Type that holds information about a current tileset decoding
  * @since 1.0.0
@@ -122,9 +204,244 @@ typedef struct
    Pud_Side     side; /**< Side (when appliable) */
    unsigned int object; /**< Decoded object */
    War2_Sprites sprite_type; /**< Sprite type */
+   War2_Sprites_Decode_Flags flags; /**< Flags used for the decoding */
+   const War2_Mask *mask; /**< Opacity mask of the current frame if
+                            #WAR2_SPRITES_DECODE_MASK was requested,
+                            NULL otherwise. Only valid within the
+                            callback. @see war2_mask_dup() */
+   unsigned int bbox_x; /**< X of the bounding box of the opaque pixels
+                          of the current frame, within the stored frame.
+                          With #WAR2_SPRITES_DECODE_FLIP_X, the frame is
+                          stored mirrored, and so is the box: it is
+                          measured from the left edge of the mirrored
+                          frame */
+   unsigned int bbox_y; /**< Y of the bounding box of the opaque pixels */
+   unsigned int bbox_w; /**< Width of the bounding box (0 if the frame
+                          is fully transparent) */
+   unsigned int bbox_h; /**< Height of the bounding box (0 if the frame
+                          is fully transparent) */
+   const unsigned char *indexes; /**< Palette indexes of the current frame
+                                   (one byte per pixel, 0 is transparent)
+                                   if #WAR2_SPRITES_DECODE_INDEXED was
+                                   requested, NULL otherwise. Only valid
+                                   within the callback. */
+   const Pud_Color *palette; /**< Palette of #WAR2_PALETTE_SIZE colors of
+                               the current frame, colorized for the
+                               current player. Only valid within the
+                               callback. */
 } War2_Sprites_Descriptor;
 
 
+/**
+ * @typedef War2_Tileset
+ * Opaque type that holds the tileset of an era in its native form
+ * @see war2_tileset_open()
+ * @since 1.0.0
+ */
+typedef struct _War2_Tileset War2_Tileset;
+
+/**
+ * Type that references a minitile within a tile.
+ * A tile (32x32) is made of 4x4 minitiles (8x8), possibly flipped.
+ * @since 1.0.0
+ */
+typedef struct
+{
+   uint16_t minitile; /**< Index of the minitile in the minitiles bank */
+   uint8_t  flip_x; /**< Non-zero if the minitile is mirrored horizontally */
+   uint8_t  flip_y; /**< Non-zero if the minitile is mirrored vertically */
+} War2_Minitile_Ref;
+
+/**
+ * @typedef War2_Atlas
+ * Opaque type that packs several bitmaps into a single one
+ * @see war2_atlas_new()
+ * @since 1.0.0
+ */
+typedef struct _War2_Atlas War2_Atlas;
+
+/**
+ * Type that holds the location of a frame within an atlas
+ * @since 1.0.0
+ */
+typedef struct
+{
+   unsigned int id; /**< User identifier of the frame */
+   unsigned int x; /**< X position of the frame in the atlas */
+   unsigned int y; /**< Y position of the frame in the atlas */
+   unsigned int w; /**< Width of the frame */
+   unsigned int h; /**< Height of the frame */
+   int origin_x; /**< X origin of the frame (e.g. sprite offset) */
+   int origin_y; /**< Y origin of the frame (e.g. sprite offset) */
+} War2_Atlas_Rect;
+
+/**
+ * @typedef War2_Png_Writer
+ * Opaque type that writes a PNG image row by row
+ * @see war2_png_writer_new()
+ * @since 1.0.0
+ */
+typedef struct _War2_Png_Writer War2_Png_Writer;
+
+/**
+ * Growable memory buffer that image encoders append to
+ *
+ * A zeroed buffer is empty and ready to be used. Its content is released
+ * by war2_buffer_free().
+ * @since 1.0.0
+ */
+typedef struct
+{
+   unsigned char *data; /**< The bytes held by the buffer */
+   size_t         size; /**< How many bytes of @c data are used */
+   size_t         alloc; /**< How many bytes @c data can hold */
+} War2_Buffer;
+
+/**
+ * @typedef War2_Ppm_Format
+ * Flavours of the PPM format
+ * @since 1.0.0
+ */
+typedef enum
+{
+   WAR2_PPM_FORMAT_BINARY = 0, /**< P6: raw RGB bytes */
+   WAR2_PPM_FORMAT_ASCII  = 1, /**< P3: RGB values as decimal text */
+} War2_Ppm_Format;
+
+/**
+ * @typedef War2_Encoder
+ * Opaque type that encodes images of one format, and keeps its state
+ * from one image to the next
+ * @see war2_encoder_new()
+ * @since 1.0.0
+ */
+typedef struct _War2_Encoder War2_Encoder;
+
+/**
+ * @typedef War2_Encoder_Format
+ * Image formats an encoder can produce
+ * @since 1.0.0
+ */
+typedef enum
+{
+   WAR2_ENCODER_FORMAT_PNG  = 0, /**< PNG, with alpha */
+   WAR2_ENCODER_FORMAT_JPEG = 1, /**< JPEG, alpha is dropped */
+   WAR2_ENCODER_FORMAT_PPM  = 2, /**< PPM, alpha is dropped */
+} War2_Encoder_Format;
+
+/**
+ * @typedef War2_Png_Filter
+ * Filters applied to the rows of a PNG image before compression
+ * @since 1.0.0
+ */
+typedef enum
+{
+   WAR2_PNG_FILTER_ADAPTIVE = 0, /**< libpng picks the best filter of each
+                                   row. Smallest, but slowest. */
+   WAR2_PNG_FILTER_NONE     = 1, /**< No filter. Fastest. */
+   WAR2_PNG_FILTER_SUB      = 2, /**< Difference with the left pixel */
+   WAR2_PNG_FILTER_UP       = 3, /**< Difference with the pixel above */
+   WAR2_PNG_FILTER_AVG      = 4, /**< Difference with the mean of the left
+                                   and above pixels */
+   WAR2_PNG_FILTER_PAETH    = 5, /**< Paeth predictor */
+} War2_Png_Filter;
+
+/**
+ * @typedef War2_Jpeg_Dct
+ * DCT implementations of the JPEG encoder
+ * @since 1.0.0
+ */
+typedef enum
+{
+   WAR2_JPEG_DCT_ISLOW = 0, /**< Accurate integer DCT */
+   WAR2_JPEG_DCT_IFAST = 1, /**< Fast, less accurate integer DCT */
+   WAR2_JPEG_DCT_FLOAT = 2, /**< Floating-point DCT */
+} War2_Jpeg_Dct;
+
+/**
+ * Options of an encoder. Only the options of its format are used.
+ * A zeroed structure holds the defaults.
+ * @see war2_encoder_new()
+ * @since 1.0.0
+ */
+typedef struct
+{
+   unsigned int    png_level; /**< zlib compression level, from 1 (fastest)
+                                to 9 (smallest). 0 means the zlib default */
+   War2_Png_Filter png_filter; /**< Filter of the rows */
+   unsigned int    jpeg_quality; /**< From 1 to 100. 0 means 100 */
+   War2_Jpeg_Dct   jpeg_dct; /**< DCT implementation */
+   War2_Ppm_Format ppm_format; /**< Binary or ASCII */
+} War2_Encoder_Options;
+
+/**
+ * @typedef War2_Viewport
+ * Opaque type that keeps the visible area of a map rendered, and only
+ * renders again what changed
+ * @see war2_viewport_new()
+ * @since 1.0.0
+ */
+typedef struct _War2_Viewport War2_Viewport;
+
+/**
+ * Options of the map renderer
+ * @see war2_map_render()
+ * @since 1.0.0
+ */
+typedef struct
+{
+   unsigned int strip_rows; /**< Rows of tiles per strip. 0 means 4 */
+   unsigned int nthreads; /**< Threads rendering strips. 0 means one
+                            per online CPU */
+   Pud_Bool     units; /**< Whether units are rendered over the tiles */
+} War2_Map_Render_Options;
+
+/**
+ * @typedef War2_Map_Rows_Func
+ * Callback that receives the rows of a rendered map, strip by strip
+ * @param data User provided data
+ * @param rows @p count rows of @p w pixels, one after the other
+ * @param w The width of the map in pixels
+ * @param y The index of the first row of @p rows
+ * @param count How many rows are provided
+ * @return PUD_TRUE to continue, PUD_FALSE to abort the rendering
+ * @since 1.0.0
+ */
+typedef Pud_Bool (*War2_Map_Rows_Func)(void            *data,
+                                       const Pud_Color *rows,
+                                       unsigned int     w,
+                                       unsigned int     y,
+                                       unsigned int     count);
+
+/**
+ * Destination of a rendered map
+ * @see war2_map_render()
+ * @since 1.0.0
+ */
+typedef struct
+{
+   War2_Map_Rows_Func  rows; /**< Called for each strip, top to bottom */
+   void               *data; /**< Data passed to @c rows */
+} War2_Map_Sink;
+
+/**
+ * @typedef War2_Pyramid_Tile_Func
+ * Callback that receives the tiles of a map pyramid
+ * @param data User provided data
+ * @param tile A bitmap of #WAR2_PYRAMID_TILE_SIZE by #WAR2_PYRAMID_TILE_SIZE
+ *             pixels. What lies past the map is transparent.
+ * @param level The zoom level of the tile. 0 is the coarsest.
+ * @param x The column of the tile in its level
+ * @param y The row of the tile in its level
+ * @return PUD_TRUE to continue, PUD_FALSE to abort the rendering
+ * @since 1.0.0
+ */
+typedef Pud_Bool (*War2_Pyramid_Tile_Func)(void            *data,
+                                           const Pud_Color *tile,
+                                           unsigned int     level,
+                                           unsigned int     x,
+                                           unsigned int     y);
+
 /**
  * @typedef War2_Tileset_Decode_Func
  * Callback used for each tile to be decoded
@@ -239,6 +556,56 @@ PUDAPI void war2_verbosity_set(War2_Data *w2, int level);
  */
 PUDAPI unsigned char *war2_entry_extract(War2_Data *w2, unsigned int entry, size_t *size_ret);
 
+/**
+ * Decode data entries ahead of time, and keep them in a cache
+ *
+ * Entries are decoded in parallel by @p nthreads workers. Once cached,
+ * war2_entry_extract() and the decoding functions do not decompress
+ * these entries again. The cache is released by war2_entries_cache_flush()
+ * or war2_close().
+ *
+ * This function must not be called while other threads are using @p w2.
+ *
+ * @param w2 A valid handle to Warcraft 2 data file
+ * @param entries The entries to decode. Duplicates are decoded once.
+ * @param count The number of items in @p entries
+ * @param nthreads How many workers to use. 0 means one per online CPU.
+ * @return PUD_TRUE if all entries are in the cache, PUD_FALSE otherwise
+ * @since 1.0.0
+ */
+PUDAPI Pud_Bool
+war2_entries_prefetch(War2_Data          *w2,
+                      const unsigned int *entries,
+                      unsigned int        count,
+                      unsigned int        nthreads);
+
+/**
+ * Decode ahead of time the entries needed to render a map
+ *
+ * The needed entries are the palette and the tileset of the era of @p pud,
+ * and the sprites of each type of unit placed on the map.
+ *
+ * @param w2 A valid handle to Warcraft 2 data file
+ * @param pud A valid handle to a PUD file
+ * @param nthreads How many workers to use. 0 means one per online CPU.
+ * @return PUD_TRUE on success, PUD_FALSE on failure
+ * @see war2_entries_prefetch()
+ * @since 1.0.0
+ */
+PUDAPI Pud_Bool
+war2_prefetch_for_pud(War2_Data    *w2,
+                      const Pud    *pud,
+                      unsigned int  nthreads);
+
+/**
+ * Release all the prefetched entries
+ *
+ * @param w2 A valid handle to Warcraft 2 data file
+ * @see war2_entries_prefetch()
+ * @since 1.0.0
+ */
+PUDAPI void war2_entries_cache_flush(War2_Data *w2);
+
 /**
  * Extract a palette from a data file
  *
@@ -257,10 +624,146 @@ PUDAPI const Pud_Color *war2_palette_get(const War2_Data *w2, Pud_Era era);
  * @param func A user callback to be called for each decoded tile
  * @param data A user data passed to @c func
  * @return How many tiles were decoded
+ * @see war2_tile_decode() to decode tiles on demand
  * @since 1.0.0
  */
 PUDAPI unsigned int war2_tileset_decode(War2_Data *w2, Pud_Era era, War2_Tileset_Decode_Func func, void *data);
 
+/**
+ * Decode the tilesets of several eras, on several threads
+ *
+ * Tiles are decoded by a pool of @p nthreads workers. When @p ordered
+ * is PUD_TRUE, @p func is called from the calling thread, in the same
+ * order than war2_tileset_decode() would, eras being iterated in
+ * ascending order. Otherwise, @p func is called from the workers as soon
+ * as a tile is decoded: calls are not ordered and may happen
+ * concurrently, so @p func must be thread-safe.
+ *
+ * @param w2 A valid handle to Warcraft 2 data file
+ * @param era_mask A bitmask of eras: bit @c n stands for the era @c n.
+ *                 Use #WAR2_ERA_MASK_ALL for the 4 eras.
+ * @param nthreads How many threads to use. 0 means one per online CPU.
+ * @param ordered Whether tiles must be delivered in order
+ * @param func A user callback to be called for each decoded tile
+ * @param data A user data passed to @c func
+ * @return How many tiles were decoded, for all the eras
+ * @since 1.0.0
+ */
+PUDAPI unsigned int
+war2_tileset_decode_parallel(War2_Data                *w2,
+                             unsigned int              era_mask,
+                             unsigned int              nthreads,
+                             Pud_Bool                  ordered,
+                             War2_Tileset_Decode_Func  func,
+                             void                     *data);
+
+/**
+ * Load the tileset of an era in its native form
+ *
+ * The tileset is made of a bank of 8x8 minitiles (palette indexes), and
+ * of 16 minitile references per tile. Once loaded, the tileset does not
+ * depend on @p w2 anymore.
+ *
+ * @param w2 A valid handle to Warcraft 2 data file
+ * @param era The era of the tileset
+ * @return A tileset handle, NULL on failure
+ * @see war2_tileset_close()
+ * @since 1.0.0
+ */
+PUDAPI War2_Tileset *war2_tileset_open(War2_Data *w2, Pud_Era era);
+
+/**
+ * Release a tileset
+ *
+ * @param ts The tileset to be freed. May be NULL.
+ * @since 1.0.0
+ */
+PUDAPI void war2_tileset_close(War2_Tileset *ts);
+
+/**
+ * Retrieve the palette of a tileset
+ *
+ * @param ts A valid tileset handle
+ * @return The palette (#WAR2_PALETTE_SIZE colors) used by @p ts
+ * @since 1.0.0
+ */
+PUDAPI const Pud_Color *war2_tileset_palette_get(const War2_Tileset *ts);
+
+/**
+ * Retrieve the minitiles bank of a tileset
+ *
+ * Minitiles are stored one after the other, each being 8x8 palette
+ * indexes (64 bytes).
+ *
+ * @param[in] ts A valid tileset handle
+ * @param[out] count The number of minitiles. May be NULL.
+ * @return The minitiles bank. It belongs to @p ts.
+ * @since 1.0.0
+ */
+PUDAPI const unsigned char *
+war2_tileset_minitiles_get(const War2_Tileset *ts,
+                           unsigned int       *count);
+
+/**
+ * Retrieve the minitiles a tile is made of
+ *
+ * @param ts A valid tileset handle
+ * @param tile A tile ID
+ * @return The 16 minitile references of @p tile, row by row (4 by 4).
+ *         NULL if @p tile has no graphic. They belong to @p ts.
+ * @since 1.0.0
+ */
+PUDAPI const War2_Minitile_Ref *
+war2_tileset_tile_refs_get(const War2_Tileset *ts,
+                           uint16_t            tile);
+
+/**
+ * Decode a single tile
+ *
+ * Unlike war2_tileset_decode(), which goes through the whole tileset,
+ * this decodes only @p tile, from a tileset that was opened once. At
+ * least one of @p out_rgba and @p out_indexed must be provided.
+ *
+ * @param ts A valid tileset handle
+ * @param tile A tile ID
+ * @param out_rgba Where to write the 32x32 colors of the tile. May be NULL.
+ * @param out_indexed Where to write the 32x32 palette indexes of the tile.
+ *        May be NULL.
+ * @return PUD_TRUE on success, PUD_FALSE if @p tile has no graphic
+ * @see war2_tileset_palette_get()
+ * @since 1.0.0
+ */
+PUDAPI Pud_Bool
+war2_tile_decode(const War2_Tileset *ts,
+                 uint16_t            tile,
+                 Pud_Color          *out_rgba,
+                 unsigned char      *out_indexed);
+
+/**
+ * Render a tile into a framebuffer
+ *
+ * Minitiles are blitted directly into @p fb. The tile is clipped
+ * against the framebuffer.
+ *
+ * @param ts A valid tileset handle
+ * @param tile A tile ID
+ * @param fb The framebuffer
+ * @param fb_w The width of @p fb
+ * @param fb_h The height of @p fb
+ * @param x X position of the tile in @p fb
+ * @param y Y position of the tile in @p fb
+ * @return PUD_TRUE on success, PUD_FALSE if @p tile has no graphic
+ * @since 1.0.0
+ */
+PUDAPI Pud_Bool
+war2_tileset_tile_render(const War2_Tileset *ts,
+                         uint16_t            tile,
+                         Pud_Color          *fb,
+                         unsigned int        fb_w,
+                         unsigned int        fb_h,
+                         int                 x,
+                         int                 y);
+
 /**
  * Decode sprites for a given object, color and era
  *
@@ -301,68 +804,515 @@ war2_sprites_decode_entry(War2_Data                *w2,
                           void                     *data);
 
 /**
- * Decode a cursor from an entry
+ * Retrieve the data entry that holds the sprites of an object for an era
  *
- * @param[in] w2 A valid handle to Warcract 2 data file
- * @param[in] entry An assumed valid entry to a cursor
- * @param[out] x The hot X position of the decoded cursor
- * @param[out] y The hot Y position of the decoded cursor
- * @param[out] w The width of the cursor
- * @param[out] h The height of the cursor
- * @return The bitmap of the cursor. NULL on failure. The caller MUST call
- *         free() on the returned value to release the memory.
- * @since 1.0.0
- */
-PUDAPI Pud_Color *
-war2_cursors_decode(War2_Data *w2,
-                    unsigned int entry,
-                    int *x,
-                    int *y,
-                    unsigned int *w,
-                    unsigned int *h);
-
-/**
- * Decode a user interface (UI element)
+ * Several objects or eras may share the same entry (e.g. most units have
+ * the same sprites whatever the era).
  *
- * @param[in] w2 A valid handle to Warcract 2 data file
- * @param[in] entry An assumed valid entry to an UI item
- * @param[out] w The width of the image
- * @param[out] h The height of the image
- * @return The decoded image for the UI element. NULL on failure.
- *         The caller must free() the returned value to release memory.
+ * @param[in] object The object. To query ICONS, pass WAR2_SPRITES_ICONS.
+ * To query units or buildings, pass the corresponding value of Pud_Unit.
+ * @param[in] era The era of the sprites
+ * @param[out] entry The entry of the sprites. May be NULL.
+ * @param[out] type The type of the sprites. May be NULL.
+ * @param[out] side The side of the object. May be NULL.
+ * @return PUD_TRUE if @p object has sprites for @p era, PUD_FALSE otherwise
  * @since 1.0.0
  */
-PUDAPI Pud_Color *
-war2_ui_decode(War2_Data *w2,
-               unsigned int entry,
-               unsigned int *w,
-               unsigned int *h);
+PUDAPI Pud_Bool
+war2_sprites_entry_for(unsigned int   object,
+                       Pud_Era        era,
+                       unsigned int  *entry,
+                       War2_Sprites  *type,
+                       Pud_Side      *side);
 
 /**
- * Write a bitmap as a PNG image on the filesystem.
+ * Decode sprites for a given object, color and era, with decoding flags
  *
- * If libwar2 was NOT compiled with PNG support, this function will always
- * return PUD_FALSE.
+ * When @p flags contains #WAR2_SPRITES_DECODE_FLIP_X, each frame is
+ * mirrored horizontally while its RLE rows are decoded, and its X origin
+ * is mirrored within the bounding box of the sprite set.
  *
- * @param file The path where to save the png file
- * @param w The width of the bitmap
- * @param h The height of the bitmap
- * @param data The bitmap data
+ * @param w2 A valid handle to Warcraft 2 data file
+ * @param player_color The color of the sprites
+ * @param era The era of the sprites
+ * @param object The object to decode (see war2_sprites_decode())
+ * @param flags A bitmask of War2_Sprites_Decode_Flags
+ * @param func User callback to be called for each decoded sprite
+ * @param data User data passed to @c func
  * @return PUD_TRUE on success, PUD_FALSE on failure
+ * @see war2_sprites_decode()
  * @since 1.0.0
  */
-PUDAPI Pud_Bool war2_png_write(const char          *file,
-                               unsigned int         w,
-                               unsigned int         h,
-                               const unsigned char *data);
+PUDAPI Pud_Bool
+war2_sprites_decode_full(War2_Data                  *w2,
+                         Pud_Player                  player_color,
+                         Pud_Era                     era,
+                         unsigned int                object,
+                         War2_Sprites_Decode_Flags   flags,
+                         War2_Sprites_Decode_Func    func,
+                         void                       *data);
 
 /**
- * Write a bitmap as a JPEG image on the filesystem.
+ * Decode sprites for a given object and era, for several player colors
  *
- * If libwar2 was NOT compiled with JPEG support, this function will always
- * return PUD_FALSE.
+ * Each frame is extracted and decoded once, and then expanded through
+ * the palette of each requested player. @p func is called once per
+ * frame and per player, players being iterated in ascending order for
+ * each frame. The @c color field of the sprite descriptor tells which
+ * player the bitmap belongs to.
  *
- * @param file The path where to save the jpeg file
+ * @param w2 A valid handle to Warcraft 2 data file
+ * @param era The era of the sprites
+ * @param object The object to decode (see war2_sprites_decode())
+ * @param player_mask A bitmask of players: bit @c n stands for the player
+ *                    @c n. Use #WAR2_PLAYERS_MASK_ALL for the 8 players.
+ * @param func User callback to be called for each decoded sprite
+ * @param data User data passed to @c func
+ * @return PUD_TRUE on success, PUD_FALSE on failure
+ * @see war2_sprites_decode()
+ * @since 1.0.0
+ */
+PUDAPI Pud_Bool
+war2_sprites_decode_multi(War2_Data                *w2,
+                          Pud_Era                   era,
+                          unsigned int              object,
+                          unsigned int              player_mask,
+                          War2_Sprites_Decode_Func  func,
+                          void                     *data);
+
+/**
+ * Decode sprites in a given entry, with decoding flags
+ *
+ * @param w2 A valid handle to Warcraft 2 data file
+ * @param player_color The color of the sprites
+ * @param entry The entry to decode
+ * @param flags A bitmask of War2_Sprites_Decode_Flags
+ * @param func User callback to be called for each decoded sprite
+ * @param data User data passed to @c func
+ * @return PUD_TRUE on success, PUD_FALSE on failure
+ * @see war2_sprites_decode_entry()
+ * @since 1.0.0
+ */
+PUDAPI Pud_Bool
+war2_sprites_decode_entry_full(War2_Data                  *w2,
+                               Pud_Player                  player_color,
+                               unsigned int                entry,
+                               War2_Sprites_Decode_Flags   flags,
+                               War2_Sprites_Decode_Func    func,
+                               void                       *data);
+
+/**
+ * Retrieve the frame to be used for a unit facing a given direction
+ *
+ * Unit sprites are made of rows of 5 frames (one per stored direction),
+ * one row per animation step.
+ *
+ * @param[in] direction The direction the unit is facing
+ * @param[in] step The animation step
+ * @param[out] frame The index of the frame to be used. May be NULL.
+ * @param[out] flip_x Set to PUD_TRUE when the frame must be mirrored.
+ *                    May be NULL.
+ * @return PUD_TRUE on success, PUD_FALSE if @p direction is invalid
+ * @since 1.0.0
+ */
+PUDAPI Pud_Bool
+war2_sprites_frame_for_direction(War2_Direction  direction,
+                                 unsigned int    step,
+                                 unsigned int   *frame,
+                                 Pud_Bool       *flip_x);
+
+/**
+ * Blit a decoded sprite onto a bitmap, optionally mirroring it
+ *
+ * Fully transparent pixels of the sprite are skipped, and the sprite
+ * is clipped against the destination bitmap.
+ *
+ * @param dst The destination bitmap
+ * @param dst_w The width of @p dst
+ * @param dst_h The height of @p dst
+ * @param x X position of the sprite in @p dst
+ * @param y Y position of the sprite in @p dst
+ * @param sprite The sprite bitmap
+ * @param w The width of @p sprite
+ * @param h The height of @p sprite
+ * @param flip_x If PUD_TRUE, @p sprite is mirrored horizontally
+ * @since 1.0.0
+ */
+PUDAPI void
+war2_sprites_blit(Pud_Color       *dst,
+                  unsigned int     dst_w,
+                  unsigned int     dst_h,
+                  int              x,
+                  int              y,
+                  const Pud_Color *sprite,
+                  unsigned int     w,
+                  unsigned int     h,
+                  Pud_Bool         flip_x);
+
+/**
+ * Test whether a pixel of a mask is opaque
+ *
+ * @param mask A valid mask
+ * @param x X coordinate within @p mask
+ * @param y Y coordinate within @p mask
+ * @return PUD_TRUE if the pixel is opaque. PUD_FALSE if it is transparent
+ *         or outside of @p mask.
+ * @since 1.0.0
+ */
+PUDAPI Pud_Bool war2_mask_hit(const War2_Mask *mask, int x, int y);
+
+/**
+ * Duplicate a mask
+ *
+ * Masks provided to the sprites decoding callbacks are only valid within
+ * the callbacks. Use this function to keep them.
+ *
+ * @param mask A valid mask
+ * @return A copy of @p mask, to be released with war2_mask_free().
+ *         NULL on failure.
+ * @since 1.0.0
+ */
+PUDAPI War2_Mask *war2_mask_dup(const War2_Mask *mask);
+
+/**
+ * Release a mask created by war2_mask_dup()
+ *
+ * @param mask The mask to be freed. May be NULL.
+ * @since 1.0.0
+ */
+PUDAPI void war2_mask_free(War2_Mask *mask);
+
+/**
+ * Create a texture atlas
+ *
+ * Frames are added to the atlas with war2_atlas_add_frame(), and then
+ * packed together in a single bitmap by war2_atlas_pack().
+ *
+ * @param width The width of the atlas. If 0, the width will be chosen
+ *              to make a squarish atlas.
+ * @param padding Amount of transparent pixels to be kept on the right and
+ *                below each frame
+ * @return A new atlas. NULL on failure.
+ * @see war2_atlas_free()
+ * @since 1.0.0
+ */
+PUDAPI War2_Atlas *war2_atlas_new(unsigned int width, unsigned int padding);
+
+/**
+ * Release an atlas
+ *
+ * @param atlas The atlas to be freed. May be NULL.
+ * @since 1.0.0
+ */
+PUDAPI void war2_atlas_free(War2_Atlas *atlas);
+
+/**
+ * Add a frame to an atlas
+ *
+ * The bitmap is copied, so this function can be called directly from the
+ * decoding callbacks.
+ *
+ * @param atlas A valid atlas
+ * @param id User identifier of the frame, stored in its rect
+ * @param bitmap The bitmap of the frame
+ * @param w The width of @p bitmap
+ * @param h The height of @p bitmap
+ * @param x X origin of the frame, stored in its rect
+ * @param y Y origin of the frame, stored in its rect
+ * @return PUD_TRUE on success, PUD_FALSE on failure
+ * @since 1.0.0
+ */
+PUDAPI Pud_Bool
+war2_atlas_add_frame(War2_Atlas      *atlas,
+                     unsigned int     id,
+                     const Pud_Color *bitmap,
+                     unsigned int     w,
+                     unsigned int     h,
+                     int              x,
+                     int              y);
+
+/**
+ * Pack the frames of an atlas and compose its bitmap
+ *
+ * Frames are placed with a skyline bottom-left heuristic, from the
+ * tallest to the smallest.
+ *
+ * @param atlas A valid atlas
+ * @return PUD_TRUE on success, PUD_FALSE on failure (e.g. a frame is
+ *         wider than the atlas)
+ * @since 1.0.0
+ */
+PUDAPI Pud_Bool war2_atlas_pack(War2_Atlas *atlas);
+
+/**
+ * Retrieve the bitmap of a packed atlas
+ *
+ * @param[in] atlas A valid atlas
+ * @param[out] w The width of the bitmap. May be NULL.
+ * @param[out] h The height of the bitmap. May be NULL.
+ * @return The bitmap of the atlas. It belongs to @p atlas.
+ *         NULL if the atlas was not packed.
+ * @since 1.0.0
+ */
+PUDAPI const Pud_Color *
+war2_atlas_bitmap_get(const War2_Atlas *atlas,
+                      unsigned int     *w,
+                      unsigned int     *h);
+
+/**
+ * Retrieve the location of the frames of a packed atlas
+ *
+ * Rects are in the order the frames were added.
+ *
+ * @param[in] atlas A valid atlas
+ * @param[out] count The number of rects. May be NULL.
+ * @return The rects of @p atlas. They belong to @p atlas.
+ * @since 1.0.0
+ */
+PUDAPI const War2_Atlas_Rect *
+war2_atlas_rects_get(const War2_Atlas *atlas,
+                     unsigned int     *count);
+
+/**
+ * Decode a cursor from an entry
+ *
+ * @param[in] w2 A valid handle to Warcract 2 data file
+ * @param[in] entry An assumed valid entry to a cursor
+ * @param[out] x The hot X position of the decoded cursor
+ * @param[out] y The hot Y position of the decoded cursor
+ * @param[out] w The width of the cursor
+ * @param[out] h The height of the cursor
+ * @return The bitmap of the cursor. NULL on failure. The caller MUST call
+ *         free() on the returned value to release the memory.
+ * @since 1.0.0
+ */
+PUDAPI Pud_Color *
+war2_cursors_decode(War2_Data *w2,
+                    unsigned int entry,
+                    int *x,
+                    int *y,
+                    unsigned int *w,
+                    unsigned int *h);
+
+/**
+ * Decode a user interface (UI element)
+ *
+ * @param[in] w2 A valid handle to Warcract 2 data file
+ * @param[in] entry An assumed valid entry to an UI item
+ * @param[out] w The width of the image
+ * @param[out] h The height of the image
+ * @return The decoded image for the UI element. NULL on failure.
+ *         The caller must free() the returned value to release memory.
+ * @since 1.0.0
+ */
+PUDAPI Pud_Color *
+war2_ui_decode(War2_Data *w2,
+               unsigned int entry,
+               unsigned int *w,
+               unsigned int *h);
+
+/**
+ * Decode a cursor from an entry, without expanding its palette indexes
+ *
+ * The indexes refer to the palette of the forest era, as returned by
+ * war2_palette_get(). Index 0 is transparent.
+ *
+ * @param[in] w2 A valid handle to Warcract 2 data file
+ * @param[in] entry An assumed valid entry to a cursor
+ * @param[out] x The hot X position of the decoded cursor
+ * @param[out] y The hot Y position of the decoded cursor
+ * @param[out] w The width of the cursor
+ * @param[out] h The height of the cursor
+ * @return The palette indexes of the cursor, one byte per pixel. NULL on
+ *         failure. The caller MUST call free() on the returned value to
+ *         release the memory.
+ * @see war2_cursors_decode()
+ * @see war2_png_write_indexed()
+ * @since 1.0.0
+ */
+PUDAPI unsigned char *
+war2_cursors_decode_indexed(War2_Data *w2,
+                            unsigned int entry,
+                            int *x,
+                            int *y,
+                            unsigned int *w,
+                            unsigned int *h);
+
+/**
+ * Decode a user interface (UI element), without expanding its palette
+ * indexes
+ *
+ * The indexes refer to the palette of the forest era, as returned by
+ * war2_palette_get(). Index 0 is transparent.
+ *
+ * @param[in] w2 A valid handle to Warcract 2 data file
+ * @param[in] entry An assumed valid entry to an UI item
+ * @param[out] w The width of the image
+ * @param[out] h The height of the image
+ * @return The palette indexes of the UI element, one byte per pixel.
+ *         NULL on failure. The caller must free() the returned value to
+ *         release memory.
+ * @see war2_ui_decode()
+ * @see war2_png_write_indexed()
+ * @since 1.0.0
+ */
+PUDAPI unsigned char *
+war2_ui_decode_indexed(War2_Data *w2,
+                       unsigned int entry,
+                       unsigned int *w,
+                       unsigned int *h);
+
+/**
+ * Write a bitmap as a PNG image on the filesystem.
+ *
+ * If libwar2 was NOT compiled with PNG support, this function will always
+ * return PUD_FALSE.
+ *
+ * @param file The path where to save the png file
+ * @param w The width of the bitmap
+ * @param h The height of the bitmap
+ * @param data The bitmap data
+ * @return PUD_TRUE on success, PUD_FALSE on failure
+ * @since 1.0.0
+ */
+PUDAPI Pud_Bool war2_png_write(const char          *file,
+                               unsigned int         w,
+                               unsigned int         h,
+                               const unsigned char *data);
+
+/**
+ * Encode a bitmap as a PNG image in memory.
+ *
+ * The image is appended to @p buf, which grows as needed. Starting from a
+ * zeroed buffer, @c buf->data is a malloc()'d PNG file of @c buf->size
+ * bytes, that belongs to the caller.
+ * If libwar2 was NOT compiled with PNG support, this function will always
+ * return PUD_FALSE.
+ *
+ * @param buf The buffer where the image is appended
+ * @param w The width of the bitmap
+ * @param h The height of the bitmap
+ * @param data The bitmap data, in RGBA
+ * @return PUD_TRUE on success, PUD_FALSE on failure. On failure, the
+ *         content of @p buf is left as it was.
+ * @see war2_buffer_free()
+ * @since 1.0.0
+ */
+PUDAPI Pud_Bool war2_png_encode(War2_Buffer         *buf,
+                                unsigned int         w,
+                                unsigned int         h,
+                                const unsigned char *data);
+
+/**
+ * Write an indexed bitmap as a paletted PNG image on the filesystem.
+ *
+ * All the graphics of Warcraft II are made of palette indexes. Storing
+ * them as they are (one byte per pixel, with PLTE and tRNS chunks)
+ * produces much smaller files than their RGBA expansion, that are also
+ * faster to encode. Only the colors in use are stored in the palette
+ * (so indexes may be renumbered in the file), and pixels are packed at
+ * the smallest bit depth that can hold them.
+ * If libwar2 was NOT compiled with PNG support, this function will always
+ * return PUD_FALSE.
+ *
+ * @param file The path where to save the png file
+ * @param w The width of the bitmap
+ * @param h The height of the bitmap
+ * @param indexes The bitmap data, one palette index per pixel
+ * @param palette The palette of #WAR2_PALETTE_SIZE colors the indexes
+ *                refer to. The alpha of its colors is ignored.
+ * @param transparent_index The index of the fully transparent color
+ *                          (0 for all the palettes of Warcraft II), or
+ *                          -1 if the image is opaque
+ * @return PUD_TRUE on success, PUD_FALSE on failure
+ * @see war2_palette_get()
+ * @since 1.0.0
+ */
+PUDAPI Pud_Bool war2_png_write_indexed(const char          *file,
+                                       unsigned int         w,
+                                       unsigned int         h,
+                                       const unsigned char *indexes,
+                                       const Pud_Color     *palette,
+                                       int                  transparent_index);
+
+/**
+ * Encode an indexed bitmap as a paletted PNG image in memory.
+ *
+ * This is the in-memory counterpart of war2_png_write_indexed(). The
+ * image is appended to @p buf, which grows as needed.
+ *
+ * @param buf The buffer where the image is appended
+ * @param w The width of the bitmap
+ * @param h The height of the bitmap
+ * @param indexes The bitmap data, one palette index per pixel
+ * @param palette The palette of #WAR2_PALETTE_SIZE colors the indexes
+ *                refer to. The alpha of its colors is ignored.
+ * @param transparent_index The index of the fully transparent color, or
+ *                          -1 if the image is opaque
+ * @return PUD_TRUE on success, PUD_FALSE on failure. On failure, the
+ *         content of @p buf is left as it was.
+ * @see war2_buffer_free()
+ * @since 1.0.0
+ */
+PUDAPI Pud_Bool war2_png_encode_indexed(War2_Buffer         *buf,
+                                        unsigned int         w,
+                                        unsigned int         h,
+                                        const unsigned char *indexes,
+                                        const Pud_Color     *palette,
+                                        int                  transparent_index);
+
+/**
+ * Start writing a PNG image on the filesystem, row by row
+ *
+ * Only the rows being written are held in memory, which allows to write
+ * images that would not fit in memory at once.
+ * If libwar2 was NOT compiled with PNG support, this function will always
+ * return NULL.
+ *
+ * @param file The path where to save the png file
+ * @param w The width of the image
+ * @param h The height of the image
+ * @return A PNG writer, NULL on failure
+ * @see war2_png_writer_rows_write()
+ * @see war2_png_writer_close()
+ * @since 1.0.0
+ */
+PUDAPI War2_Png_Writer *war2_png_writer_new(const char   *file,
+                                            unsigned int  w,
+                                            unsigned int  h);
+
+/**
+ * Append rows to a PNG image
+ *
+ * @param png A valid PNG writer
+ * @param rows @p count rows of pixels, one after the other
+ * @param count How many rows to be written
+ * @return PUD_TRUE on success, PUD_FALSE on failure or if more rows than
+ *         the height of the image are written. Once writing failed (e.g.
+ *         the disk is full), no more rows are accepted.
+ * @since 1.0.0
+ */
+PUDAPI Pud_Bool war2_png_writer_rows_write(War2_Png_Writer *png,
+                                           const Pud_Color *rows,
+                                           unsigned int     count);
+
+/**
+ * Finish a PNG image and release its writer
+ *
+ * @param png The PNG writer to be released. May be NULL.
+ * @return PUD_TRUE if all the rows of the image were written and saved,
+ *         PUD_FALSE otherwise
+ * @since 1.0.0
+ */
+PUDAPI Pud_Bool war2_png_writer_close(War2_Png_Writer *png);
+
+/**
+ * Write a bitmap as a JPEG image on the filesystem.
+ *
+ * If libwar2 was NOT compiled with JPEG support, this function will always
+ * return PUD_FALSE.
+ *
+ * @param file The path where to save the jpeg file
  * @param w The width of the bitmap
  * @param h The height of the bitmap
  * @param data The bitmap data
@@ -375,13 +1325,37 @@ PUDAPI Pud_Bool war2_jpeg_write(const char          *file,
                                 const unsigned char *data);
 
 /**
- * Write a bitmap as a PPM image on the filesystem.
+ * Encode a bitmap as a JPEG image in memory.
+ *
+ * The image is appended to @p buf, which grows as needed. Starting from a
+ * zeroed buffer, @c buf->data is a malloc()'d JPEG file of @c buf->size
+ * bytes, that belongs to the caller.
+ * If libwar2 was NOT compiled with JPEG support, this function will always
+ * return PUD_FALSE.
+ *
+ * @param buf The buffer where the image is appended
+ * @param w The width of the bitmap
+ * @param h The height of the bitmap
+ * @param data The bitmap data, in RGBA. Alpha is dropped.
+ * @return PUD_TRUE on success, PUD_FALSE on failure. On failure, the
+ *         content of @p buf is left as it was.
+ * @see war2_buffer_free()
+ * @since 1.0.0
+ */
+PUDAPI Pud_Bool war2_jpeg_encode(War2_Buffer         *buf,
+                                 unsigned int         w,
+                                 unsigned int         h,
+                                 const unsigned char *data);
+
+/**
+ * Write a bitmap as a binary (P6) PPM image on the filesystem.
  *
  * @param file The path where to save the ppm file
  * @param w The width of the bitmap
  * @param h The height of the bitmap
- * @param data The bitmap data
+ * @param data The bitmap data, in RGBA. Alpha is dropped.
  * @return PUD_TRUE on success, PUD_FALSE on failure
+ * @see war2_ppm_format_write()
  * @since 1.0.0
  */
 PUDAPI Pud_Bool war2_ppm_write(const char          *file,
@@ -389,6 +1363,339 @@ PUDAPI Pud_Bool war2_ppm_write(const char          *file,
                                unsigned int         h,
                                const unsigned char *data);
 
+/**
+ * Write a bitmap as a PPM image of a given format on the filesystem.
+ *
+ * The whole image is encoded in memory, then written at once.
+ *
+ * @param file The path where to save the ppm file
+ * @param w The width of the bitmap
+ * @param h The height of the bitmap
+ * @param data The bitmap data, in RGBA. Alpha is dropped.
+ * @param format Binary (P6) or ASCII (P3)
+ * @return PUD_TRUE on success, PUD_FALSE on failure
+ * @since 1.0.0
+ */
+PUDAPI Pud_Bool war2_ppm_format_write(const char          *file,
+                                      unsigned int         w,
+                                      unsigned int         h,
+                                      const unsigned char *data,
+                                      War2_Ppm_Format      format);
+
+/**
+ * Encode a bitmap as a PPM image in memory.
+ *
+ * The image is appended to @p buf, which grows as needed.
+ *
+ * @param buf The buffer where the image is appended
+ * @param w The width of the bitmap
+ * @param h The height of the bitmap
+ * @param data The bitmap data, in RGBA. Alpha is dropped.
+ * @param format Binary (P6) or ASCII (P3)
+ * @return PUD_TRUE on success, PUD_FALSE on failure. On failure, @p buf
+ *         is left as it was.
+ * @since 1.0.0
+ */
+PUDAPI Pud_Bool war2_ppm_encode(War2_Buffer         *buf,
+                                unsigned int         w,
+                                unsigned int         h,
+                                const unsigned char *data,
+                                War2_Ppm_Format      format);
+
+/**
+ * Release the memory held by a buffer.
+ *
+ * The buffer is emptied, and can be used again.
+ *
+ * @param buf The buffer to be released. May be NULL.
+ * @since 1.0.0
+ */
+PUDAPI void war2_buffer_free(War2_Buffer *buf);
+
+/**
+ * Create an encoder of images
+ *
+ * An encoder keeps what can be kept from one image to the next (codec
+ * state, settings, row buffers), so encoding many images with the same
+ * encoder is cheaper than calling war2_png_write() and the like for each
+ * of them. An encoder must not be used by several threads at once.
+ *
+ * @param format The format of the images to be encoded
+ * @param opts Encoding options. NULL for the defaults, which produce the
+ *             same images as war2_png_write(), war2_jpeg_write() and
+ *             war2_ppm_write().
+ * @return An encoder, NULL on failure or if libwar2 was compiled without
+ *         support for @p format
+ * @see war2_encoder_free()
+ * @since 1.0.0
+ */
+PUDAPI War2_Encoder *
+war2_encoder_new(War2_Encoder_Format          format,
+                 const War2_Encoder_Options *opts);
+
+/**
+ * Free an encoder
+ *
+ * @param enc The encoder to be freed. May be NULL.
+ * @since 1.0.0
+ */
+PUDAPI void war2_encoder_free(War2_Encoder *enc);
+
+/**
+ * Encode a bitmap in memory
+ *
+ * The image is appended to @p buf, which grows as needed.
+ *
+ * @param enc A valid encoder
+ * @param buf The buffer where the image is appended
+ * @param w The width of the bitmap
+ * @param h The height of the bitmap
+ * @param data The bitmap data, in RGBA
+ * @return PUD_TRUE on success, PUD_FALSE on failure. On failure, the
+ *         content of @p buf is left as it was.
+ * @since 1.0.0
+ */
+PUDAPI Pud_Bool war2_encoder_encode(War2_Encoder        *enc,
+                                    War2_Buffer         *buf,
+                                    unsigned int         w,
+                                    unsigned int         h,
+                                    const unsigned char *data);
+
+/**
+ * Encode a bitmap in a file
+ *
+ * @param enc A valid encoder
+ * @param file The path where to save the image
+ * @param w The width of the bitmap
+ * @param h The height of the bitmap
+ * @param data The bitmap data, in RGBA
+ * @return PUD_TRUE on success, PUD_FALSE on failure
+ * @since 1.0.0
+ */
+PUDAPI Pud_Bool war2_encoder_write(War2_Encoder        *enc,
+                                   const char          *file,
+                                   unsigned int         w,
+                                   unsigned int         h,
+                                   const unsigned char *data);
+
+/**
+ * Encode an indexed bitmap in memory
+ *
+ * PNG encoders store the image as it is, with a palette. The other
+ * formats have no palette: the image is expanded to RGBA first.
+ *
+ * @param enc A valid encoder
+ * @param buf The buffer where the image is appended
+ * @param w The width of the bitmap
+ * @param h The height of the bitmap
+ * @param indexes The bitmap data, one palette index per pixel
+ * @param palette The palette of #WAR2_PALETTE_SIZE colors the indexes
+ *                refer to. The alpha of its colors is ignored.
+ * @param transparent_index The index of the fully transparent color, or
+ *                          -1 if the image is opaque
+ * @return PUD_TRUE on success, PUD_FALSE on failure. On failure, the
+ *         content of @p buf is left as it was.
+ * @see war2_encoder_encode()
+ * @since 1.0.0
+ */
+PUDAPI Pud_Bool war2_encoder_encode_indexed(War2_Encoder        *enc,
+                                            War2_Buffer         *buf,
+                                            unsigned int         w,
+                                            unsigned int         h,
+                                            const unsigned char *indexes,
+                                            const Pud_Color     *palette,
+                                            int                  transparent_index);
+
+/**
+ * Encode an indexed bitmap in a file
+ *
+ * @param enc A valid encoder
+ * @param file The path where to save the image
+ * @param w The width of the bitmap
+ * @param h The height of the bitmap
+ * @param indexes The bitmap data, one palette index per pixel
+ * @param palette The palette of #WAR2_PALETTE_SIZE colors the indexes
+ *                refer to. The alpha of its colors is ignored.
+ * @param transparent_index The index of the fully transparent color, or
+ *                          -1 if the image is opaque
+ * @return PUD_TRUE on success, PUD_FALSE on failure
+ * @see war2_encoder_encode_indexed()
+ * @since 1.0.0
+ */
+PUDAPI Pud_Bool war2_encoder_write_indexed(War2_Encoder        *enc,
+                                           const char          *file,
+                                           unsigned int         w,
+                                           unsigned int         h,
+                                           const unsigned char *indexes,
+                                           const Pud_Color     *palette,
+                                           int                  transparent_index);
+
+
+/**
+ * Render a whole map at game resolution
+ *
+ * The tiles of @p pud (and optionally its units) are rendered in
+ * horizontal strips of @c strip_rows rows of tiles, which are delivered
+ * to @p sink from top to bottom, from the calling thread. Strips may be
+ * rendered on several threads, and only the strips being rendered are
+ * held in memory.
+ *
+ * @param w2 A valid handle to Warcraft 2 data file
+ * @param pud The map to be rendered
+ * @param opts Rendering options. NULL for the defaults: strips of 4 rows
+ *             of tiles, one thread per CPU, with units.
+ * @param sink Where to deliver the rendered rows
+ * @return PUD_TRUE on success, PUD_FALSE on failure or if @p sink aborted
+ * @since 1.0.0
+ */
+PUDAPI Pud_Bool
+war2_map_render(War2_Data                     *w2,
+                const Pud                     *pud,
+                const War2_Map_Render_Options *opts,
+                const War2_Map_Sink           *sink);
+
+/**
+ * Get how many zoom levels the pyramid of a map has
+ *
+ * Level 0 holds the whole map in a single tile, and each level doubles
+ * the resolution of the previous one, up to the last level which is at
+ * game resolution.
+ *
+ * @param pud A valid map
+ * @return The number of levels, 0 on failure
+ * @see war2_map_pyramid_render()
+ * @since 1.0.0
+ */
+PUDAPI unsigned int war2_map_pyramid_levels_get(const Pud *pud);
+
+/**
+ * Render the tile pyramid of a map, for deep-zoom viewers
+ *
+ * The last level is rendered tile by tile at game resolution. Each
+ * coarser level is built by averaging 2x2 blocks of pixels of the level
+ * below. Only one row of tiles per level is held in memory: the full map
+ * is never rendered at once.
+ *
+ * Tiles of a same row are rendered, and @p func is called, from several
+ * threads at once: @p func must be thread-safe. A row of a level is always
+ * delivered before the row of the coarser level it contributes to.
+ *
+ * @param w2 A valid handle to Warcraft 2 data file
+ * @param pud The map to be rendered
+ * @param opts Rendering options (@c strip_rows is not used). NULL for the
+ *             defaults: one thread per CPU, with units.
+ * @param func Called for each tile of each level
+ * @param data User data passed to @p func
+ * @return PUD_TRUE on success, PUD_FALSE on failure or if @p func aborted
+ * @see war2_map_pyramid_levels_get()
+ * @since 1.0.0
+ */
+PUDAPI Pud_Bool
+war2_map_pyramid_render(War2_Data                     *w2,
+                        const Pud                     *pud,
+                        const War2_Map_Render_Options *opts,
+                        War2_Pyramid_Tile_Func         func,
+                        void                          *data);
+
+/**
+ * Create a viewport on a map
+ *
+ * The viewport keeps a framebuffer of @p w x @p h pixels, which shows
+ * the map from its top-left corner. It follows the modifications made by
+ * pud_tile_set() and pud_unit_add(), and only the cells touched since
+ * the last war2_viewport_render() are rendered again.
+ * Both @p w2 and @p pud must outlive the viewport.
+ *
+ * @param w2 A valid handle to Warcraft 2 data file
+ * @param pud The map to be shown
+ * @param w The width of the viewport, in pixels
+ * @param h The height of the viewport, in pixels
+ * @return A viewport, NULL on failure
+ * @see war2_viewport_free()
+ * @since 1.0.0
+ */
+PUDAPI War2_Viewport *
+war2_viewport_new(War2_Data    *w2,
+                  Pud          *pud,
+                  unsigned int  w,
+                  unsigned int  h);
+
+/**
+ * Release a viewport
+ *
+ * @param vp The viewport to be freed. May be NULL.
+ * @since 1.0.0
+ */
+PUDAPI void war2_viewport_free(War2_Viewport *vp);
+
+/**
+ * Scroll a viewport
+ *
+ * The viewport does not go beyond the edges of the map. Pixels that
+ * remain visible are moved within the framebuffer, and only the cells
+ * that are exposed will be rendered.
+ *
+ * @param vp A valid viewport
+ * @param dx Horizontal delta, in pixels
+ * @param dy Vertical delta, in pixels
+ * @since 1.0.0
+ */
+PUDAPI void war2_viewport_scroll(War2_Viewport *vp, int dx, int dy);
+
+/**
+ * Retrieve the position of a viewport within its map
+ *
+ * @param vp A valid viewport
+ * @param x X of the top-left corner of the viewport, in pixels. May be NULL.
+ * @param y Y of the top-left corner of the viewport, in pixels. May be NULL.
+ * @since 1.0.0
+ */
+PUDAPI void war2_viewport_position_get(const War2_Viewport *vp, int *x, int *y);
+
+/**
+ * Request cells to be rendered again
+ *
+ * This is only needed after the map was modified without going through
+ * the functions of libpud.
+ *
+ * @param vp A valid viewport
+ * @param x X of the first cell
+ * @param y Y of the first cell
+ * @param w Width of the area, in cells
+ * @param h Height of the area, in cells
+ * @since 1.0.0
+ */
+PUDAPI void
+war2_viewport_invalidate(War2_Viewport *vp,
+                         unsigned int   x,
+                         unsigned int   y,
+                         unsigned int   w,
+                         unsigned int   h);
+
+/**
+ * Render the cells of a viewport that need to be
+ *
+ * @param vp A valid viewport
+ * @return How many cells were rendered
+ * @see war2_viewport_framebuffer_get()
+ * @since 1.0.0
+ */
+PUDAPI unsigned int war2_viewport_render(War2_Viewport *vp);
+
+/**
+ * Retrieve the framebuffer of a viewport
+ *
+ * @param vp A valid viewport
+ * @param w Width of the framebuffer. May be NULL.
+ * @param h Height of the framebuffer. May be NULL.
+ * @return The framebuffer. It belongs to @p vp.
+ * @since 1.0.0
+ */
+PUDAPI const Pud_Color *
+war2_viewport_framebuffer_get(const War2_Viewport *vp,
+                              unsigned int        *w,
+                              unsigned int        *h);
+
 /**
  * Convert a color from one player to another
  *
@@ -37,6 +37,72 @@
 #include "war2.h"
 #include "common.h"
 
+typedef struct
+{
+   unsigned char *data;
+   size_t         size;
+} War2_Entry_Cache;
+
+typedef struct
+{
+   const unsigned char *data;
+   size_t               size;
+   unsigned char       *allocated; /* NULL when lent by the cache */
+} War2_Entry;
+
+typedef void (*War2_Job_Func)(void *data, unsigned int job);
+
+/* Tile IDs are within [0x0000;0x09ff] */
+#define WAR2_TILESET_TILES_MAX 0x0a00
+
+struct _War2_Tileset
+{
+   Pud_Era             era;
+   Pud_Color           palette[WAR2_PALETTE_SIZE];
+
+   /* Minitiles bank: 8x8 palette indexes each */
+   unsigned char      *minitiles;
+   unsigned int        minitiles_count;
+
+   /* 16 minitiles references per tile graphic */
+   War2_Minitile_Ref  *refs;
+   unsigned int        graphics_count;
+
+   /* Flipped variants of the minitiles that are referenced flipped, and
+    * for each reference the 8x8 indexes to copy, flips already applied */
+   unsigned char      *flipped;
+   unsigned int        flipped_count;
+   const unsigned char **pixels;
+
+   /* Tile ID to tile graphic. 0 means the tile has no graphic */
+   uint16_t            graphics[WAR2_TILESET_TILES_MAX];
+};
+
+/* Sprite a unit is shown with on a map */
+typedef struct
+{
+   Pud_Color    *pixels; /* NULL if the unit has no sprite */
+   int           x; /* Position relative to the footprint of the unit */
+   int           y;
+   unsigned int  w;
+   unsigned int  h;
+} War2_Unit_Sprite;
+
+/* Sprites of the units, per type and per player, loaded on demand */
+typedef struct
+{
+   Pud_Era           era;
+   uint16_t          loaded[PUD_UNIT_NONE]; /* Bitmask of players */
+   War2_Unit_Sprite  sprites[PUD_UNIT_NONE][16];
+} War2_Unit_Sprites;
+
+struct _War2_Encoder
+{
+   War2_Encoder_Format   format;
+   War2_Encoder_Options  opts;
+   void                 *codec; /* State of libpng or libjpeg */
+};
+
 struct _War2_Data
 {
    Pud_Mmap *mem_map;
@@ -52,6 +118,9 @@ struct _War2_Data
    Pud_Color wasteland[WAR2_PALETTE_SIZE];
    Pud_Color swamp[WAR2_PALETTE_SIZE];
 
+   /* Prefetched entries. NULL until something is prefetched */
+   War2_Entry_Cache *cache;
+
    int verbose;
 };
 
@@ -68,5 +137,22 @@ struct _War2_Data
    } while (0)
 
 
+PUDAPI_INTERNAL Pud_Bool war2_entry_get(War2_Data *w2, unsigned int entry, War2_Entry *e);
+PUDAPI_INTERNAL void war2_entry_release(War2_Entry *e);
+PUDAPI_INTERNAL const unsigned int *war2_tileset_entries_get(Pud_Era era);
+PUDAPI_INTERNAL unsigned int war2_workers_count(unsigned int nthreads);
+PUDAPI_INTERNAL void war2_jobs_run(unsigned int jobs, unsigned int nthreads, War2_Job_Func func, void *data);
+PUDAPI_INTERNAL void war2_unit_sprites_init(War2_Unit_Sprites *us, Pud_Era era);
+PUDAPI_INTERNAL void war2_unit_sprites_clear(War2_Unit_Sprites *us);
+PUDAPI_INTERNAL Pud_Bool war2_unit_sprites_load(War2_Data *w2, War2_Unit_Sprites *us, const Pud *pud);
+PUDAPI_INTERNAL const War2_Unit_Sprite *war2_unit_sprite_get(War2_Data *w2, War2_Unit_Sprites *us, unsigned int type, unsigned int player);
+PUDAPI_INTERNAL unsigned char *war2_buffer_reserve(War2_Buffer *buf, size_t size);
+PUDAPI_INTERNAL Pud_Bool war2_buffer_append(War2_Buffer *buf, const void *data, size_t size);
+PUDAPI_INTERNAL Pud_Bool war2_png_encoder_init(War2_Encoder *enc);
+PUDAPI_INTERNAL void war2_png_encoder_clear(War2_Encoder *enc);
+PUDAPI_INTERNAL Pud_Bool war2_png_encoder_encode(War2_Encoder *enc, FILE *f, War2_Buffer *buf, unsigned int w, unsigned int h, const unsigned char *data, const Pud_Color *palette, int transparent);
+PUDAPI_INTERNAL Pud_Bool war2_jpeg_encoder_init(War2_Encoder *enc);
+PUDAPI_INTERNAL void war2_jpeg_encoder_clear(War2_Encoder *enc);
+PUDAPI_INTERNAL Pud_Bool war2_jpeg_encoder_encode(War2_Encoder *enc, FILE *f, War2_Buffer *buf, unsigned int w, unsigned int h, const unsigned char *data);
 
 #endif /* ! _WAR2_PRIVATE_H_ */
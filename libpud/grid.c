@@ -0,0 +1,319 @@
+/*
+ * Copyright (c) 2014-2016 Jean Guyomarc'h
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "pud_private.h"
+
+/*
+ * The occupancy grid buckets the units by the cell of their top-left
+ * corner. Each cell is the head of a doubly-linked list of units, whose
+ * links are stored per unit, so that adding, moving and removing a unit
+ * are O(1). Footprints span at most max_w x max_h cells: the units that
+ * cover a cell are anchored in the max_w x max_h cells above and to the
+ * left of it.
+ *
+ * Links and heads hold indexes of units plus one, 0 ending the lists.
+ */
+struct _Pud_Grid
+{
+   unsigned int *heads; /* Per cell */
+   unsigned int *prev; /* Per unit */
+   unsigned int *next; /* Per unit */
+   unsigned int  links_alloc;
+   unsigned int  max_w;
+   unsigned int  max_h;
+};
+
+static inline unsigned int
+_anchor_get(const Pud           *pud,
+            const Pud_Unit_Info *u)
+{
+   /* Units out of the map (from a file) cover no cells of the map: they
+    * are only kept in the lists */
+   const unsigned int x = (u->x < pud->map_w) ? u->x : pud->map_w - 1;
+   const unsigned int y = (u->y < pud->map_h) ? u->y : pud->map_h - 1;
+
+   return (y * pud->map_w) + x;
+}
+
+static void
+_link(Pud          *pud,
+      unsigned int  index)
+{
+   Pud_Grid *const grid = pud->private_data->grid;
+   const unsigned int cell = _anchor_get(pud, &(pud->units[index]));
+   const unsigned int head = grid->heads[cell];
+   unsigned int w, h;
+
+   grid->prev[index] = 0;
+   grid->next[index] = head;
+   if (head) grid->prev[head - 1] = index + 1;
+   grid->heads[cell] = index + 1;
+
+   pud_unit_footprint_get(pud, &(pud->units[index]), &w, &h);
+   if (w > grid->max_w) grid->max_w = w;
+   if (h > grid->max_h) grid->max_h = h;
+}
+
+static void
+_unlink(Pud          *pud,
+        unsigned int  index,
+        unsigned int  cell)
+{
+   Pud_Grid *const grid = pud->private_data->grid;
+   const unsigned int prev = grid->prev[index];
+   const unsigned int next = grid->next[index];
+
+   if (prev) grid->next[prev - 1] = next;
+   else grid->heads[cell] = next;
+   if (next) grid->prev[next - 1] = prev;
+}
+
+PUDAPI_INTERNAL Pud_Bool
+pud_grid_reserve(Pud          *pud,
+                 unsigned int  count)
+{
+   Pud_Grid *const grid = pud->private_data->grid;
+   void *ptr;
+
+   if ((!grid) || (count <= grid->links_alloc)) return PUD_TRUE;
+
+   ptr = realloc(grid->prev, count * sizeof(unsigned int));
+   if (!ptr) DIE_RETURN(PUD_FALSE, "Failed to allocate memory");
+   grid->prev = ptr;
+   ptr = realloc(grid->next, count * sizeof(unsigned int));
+   if (!ptr) DIE_RETURN(PUD_FALSE, "Failed to allocate memory");
+   grid->next = ptr;
+   grid->links_alloc = count;
+
+   return PUD_TRUE;
+}
+
+PUDAPI_INTERNAL void
+pud_grid_unit_add(Pud          *pud,
+                  unsigned int  index)
+{
+   if (pud->private_data->grid) _link(pud, index);
+}
+
+PUDAPI_INTERNAL void
+pud_grid_unit_move(Pud                 *pud,
+                   unsigned int         index,
+                   const Pud_Unit_Info *from)
+{
+   if (!pud->private_data->grid) return;
+
+   _unlink(pud, index, _anchor_get(pud, from));
+   _link(pud, index);
+}
+
+PUDAPI_INTERNAL void
+pud_grid_unit_remove(Pud                 *pud,
+                     unsigned int         index,
+                     const Pud_Unit_Info *removed,
+                     unsigned int         last)
+{
+   Pud_Grid *const grid = pud->private_data->grid;
+   unsigned int prev, next;
+
+   if (!grid) return;
+
+   /* The removed unit was at @index, the last one now is */
+   _unlink(pud, index, _anchor_get(pud, removed));
+   if (index == last) return;
+
+   /* Whoever pointed to the last unit now points to its new index */
+   prev = grid->prev[last];
+   next = grid->next[last];
+   if (prev) grid->next[prev - 1] = index + 1;
+   else grid->heads[_anchor_get(pud, &(pud->units[index]))] = index + 1;
+   if (next) grid->prev[next - 1] = index + 1;
+   grid->prev[index] = prev;
+   grid->next[index] = next;
+}
+
+PUDAPI_INTERNAL Pud_Bool
+pud_grid_build(Pud *pud)
+{
+   Pud_Private *const priv = pud->private_data;
+   Pud_Grid *grid = priv->grid;
+   unsigned int i;
+
+   if (!grid)
+     {
+        grid = calloc(1, sizeof(Pud_Grid));
+        if (!grid) DIE_RETURN(PUD_FALSE, "Failed to allocate memory");
+        priv->grid = grid;
+     }
+
+   free(grid->heads);
+   grid->heads = calloc(pud->tiles ? pud->tiles : 1, sizeof(unsigned int));
+   if ((!grid->heads) || (!pud_grid_reserve(pud, priv->units_alloc)))
+     {
+        pud_grid_free(pud);
+        DIE_RETURN(PUD_FALSE, "Failed to allocate memory");
+     }
+
+   grid->max_w = 1;
+   grid->max_h = 1;
+   if (pud->tiles)
+     {
+        /* Built backwards, so each list is in increasing order of units */
+        for (i = pud->units_count; i > 0; i--)
+          _link(pud, i - 1);
+     }
+
+   return PUD_TRUE;
+}
+
+PUDAPI_INTERNAL void
+pud_grid_free(Pud *pud)
+{
+   Pud_Grid *const grid = pud->private_data->grid;
+
+   if (!grid) return;
+
+   free(grid->heads);
+   free(grid->prev);
+   free(grid->next);
+   free(grid);
+   pud->private_data->grid = NULL;
+}
+
+/*
+ * Finds the units whose footprint intersects [x0,x1[ x [y0,y1[. Returns
+ * how many there are, but stores at most @max of their indexes. With
+ * @first_only, stops at the first unit found.
+ */
+static unsigned int
+_units_find(const Pud    *pud,
+            unsigned int  x0,
+            unsigned int  y0,
+            unsigned int  x1,
+            unsigned int  y1,
+            unsigned int *indexes,
+            unsigned int  max,
+            Pud_Bool      first_only)
+{
+   const Pud_Grid *const grid = pud->private_data->grid;
+   const Pud_Unit_Info *u;
+   unsigned int ax0, ay0, ax, ay, i, w, h, found = 0;
+
+   if (x1 > pud->map_w) x1 = pud->map_w;
+   if (y1 > pud->map_h) y1 = pud->map_h;
+   if ((x0 >= x1) || (y0 >= y1)) return 0;
+
+#define FOUND(idx_) \
+   do { \
+      u = &(pud->units[idx_]); \
+      pud_unit_footprint_get(pud, u, &w, &h); \
+      if ((u->x < x1) && (u->y < y1) && \
+          (u->x + w > x0) && (u->y + h > y0)) \
+        { \
+           if (found < max) indexes[found] = (idx_); \
+           found++; \
+           if (first_only) return found; \
+        } \
+   } while (0)
+
+   if (!grid)
+     {
+        for (i = 0; i < pud->units_count; i++)
+          FOUND(i);
+        return found;
+     }
+
+   /* Units anchored up to max_w - 1 cells left (max_h - 1 above) of the
+    * area may stick into it */
+   ax0 = (x0 >= grid->max_w - 1) ? x0 - (grid->max_w - 1) : 0;
+   ay0 = (y0 >= grid->max_h - 1) ? y0 - (grid->max_h - 1) : 0;
+   for (ay = ay0; ay < y1; ay++)
+     for (ax = ax0; ax < x1; ax++)
+       for (i = grid->heads[ay * pud->map_w + ax]; i; i = grid->next[i - 1])
+         FOUND(i - 1);
+
+#undef FOUND
+
+   return found;
+}
+
+PUDAPI Pud_Bool
+pud_units_grid_enable(Pud      *pud,
+                      Pud_Bool  enable)
+{
+   PUD_SANITY_CHECK(pud, PUD_OPEN_MODE_R, PUD_FALSE);
+
+   if (!enable)
+     {
+        pud_grid_free(pud);
+        return PUD_TRUE;
+     }
+   return pud_grid_build(pud);
+}
+
+PUDAPI unsigned int
+pud_units_at(const Pud    *pud,
+             unsigned int  x,
+             unsigned int  y,
+             unsigned int *indexes,
+             unsigned int  max)
+{
+   PUD_SANITY_CHECK(pud, PUD_OPEN_MODE_R, 0);
+
+   if (!indexes) max = 0;
+   return _units_find(pud, x, y, x + 1, y + 1, indexes, max, PUD_FALSE);
+}
+
+PUDAPI unsigned int
+pud_units_in_rect(const Pud      *pud,
+                  const Pud_Rect *rect,
+                  unsigned int   *indexes,
+                  unsigned int    max)
+{
+   PUD_SANITY_CHECK(pud, PUD_OPEN_MODE_R, 0);
+
+   if (!rect) DIE_RETURN(0, "Invalid rectangle");
+   if (!indexes) max = 0;
+   /* Areas sticking out of the map are clipped */
+   return _units_find(pud, rect->x, rect->y,
+                      (rect->w > UINT_MAX - rect->x) ? UINT_MAX : rect->x + rect->w,
+                      (rect->h > UINT_MAX - rect->y) ? UINT_MAX : rect->y + rect->h,
+                      indexes, max, PUD_FALSE);
+}
+
+PUDAPI Pud_Bool
+pud_footprint_free(const Pud      *pud,
+                   const Pud_Rect *rect)
+{
+   PUD_SANITY_CHECK(pud, PUD_OPEN_MODE_R, PUD_FALSE);
+
+   if (!rect) DIE_RETURN(PUD_FALSE, "Invalid rectangle");
+
+   /* Out of the map is never free */
+   if ((rect->w == 0) || (rect->h == 0) ||
+       (rect->x >= pud->map_w) || (rect->y >= pud->map_h) ||
+       (rect->w > pud->map_w - rect->x) || (rect->h > pud->map_h - rect->y))
+     return PUD_FALSE;
+
+   return (_units_find(pud, rect->x, rect->y, rect->x + rect->w,
+                       rect->y + rect->h, NULL, 0, PUD_TRUE) == 0);
+}
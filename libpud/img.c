@@ -20,66 +20,597 @@
  * DEALINGS IN THE SOFTWARE.
  */
 
+
 #include "pud_private.h"
 
-PUDAPI unsigned char *
-pud_minimap_bitmap_generate(const Pud        *pud,
-                            unsigned int     *size_ret,
-                            Pud_Pixel_Format  pfmt)
+/*
+ * The minimap is gathered from the dense color tables of the era (see
+ * tiles.c). When the target has the size of the map and 32-bits pixels,
+ * this is done straight into it at one pixel per tile. Otherwise, each
+ * target pixel averages the box of tiles it covers when downscaling, and
+ * picks its nearest tile when upscaling. Units are then painted over the
+ * target pixels whose box meets their footprint, so they stay visible
+ * once downscaled.
+ */
+
+static int
+_lut_format(Pud_Pixel_Format pfmt)
 {
-   PUD_SANITY_CHECK(pud, PUD_OPEN_MODE_R, NULL);
+   switch (pfmt)
+     {
+      case PUD_PIXEL_FORMAT_RGBA: return PUD_PIXEL_FORMAT_RGBA;
+      /* Same bytes, see Pud_Pixel_Format */
+      case PUD_PIXEL_FORMAT_ARGB:
+      case PUD_PIXEL_FORMAT_BGRA: return PUD_PIXEL_FORMAT_ARGB;
+      default: return -1;
+     }
+}
 
-   unsigned char *map;
-   Pud_Unit_Info *u;
+static inline void
+_pixel_store(unsigned char    *px,
+             Pud_Color         c,
+             Pud_Pixel_Format  pfmt)
+{
+   uint16_t rgb565;
+
+   switch (pfmt)
+     {
+      case PUD_PIXEL_FORMAT_RGBA:
+         px[0] = c.r; px[1] = c.g; px[2] = c.b; px[3] = c.a;
+         break;
+
+      case PUD_PIXEL_FORMAT_ARGB:
+      case PUD_PIXEL_FORMAT_BGRA:
+         px[0] = c.b; px[1] = c.g; px[2] = c.r; px[3] = c.a;
+         break;
+
+      case PUD_PIXEL_FORMAT_RGB:
+         px[0] = c.r; px[1] = c.g; px[2] = c.b;
+         break;
+
+      case PUD_PIXEL_FORMAT_RGB565:
+         rgb565 = ((c.r >> 3) << 11) | ((c.g >> 2) << 5) | (c.b >> 3);
+         memcpy(px, &rgb565, sizeof(rgb565));
+         break;
+     }
+}
+
+static Pud_Bool
+_unit_clip(const Pud           *pud,
+           const Pud_Unit_Info *u,
+           unsigned int        *w,
+           unsigned int        *h)
+{
+   if ((u->x >= pud->map_w) || (u->y >= pud->map_h)) return PUD_FALSE;
+
+   /* Footprints may stick out of the map */
+   *w = pud->units_descr[u->type].size_w;
+   *h = pud->units_descr[u->type].size_h;
+   if (u->x + *w > pud->map_w) *w = pud->map_w - u->x;
+   if (u->y + *h > pud->map_h) *h = pud->map_h - u->y;
+
+   return PUD_TRUE;
+}
+
+/*
+ * Gathers the map at one pixel per tile, in a 32-bits pixel format that
+ * has a color table.
+ */
+static void
+_minimap_gather(const Pud                *pud,
+                unsigned char            *dst,
+                unsigned int              stride,
+                int                       lut_fmt,
+                Pud_Minimap_Render_Flags  flags)
+{
+   const uint32_t *lut;
+   const uint16_t *tiles;
+   const Pud_Unit_Info *u;
+   unsigned char *row;
+   uint32_t px;
+   unsigned int x, y, i, w, h, handled;
+   unsigned int unhandled = 0;
+   uint16_t t;
+
+   lut = pud_minimap_lut_get(pud->era, lut_fmt, &handled);
+
+   /* A branchless gather the compiler can unroll (or vectorize). Tiles
+    * out of the table all share its last, flashy, entry */
+   for (y = 0; y < pud->map_h; y++)
+     {
+        tiles = &(pud->tiles_map[y * pud->map_w]);
+        row = dst + (size_t)y * stride;
+        for (x = 0; x < pud->map_w; x++)
+          {
+             t = tiles[x];
+             unhandled += (t >= handled);
+             px = lut[(t < PUD_MINIMAP_LUT_SIZE) ? t : PUD_MINIMAP_LUT_SIZE - 1];
+             memcpy(&(row[x * 4]), &px, sizeof(px));
+          }
+     }
+   if (unhandled)
+     ERR("%u unhandled tiles for era %s", unhandled, pud_era_to_string(pud->era));
+
+   if (flags & PUD_MINIMAP_RENDER_NO_UNITS) return;
+   for (i = 0; i < pud->units_count; i++)
+     {
+        u = &(pud->units[i]);
+        if (!_unit_clip(pud, u, &w, &h)) continue;
+        px = pud_minimap_color_pack(pud_minimap_color_for_unit(u->type, u->player),
+                                    lut_fmt);
+
+        for (y = u->y; y < u->y + h; y++)
+          {
+             row = dst + (size_t)y * stride;
+             for (x = u->x; x < u->x + w; x++)
+               memcpy(&(row[x * 4]), &px, sizeof(px));
+          }
+     }
+}
+
+/*
+ * Target pixels [d0,d1[ (out of dn) whose box of source cells (out of sn)
+ * meets the cells [a,b[. The boxes cover one cell when upscaling or
+ * picking the nearest cell, and partition the cells otherwise.
+ */
+static inline void
+_target_span(unsigned int  a,
+             unsigned int  b,
+             unsigned int  sn,
+             unsigned int  dn,
+             Pud_Bool      nearest,
+             unsigned int *d0,
+             unsigned int *d1)
+{
+   if ((nearest) || (dn >= sn)) *d0 = (a * dn + sn - 1) / sn;
+   else *d0 = ((a + 1) * dn + sn - 1) / sn - 1;
+   *d1 = (b * dn + sn - 1) / sn;
+   if (*d1 > dn) *d1 = dn;
+}
+
+static void
+_minimap_scale(const Pud                *pud,
+               unsigned char            *dst,
+               unsigned int              dst_w,
+               unsigned int              dst_h,
+               unsigned int              stride,
+               Pud_Pixel_Format          pfmt,
+               Pud_Minimap_Render_Flags  flags)
+{
+   const unsigned int sw = pud->map_w, sh = pud->map_h;
+   const unsigned int bpp = pud_pixel_format_size_get(pfmt);
+   const Pud_Bool nearest = !!(flags & PUD_MINIMAP_RENDER_NEAREST);
+   const Pud_Unit_Info *u;
+   const uint32_t *lut;
+   const uint16_t *tiles;
+   unsigned int dx, dy, sx, sy, sx0, sx1, sy0, sy1, n, i, w, h, handled;
+   unsigned int dx0, dx1, dy0, dy1;
+   unsigned int unhandled = 0;
+   unsigned int sum[4];
+   unsigned char *row;
    Pud_Color c;
-   unsigned int i, j, k;
-   int idx;
-   unsigned int size;
-   uint16_t w, h;
-   const Pud_Era era = pud->era;
-   const unsigned int delta[2][4] = {
-      [PUD_PIXEL_FORMAT_RGBA] = {
-         0, 1, 2, 3
-      },
-      [PUD_PIXEL_FORMAT_ARGB] = {
-         2, 1, 0, 3
-      }
-   };
-
-   size = pud->tiles * 4;
-   map = malloc(size * sizeof(unsigned char));
-   if (!map) DIE_RETURN(NULL, "Failed to allocate memory");
+   uint16_t t;
 
-   for (i = 0, idx = 0; i < pud->tiles; i++, idx += 4)
+   lut = pud_minimap_lut_get(pud->era, PUD_PIXEL_FORMAT_RGBA, &handled);
+
+   /* Tiles are looked up as they are sampled: the LUT is in RGBA, which
+    * has the bytes of a Pud_Color */
+   for (dy = 0; dy < dst_h; dy++)
      {
-        c = pud_minimap_tile_to_color(era, pud->tiles_map[i]);
+        /* Box of the tiles covered by the row. At least one tile */
+        sy0 = (dy * sh) / dst_h;
+        sy1 = ((dy + 1) * sh) / dst_h;
+        if ((sy1 <= sy0) || (nearest)) sy1 = sy0 + 1;
+        row = dst + (size_t)dy * stride;
+
+        for (dx = 0; dx < dst_w; dx++)
+          {
+             sx0 = (dx * sw) / dst_w;
+             sx1 = ((dx + 1) * sw) / dst_w;
+             if ((sx1 <= sx0) || (nearest)) sx1 = sx0 + 1;
 
-        map[idx + delta[pfmt][0]] = c.r;
-        map[idx + delta[pfmt][1]] = c.g;
-        map[idx + delta[pfmt][2]] = c.b;
-        map[idx + delta[pfmt][3]] = c.a;
+             sum[0] = sum[1] = sum[2] = sum[3] = 0;
+             for (sy = sy0; sy < sy1; sy++)
+               {
+                  tiles = &(pud->tiles_map[sy * sw]);
+                  for (sx = sx0; sx < sx1; sx++)
+                    {
+                       t = tiles[sx];
+                       unhandled += (t >= handled);
+                       memcpy(&c, &(lut[(t < PUD_MINIMAP_LUT_SIZE) ?
+                                        t : PUD_MINIMAP_LUT_SIZE - 1]),
+                              sizeof(c));
+                       sum[0] += c.r;
+                       sum[1] += c.g;
+                       sum[2] += c.b;
+                       sum[3] += c.a;
+                    }
+               }
+             n = (sx1 - sx0) * (sy1 - sy0);
+             c.r = (sum[0] + n / 2) / n;
+             c.g = (sum[1] + n / 2) / n;
+             c.b = (sum[2] + n / 2) / n;
+             c.a = (sum[3] + n / 2) / n;
+             _pixel_store(&(row[dx * bpp]), c, pfmt);
+          }
      }
+   if (unhandled)
+     ERR("%u unhandled tiles for era %s", unhandled, pud_era_to_string(pud->era));
 
+   if (flags & PUD_MINIMAP_RENDER_NO_UNITS) return;
    for (i = 0; i < pud->units_count; i++)
      {
         u = &(pud->units[i]);
+        if (!_unit_clip(pud, u, &w, &h)) continue;
+        _target_span(u->x, u->x + w, sw, dst_w, nearest, &dx0, &dx1);
+        _target_span(u->y, u->y + h, sh, dst_h, nearest, &dy0, &dy1);
+        if ((dx0 >= dx1) || (dy0 >= dy1)) continue;
+
         c = pud_minimap_color_for_unit(u->type, u->player);
+        for (dy = dy0; dy < dy1; dy++)
+          {
+             row = dst + (size_t)dy * stride;
+             for (dx = dx0; dx < dx1; dx++)
+               _pixel_store(&(row[dx * bpp]), c, pfmt);
+          }
+     }
+}
+
+/*
+ * A live minimap keeps a bitmap of the map at one pixel per tile, and
+ * repaints only the cells of each notified change. Only the units that
+ * overlap the repainted area are drawn over it: they are looked up with
+ * pud_units_in_rect(), which uses the occupancy grid when it is enabled
+ * (see pud_units_grid_enable()).
+ */
+
+/* Units looked up per repainted area before falling back to all of them */
+#define MINIMAP_AREA_UNITS 64
+struct _Pud_Minimap
+{
+   Pud              *pud;
+   unsigned char    *pixels;
+   unsigned int      stride;
+   unsigned int      bpp;
+   Pud_Pixel_Format  pfmt;
+   int               lut_fmt;
+
+   /* Area repainted since pud_minimap_damage_get() was last called */
+   Pud_Bool          damaged;
+   unsigned int      dmg_x0;
+   unsigned int      dmg_y0;
+   unsigned int      dmg_x1;
+   unsigned int      dmg_y1;
+};
+
+static void
+_minimap_damage_add(Pud_Minimap  *mm,
+                    unsigned int  x,
+                    unsigned int  y,
+                    unsigned int  w,
+                    unsigned int  h)
+{
+   if (!mm->damaged)
+     {
+        mm->damaged = PUD_TRUE;
+        mm->dmg_x0 = x;
+        mm->dmg_y0 = y;
+        mm->dmg_x1 = x + w;
+        mm->dmg_y1 = y + h;
+        return;
+     }
+   if (x < mm->dmg_x0) mm->dmg_x0 = x;
+   if (y < mm->dmg_y0) mm->dmg_y0 = y;
+   if (x + w > mm->dmg_x1) mm->dmg_x1 = x + w;
+   if (y + h > mm->dmg_y1) mm->dmg_y1 = y + h;
+}
+
+static inline void
+_minimap_pixel_put(const Pud_Minimap *mm,
+                   unsigned char     *px,
+                   uint32_t           packed)
+{
+   Pud_Color c;
+
+   if (mm->lut_fmt >= 0)
+     memcpy(px, &packed, sizeof(packed));
+   else
+     {
+        /* Packed in RGBA: the bytes of a Pud_Color */
+        memcpy(&c, &packed, sizeof(c));
+        _pixel_store(px, c, mm->pfmt);
+     }
+}
+
+static void
+_minimap_unit_paint(Pud_Minimap         *mm,
+                    const Pud_Unit_Info *u,
+                    unsigned int         x0,
+                    unsigned int         y0,
+                    unsigned int         x1,
+                    unsigned int         y1)
+{
+   const Pud *const pud = mm->pud;
+   const int fmt = (mm->lut_fmt >= 0) ? mm->lut_fmt : PUD_PIXEL_FORMAT_RGBA;
+   unsigned int x, y, w, h;
+   uint32_t px;
+
+   if (!_unit_clip(pud, u, &w, &h)) return;
 
-        w = pud->units_descr[u->type].size_w;
-        h = pud->units_descr[u->type].size_h;
+   /* Only the part of the footprint within [x0,x1[ x [y0,y1[ */
+   if (u->x > x0) x0 = u->x;
+   if (u->y > y0) y0 = u->y;
+   if (u->x + w < x1) x1 = u->x + w;
+   if (u->y + h < y1) y1 = u->y + h;
+   if ((x0 >= x1) || (y0 >= y1)) return;
 
-        for (j = 0; j < w; j++)
+   px = pud_minimap_color_pack(pud_minimap_color_for_unit(u->type, u->player),
+                               fmt);
+   for (y = y0; y < y1; y++)
+     for (x = x0; x < x1; x++)
+       _minimap_pixel_put(mm, mm->pixels + (size_t)y * mm->stride + x * mm->bpp,
+                          px);
+}
+
+static void
+_minimap_area_paint(Pud_Minimap  *mm,
+                    unsigned int  x0,
+                    unsigned int  y0,
+                    unsigned int  w,
+                    unsigned int  h)
+{
+   const Pud *const pud = mm->pud;
+   const int fmt = (mm->lut_fmt >= 0) ? mm->lut_fmt : PUD_PIXEL_FORMAT_RGBA;
+   const uint32_t *lut;
+   unsigned int indexes[MINIMAP_AREA_UNITS];
+   unsigned int x, y, i, j, idx, count, handled;
+   unsigned char *row;
+   Pud_Rect rect;
+   uint16_t t;
+
+   if ((x0 >= pud->map_w) || (y0 >= pud->map_h)) return;
+   if (x0 + w > pud->map_w) w = pud->map_w - x0;
+   if (y0 + h > pud->map_h) h = pud->map_h - y0;
+
+   lut = pud_minimap_lut_get(pud->era, fmt, &handled);
+   if (!lut) return;
+
+   /* Tiles first... */
+   for (y = y0; y < y0 + h; y++)
+     {
+        row = mm->pixels + (size_t)y * mm->stride;
+        for (x = x0; x < x0 + w; x++)
           {
-             for (k = 0; k < h; k++)
-               {
-                  idx = (((u->y + k)* pud->map_w) + (u->x + j)) * 4;
+             t = pud->tiles_map[y * pud->map_w + x];
+             _minimap_pixel_put(mm, &(row[x * mm->bpp]),
+                                lut[(t < PUD_MINIMAP_LUT_SIZE) ?
+                                t : PUD_MINIMAP_LUT_SIZE - 1]);
+          }
+     }
 
-                  map[idx + delta[pfmt][0]] = c.r;
-                  map[idx + delta[pfmt][1]] = c.g;
-                  map[idx + delta[pfmt][2]] = c.b;
-                  map[idx + delta[pfmt][3]] = c.a;
-               }
+   /* ... then the units over them, in the order they are drawn */
+   rect.x = x0;
+   rect.y = y0;
+   rect.w = w;
+   rect.h = h;
+   count = pud_units_in_rect(pud, &rect, indexes, MINIMAP_AREA_UNITS);
+   if (count > MINIMAP_AREA_UNITS)
+     {
+        for (i = 0; i < pud->units_count; i++)
+          _minimap_unit_paint(mm, &(pud->units[i]), x0, y0, x0 + w, y0 + h);
+     }
+   else
+     {
+        /* Found in no particular order */
+        for (i = 1; i < count; i++)
+          {
+             idx = indexes[i];
+             for (j = i; (j > 0) && (indexes[j - 1] > idx); j--)
+               indexes[j] = indexes[j - 1];
+             indexes[j] = idx;
           }
+        for (i = 0; i < count; i++)
+          _minimap_unit_paint(mm, &(pud->units[indexes[i]]),
+                              x0, y0, x0 + w, y0 + h);
+     }
+
+   _minimap_damage_add(mm, x0, y0, w, h);
+}
+
+static void
+_minimap_change_cb(void             *data,
+                   Pud              *pud,
+                   const Pud_Change *change)
+{
+   Pud_Minimap *const mm = data;
+   unsigned int x1, y1;
+
+   switch (change->type)
+     {
+      case PUD_CHANGE_UNIT_ADD:
+         /* The last unit is drawn over everything else */
+         x1 = change->x + change->w;
+         y1 = change->y + change->h;
+         _minimap_unit_paint(mm, change->info,
+                             change->x, change->y, x1, y1);
+         if (x1 > pud->map_w) x1 = pud->map_w;
+         if (y1 > pud->map_h) y1 = pud->map_h;
+         _minimap_damage_add(mm, change->x, change->y,
+                             x1 - change->x, y1 - change->y);
+         break;
+
+      case PUD_CHANGE_UNIT_MOVE:
+         /* Uncover what was under the unit, then draw it at its place */
+         _minimap_area_paint(mm, change->from_x, change->from_y,
+                             change->w, change->h);
+         _minimap_area_paint(mm, change->x, change->y, change->w, change->h);
+         break;
+
+      case PUD_CHANGE_TILE:
+      case PUD_CHANGE_UNIT_DEL:
+         _minimap_area_paint(mm, change->x, change->y, change->w, change->h);
+         break;
+     }
+}
+
+PUDAPI Pud_Minimap *
+pud_minimap_new(Pud              *pud,
+                Pud_Pixel_Format  pfmt)
+{
+   PUD_SANITY_CHECK(pud, PUD_OPEN_MODE_R, NULL);
+
+   Pud_Minimap *mm;
+
+   mm = calloc(1, sizeof(Pud_Minimap));
+   if (!mm) DIE_RETURN(NULL, "Failed to allocate memory");
+
+   mm->pud = pud;
+   mm->pfmt = pfmt;
+   mm->bpp = pud_pixel_format_size_get(pfmt);
+   mm->lut_fmt = _lut_format(pfmt);
+   mm->stride = pud->map_w * mm->bpp;
+   if (!mm->bpp) DIE_GOTO(fail, "Invalid pixel format [%i]", pfmt);
+
+   mm->pixels = malloc((size_t)mm->stride * pud->map_h);
+   if (!mm->pixels) DIE_GOTO(fail, "Failed to allocate memory");
+
+   if (!pud_minimap_render(pud, mm->pixels, pud->map_w, pud->map_h,
+                           mm->stride, pfmt, PUD_MINIMAP_RENDER_DEFAULT))
+     goto fail;
+   _minimap_damage_add(mm, 0, 0, pud->map_w, pud->map_h);
+
+   if (!pud_change_callback_add(pud, _minimap_change_cb, mm))
+     goto fail;
+
+   return mm;
+
+fail:
+   free(mm->pixels);
+   free(mm);
+   return NULL;
+}
+
+PUDAPI void
+pud_minimap_free(Pud_Minimap *mm)
+{
+   if (!mm) return;
+
+   pud_change_callback_del(mm->pud, _minimap_change_cb, mm);
+   free(mm->pixels);
+   free(mm);
+}
+
+PUDAPI const unsigned char *
+pud_minimap_pixels_get(const Pud_Minimap *mm,
+                       unsigned int      *stride)
+{
+   if (!mm) DIE_RETURN(NULL, "Invalid minimap");
+
+   if (stride) *stride = mm->stride;
+   return mm->pixels;
+}
+
+PUDAPI Pud_Bool
+pud_minimap_damage_get(Pud_Minimap  *mm,
+                       unsigned int *x,
+                       unsigned int *y,
+                       unsigned int *w,
+                       unsigned int *h)
+{
+   if ((!mm) || (!mm->damaged)) return PUD_FALSE;
+
+   if (x) *x = mm->dmg_x0;
+   if (y) *y = mm->dmg_y0;
+   if (w) *w = mm->dmg_x1 - mm->dmg_x0;
+   if (h) *h = mm->dmg_y1 - mm->dmg_y0;
+   mm->damaged = PUD_FALSE;
+
+   return PUD_TRUE;
+}
+
+PUDAPI Pud_Bool
+pud_minimap_refresh(Pud_Minimap *mm)
+{
+   if (!mm) DIE_RETURN(PUD_FALSE, "Invalid minimap");
+
+   if (!pud_minimap_render(mm->pud, mm->pixels, mm->pud->map_w,
+                           mm->pud->map_h, mm->stride, mm->pfmt,
+                           PUD_MINIMAP_RENDER_DEFAULT))
+     return PUD_FALSE;
+   _minimap_damage_add(mm, 0, 0, mm->pud->map_w, mm->pud->map_h);
+
+   return PUD_TRUE;
+}
+
+PUDAPI unsigned int
+pud_pixel_format_size_get(Pud_Pixel_Format pfmt)
+{
+   switch (pfmt)
+     {
+      case PUD_PIXEL_FORMAT_RGBA:
+      case PUD_PIXEL_FORMAT_ARGB:
+      case PUD_PIXEL_FORMAT_BGRA:   return 4;
+      case PUD_PIXEL_FORMAT_RGB:    return 3;
+      case PUD_PIXEL_FORMAT_RGB565: return 2;
+     }
+   return 0;
+}
+
+PUDAPI Pud_Bool
+pud_minimap_render(const Pud                *pud,
+                   unsigned char            *dst,
+                   unsigned int              dst_w,
+                   unsigned int              dst_h,
+                   unsigned int              stride,
+                   Pud_Pixel_Format          pfmt,
+                   Pud_Minimap_Render_Flags  flags)
+{
+   PUD_SANITY_CHECK(pud, PUD_OPEN_MODE_R, PUD_FALSE);
+
+   const unsigned int bpp = pud_pixel_format_size_get(pfmt);
+   const int lut_fmt = _lut_format(pfmt);
+
+   if (!bpp) DIE_RETURN(PUD_FALSE, "Invalid pixel format [%i]", pfmt);
+   if ((unsigned int)pud->era > PUD_ERA_SWAMP)
+     DIE_RETURN(PUD_FALSE, "Invalid era [%i]", pud->era);
+   if ((!dst) || (dst_w == 0) || (dst_h == 0))
+     DIE_RETURN(PUD_FALSE, "Invalid target");
+   if (stride == 0) stride = dst_w * bpp;
+   else if (stride < dst_w * bpp)
+     DIE_RETURN(PUD_FALSE, "Stride [%u] too small for [%u] pixels", stride, dst_w);
+
+   /* Fast path: no scaling nor conversion */
+   if ((lut_fmt >= 0) && (dst_w == pud->map_w) && (dst_h == pud->map_h))
+     {
+        _minimap_gather(pud, dst, stride, lut_fmt, flags);
+        return PUD_TRUE;
+     }
+
+   _minimap_scale(pud, dst, dst_w, dst_h, stride, pfmt, flags);
+
+   return PUD_TRUE;
+}
+
+PUDAPI unsigned char *
+pud_minimap_bitmap_generate(const Pud        *pud,
+                            unsigned int     *size_ret,
+                            Pud_Pixel_Format  pfmt)
+{
+   PUD_SANITY_CHECK(pud, PUD_OPEN_MODE_R, NULL);
+
+   unsigned char *map;
+   unsigned int size;
+
+   size = pud->tiles * pud_pixel_format_size_get(pfmt);
+   if (size == 0) DIE_RETURN(NULL, "Invalid pixel format [%i]", pfmt);
+   map = malloc(size * sizeof(unsigned char));
+   if (!map) DIE_RETURN(NULL, "Failed to allocate memory");
+
+   if (!pud_minimap_render(pud, map, pud->map_w, pud->map_h, 0, pfmt,
+                           PUD_MINIMAP_RENDER_DEFAULT))
+     {
+        free(map);
+        return NULL;
      }
 
    if (size_ret) *size_ret = size;
@@ -717,10 +717,13 @@ pud_parse_unit(Pud *pud)
    units = chk / 8;
 
    size = sizeof(Pud_Unit_Info) * units;
+   pud->units_count = 0;
+   pud->private_data->units_alloc = 0;
    pud->units = realloc(pud->units, size);
    if (!pud->units) DIE_RETURN(PUD_FALSE, "Failed to allocate memory");
    memset(pud->units, 0, size);
    pud->units_count = units;
+   pud->private_data->units_alloc = units;
 
    for (i = 0; i < units; ++i)
      {
@@ -747,5 +750,9 @@ pud_parse_unit(Pud *pud)
           pud->starting_points++;
      }
 
+   /* The units were replaced */
+   if (pud->private_data->grid)
+     return pud_grid_build(pud);
+
    return PUD_TRUE;
 }
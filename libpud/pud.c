@@ -145,10 +145,89 @@ _private_free(Pud_Private *priv)
      {
         if (priv->mem_map)
           common_file_munmap(priv->mem_map);
+        free(priv->change_cbs);
         free(priv);
      }
 }
 
+PUDAPI_INTERNAL void
+pud_change_emit(Pud              *pud,
+                const Pud_Change *change)
+{
+   Pud_Private *const priv = pud->private_data;
+   unsigned int i, k;
+
+   /* Callbacks may add or remove callbacks (and modify the Pud again).
+    * While emitting, removed callbacks are only cleared, so no slot
+    * moves under the loop. They are compacted once the outermost
+    * emission is over. The count is read again after each call, as
+    * callbacks may be added along the way */
+   priv->change_emitting++;
+   for (i = 0; i < priv->change_cbs_count; ++i)
+     {
+        if (priv->change_cbs[i].cb)
+          priv->change_cbs[i].cb(priv->change_cbs[i].data, pud, change);
+     }
+   priv->change_emitting--;
+
+   if ((priv->change_emitting == 0) && (priv->change_cbs_removed))
+     {
+        for (i = 0, k = 0; i < priv->change_cbs_count; ++i)
+          {
+             if (priv->change_cbs[i].cb)
+               priv->change_cbs[k++] = priv->change_cbs[i];
+          }
+        priv->change_cbs_count = k;
+        priv->change_cbs_removed = PUD_FALSE;
+     }
+}
+
+PUDAPI_INTERNAL void
+pud_unit_footprint_get(const Pud           *pud,
+                       const Pud_Unit_Info *u,
+                       unsigned int        *w,
+                       unsigned int        *h)
+{
+   *w = 0;
+   *h = 0;
+
+   /* The footprint the minimap draws, at least one cell */
+   if ((unsigned int)u->type <
+       sizeof(pud->units_descr) / sizeof(pud->units_descr[0]))
+     {
+        *w = pud->units_descr[u->type].size_w;
+        *h = pud->units_descr[u->type].size_h;
+     }
+   if (*w == 0) *w = 1;
+   if (*h == 0) *h = 1;
+}
+
+static void
+_unit_change_emit(Pud                 *pud,
+                  Pud_Change_Type      type,
+                  unsigned int         index,
+                  const Pud_Unit_Info *u,
+                  unsigned int         from_x,
+                  unsigned int         from_y)
+{
+   unsigned int w, h;
+
+   pud_unit_footprint_get(pud, u, &w, &h);
+
+   const Pud_Change change = {
+      .type   = type,
+      .x      = u->x,
+      .y      = u->y,
+      .w      = w,
+      .h      = h,
+      .unit   = index,
+      .from_x = from_x,
+      .from_y = from_y,
+      .info   = u,
+   };
+   pud_change_emit(pud, &change);
+}
+
 PUDAPI Pud *
 pud_open(const char    *file,
          Pud_Open_Mode  mode)
@@ -218,6 +297,7 @@ PUDAPI void
 pud_close(Pud *pud)
 {
    if (!pud) return;
+   if (pud->private_data) pud_grid_free(pud);
    _private_free(pud->private_data);
    free(pud->units);
    free(pud->tiles_map);
@@ -305,6 +385,11 @@ pud_dimensions_set(Pud            *pud,
 
    pud->tiles = tiles;
    pud->dims = dims;
+
+   /* The cells changed */
+   if (pud->private_data->grid)
+     return pud_grid_build(pud);
+
    return PUD_TRUE;
 }
 
@@ -597,6 +682,57 @@ pud_tag_set(Pud      *pud,
    pud->tag = tag;
 }
 
+static Pud_Bool
+_units_grow(Pud          *pud,
+            unsigned int  count)
+{
+   Pud_Private *const priv = pud->private_data;
+   unsigned int alloc;
+   void *ptr;
+
+   if (count <= priv->units_alloc) return PUD_TRUE;
+
+   /* Grow geometrically, so adding units one by one is amortized O(1) */
+   alloc = (priv->units_alloc < 16) ? 16 : priv->units_alloc;
+   while ((alloc < count) && (alloc <= UINT_MAX / 2))
+     alloc *= 2;
+   if (alloc < count) alloc = count;
+   if (alloc > UINT_MAX / sizeof(Pud_Unit_Info))
+     DIE_RETURN(PUD_FALSE, "Too many units [%u]", count);
+
+   ptr = realloc(pud->units, (size_t)alloc * sizeof(Pud_Unit_Info));
+   /* On failure, keep the units as is */
+   if (ptr == NULL) DIE_RETURN(PUD_FALSE, "Failed to alloc memory");
+   pud->units = ptr;
+   if (!pud_grid_reserve(pud, alloc)) return PUD_FALSE;
+   priv->units_alloc = alloc;
+
+   return PUD_TRUE;
+}
+
+PUDAPI Pud_Bool
+pud_units_reserve(Pud          *pud,
+                  unsigned int  count)
+{
+   PUD_SANITY_CHECK(pud, PUD_OPEN_MODE_W, PUD_FALSE);
+
+   Pud_Private *const priv = pud->private_data;
+   void *ptr;
+
+   /* Exactly what is asked for: the caller knows better */
+   if (count <= priv->units_alloc) return PUD_TRUE;
+   if (count > UINT_MAX / sizeof(Pud_Unit_Info))
+     DIE_RETURN(PUD_FALSE, "Too many units [%u]", count);
+
+   ptr = realloc(pud->units, (size_t)count * sizeof(Pud_Unit_Info));
+   if (ptr == NULL) DIE_RETURN(PUD_FALSE, "Failed to alloc memory");
+   pud->units = ptr;
+   if (!pud_grid_reserve(pud, count)) return PUD_FALSE;
+   priv->units_alloc = count;
+
+   return PUD_TRUE;
+}
+
 PUDAPI Pud_Bool
 pud_unit_add(Pud          *pud,
              unsigned int  x,
@@ -607,10 +743,6 @@ pud_unit_add(Pud          *pud,
 {
    PUD_SANITY_CHECK(pud, PUD_OPEN_MODE_W, PUD_FALSE);
 
-   size_t size;
-   unsigned int nb;
-   void *ptr;
-
    /* Override alter value for unspecified cases */
    if ((unit != PUD_UNIT_GOLD_MINE) && (unit != PUD_UNIT_OIL_PATCH))
      {
@@ -629,19 +761,104 @@ pud_unit_add(Pud          *pud,
       .alter  = alter
    };
 
-   if ((x > pud->map_w - 1) || (y > pud->map_h - 1))
-     DIE_RETURN(PUD_FALSE, "Invalid indexes [%i][%i]", x, y);
+   return pud_units_add_array(pud, &u, 1);
+}
+
+PUDAPI Pud_Bool
+pud_units_add_array(Pud                 *pud,
+                    const Pud_Unit_Info *units,
+                    unsigned int         count)
+{
+   PUD_SANITY_CHECK(pud, PUD_OPEN_MODE_W, PUD_FALSE);
 
-   /* TODO Optimise memory allocation because it is not great */
-   nb = pud->units_count + 1;
-   size = nb * sizeof(Pud_Unit_Info);
-   ptr = realloc(pud->units, size);
-   /* On failure, keep the units as is */
-   if (ptr == NULL) DIE_RETURN(PUD_FALSE, "Failed to alloc memory");
-   pud->units = ptr;
-   memcpy(&(pud->units[pud->units_count]), &u, sizeof(Pud_Unit_Info));
+   unsigned int i, first;
 
-   pud->units_count = nb;
+   if ((!units) && (count)) DIE_RETURN(PUD_FALSE, "Invalid units");
+   if (!count) return PUD_TRUE;
+
+   /* All the units are added, or none of them */
+   for (i = 0; i < count; i++)
+     if ((units[i].x >= pud->map_w) || (units[i].y >= pud->map_h))
+       DIE_RETURN(PUD_FALSE, "Invalid indexes [%i][%i] of unit [%u]",
+                  units[i].x, units[i].y, i);
+   if (count > UINT_MAX - pud->units_count)
+     DIE_RETURN(PUD_FALSE, "Too many units");
+   if (!_units_grow(pud, pud->units_count + count))
+     return PUD_FALSE;
+
+   first = pud->units_count;
+   memcpy(&(pud->units[first]), units, count * sizeof(Pud_Unit_Info));
+   pud->units_count += count;
+   for (i = first; i < pud->units_count; i++)
+     pud_grid_unit_add(pud, i);
+
+   if (pud->private_data->change_cbs_count)
+     {
+        for (i = first; i < pud->units_count; i++)
+          _unit_change_emit(pud, PUD_CHANGE_UNIT_ADD, i, &(pud->units[i]),
+                            pud->units[i].x, pud->units[i].y);
+     }
+
+   return PUD_TRUE;
+}
+
+PUDAPI Pud_Bool
+pud_unit_remove(Pud          *pud,
+                unsigned int  index)
+{
+   PUD_SANITY_CHECK(pud, PUD_OPEN_MODE_W, PUD_FALSE);
+
+   Pud_Unit_Info u;
+   unsigned int last;
+
+   if (index >= pud->units_count)
+     DIE_RETURN(PUD_FALSE, "Invalid unit index [%u]", index);
+
+   /* Keep the unit, its footprint is notified. The last unit takes its
+    * place, so nothing else is moved */
+   u = pud->units[index];
+   last = pud->units_count - 1;
+   pud->units[index] = pud->units[last];
+   pud->units_count = last;
+   pud_grid_unit_remove(pud, index, &u, last);
+
+   if (pud->private_data->change_cbs_count)
+     {
+        _unit_change_emit(pud, PUD_CHANGE_UNIT_DEL, index, &u, u.x, u.y);
+        /* The last unit changed of index, and is now drawn before the
+         * units that followed the removed one */
+        if (index != last)
+          _unit_change_emit(pud, PUD_CHANGE_UNIT_MOVE, index,
+                            &(pud->units[index]), pud->units[index].x,
+                            pud->units[index].y);
+     }
+
+   return PUD_TRUE;
+}
+
+PUDAPI Pud_Bool
+pud_unit_move(Pud          *pud,
+              unsigned int  index,
+              unsigned int  x,
+              unsigned int  y)
+{
+   PUD_SANITY_CHECK(pud, PUD_OPEN_MODE_W, PUD_FALSE);
+
+   Pud_Unit_Info *u, from;
+
+   if (index >= pud->units_count)
+     DIE_RETURN(PUD_FALSE, "Invalid unit index [%u]", index);
+   if ((x >= pud->map_w) || (y >= pud->map_h))
+     DIE_RETURN(PUD_FALSE, "Invalid indexes (x=%u,y=%u)", x, y);
+
+   u = &(pud->units[index]);
+   from = *u;
+   u->x = x;
+   u->y = y;
+   pud_grid_unit_move(pud, index, &from);
+
+   if (pud->private_data->change_cbs_count)
+     _unit_change_emit(pud, PUD_CHANGE_UNIT_MOVE, index, u, from.x, from.y);
 
    return PUD_TRUE;
 }
@@ -658,9 +875,77 @@ pud_tile_set(Pud          *pud,
      DIE_RETURN(PUD_FALSE, "Invalid indexes (x=%u,y=%u)", x, y);
 
    pud->tiles_map[(y * pud->map_w) + x] = tile;
+
+   if (pud->private_data->change_cbs_count)
+     {
+        const Pud_Change change = {
+           .type = PUD_CHANGE_TILE,
+           .x    = x,
+           .y    = y,
+           .w    = 1,
+           .h    = 1,
+           .unit = 0,
+        };
+        pud_change_emit(pud, &change);
+     }
+
    return PUD_TRUE;
 }
 
+PUDAPI Pud_Bool
+pud_change_callback_add(Pud           *pud,
+                        Pud_Change_Cb  cb,
+                        const void    *data)
+{
+   Pud_Private *priv;
+   Pud_Change_Callback *ptr;
+
+   if ((!pud) || (!cb)) DIE_RETURN(PUD_FALSE, "Invalid arguments");
+   priv = pud->private_data;
+
+   ptr = realloc(priv->change_cbs,
+                 (priv->change_cbs_count + 1) * sizeof(Pud_Change_Callback));
+   if (!ptr) DIE_RETURN(PUD_FALSE, "Failed to alloc memory");
+   priv->change_cbs = ptr;
+   priv->change_cbs[priv->change_cbs_count].cb = cb;
+   priv->change_cbs[priv->change_cbs_count].data = (void *)data;
+   priv->change_cbs_count++;
+
+   return PUD_TRUE;
+}
+
+PUDAPI Pud_Bool
+pud_change_callback_del(Pud           *pud,
+                        Pud_Change_Cb  cb,
+                        const void    *data)
+{
+   Pud_Private *priv;
+   unsigned int i;
+
+   if (!pud) return PUD_FALSE;
+   priv = pud->private_data;
+
+   for (i = 0; i < priv->change_cbs_count; ++i)
+     {
+        if ((priv->change_cbs[i].cb == cb) && (priv->change_cbs[i].data == data))
+          {
+             /* Do not move the callbacks being called */
+             if (priv->change_emitting)
+               {
+                  priv->change_cbs[i].cb = NULL;
+                  priv->change_cbs_removed = PUD_TRUE;
+                  return PUD_TRUE;
+               }
+             memmove(&(priv->change_cbs[i]), &(priv->change_cbs[i + 1]),
+                     (priv->change_cbs_count - i - 1) * sizeof(Pud_Change_Callback));
+             priv->change_cbs_count--;
+             return PUD_TRUE;
+          }
+     }
+
+   return PUD_FALSE;
+}
+
 PUDAPI uint16_t
 pud_tile_get(const Pud    *pud,
              unsigned int  x,
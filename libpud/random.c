@@ -21,346 +21,266 @@
  */
 
 #include "pud_private.h"
-#include <stdarg.h>
 
-#define BUF_SIZE 0xf
+/*
+ * Valid variants (the 4 least significant bits) of the tiles, indexed by
+ * bits 4 to 11 of the tile. Solid tiles have no bits set above, boundary
+ * tiles start at index 0x10. Entries without variants are invalid tiles.
+ *
+ * This was first generated by tools/random_gen, then edited by hand to
+ * cover specific cases the generator does not handle: don't rely on the
+ * generator anymore!
+ */
+typedef struct
+{
+   uint8_t count;
+   uint8_t variants[15];
+} Random_Tile;
 
-static unsigned int
-_rands_gen(uint8_t buf[BUF_SIZE], unsigned int count, ...)
+static const Random_Tile _random_tiles[0x100] =
 {
-   va_list args;
-   uint8_t arg;
-   unsigned int k = 0;
+   [0x01] = {  6, { 0x1, 0x2, 0x3, 0x5, 0x6, 0x7 } },
+   [0x02] = {  7, { 0x0, 0x1, 0x2, 0x3, 0x5, 0x6, 0x7 } },
+   [0x03] = { 11, { 0x0, 0x1, 0x2, 0x4, 0x5, 0x6, 0x7, 0x8, 0x9, 0xa, 0xb } },
+   [0x04] = { 11, { 0x0, 0x1, 0x2, 0x4, 0x5, 0x6, 0x7, 0x8, 0x9, 0xa, 0xb } },
+   [0x05] = { 15, { 0x0, 0x1, 0x2, 0x4, 0x5, 0x6, 0x7, 0x8, 0x9, 0xa, 0xb, 0xc, 0xd, 0xe, 0xf } },
+   [0x06] = { 15, { 0x0, 0x1, 0x2, 0x4, 0x5, 0x6, 0x7, 0x8, 0x9, 0xa, 0xb, 0xc, 0xd, 0xe, 0xf } },
+   [0x07] = {  3, { 0x0, 0x1, 0x2 } },
+   [0x08] = {  4, { 0x0, 0x1, 0x2, 0x3 } },
+   [0x09] = {  1, { 0x0 } },
+   [0x0a] = {  1, { 0x0 } },
+   [0x0b] = {  1, { 0x0 } },
+   [0x0c] = {  1, { 0x0 } },
+   [0x10] = {  2, { 0x0, 0x1 } },
+   [0x11] = {  2, { 0x0, 0x1 } },
+   [0x12] = {  3, { 0x0, 0x1, 0x2 } },
+   [0x13] = {  2, { 0x0, 0x1 } },
+   [0x14] = {  3, { 0x0, 0x1, 0x2 } },
+   [0x15] = {  2, { 0x0, 0x1 } },
+   [0x16] = {  2, { 0x0, 0x1 } },
+   [0x17] = {  2, { 0x0, 0x1 } },
+   [0x18] = {  2, { 0x0, 0x1 } },
+   [0x19] = {  3, { 0x0, 0x1, 0x2 } },
+   [0x1a] = {  2, { 0x0, 0x1 } },
+   [0x1b] = {  3, { 0x0, 0x1, 0x2 } },
+   [0x1c] = {  2, { 0x0, 0x1 } },
+   [0x1d] = {  2, { 0x0, 0x1 } },
+   [0x20] = {  2, { 0x0, 0x1 } },
+   [0x21] = {  2, { 0x0, 0x1 } },
+   [0x22] = {  3, { 0x0, 0x1, 0x2 } },
+   [0x23] = {  2, { 0x0, 0x1 } },
+   [0x24] = {  3, { 0x0, 0x1, 0x2 } },
+   [0x25] = {  2, { 0x0, 0x1 } },
+   [0x26] = {  2, { 0x0, 0x1 } },
+   [0x27] = {  2, { 0x0, 0x1 } },
+   [0x28] = {  2, { 0x0, 0x1 } },
+   [0x29] = {  3, { 0x0, 0x1, 0x2 } },
+   [0x2a] = {  2, { 0x0, 0x1 } },
+   [0x2b] = {  3, { 0x0, 0x1, 0x2 } },
+   [0x2c] = {  2, { 0x0, 0x1 } },
+   [0x2d] = {  2, { 0x0, 0x1 } },
+   [0x30] = {  2, { 0x0, 0x1 } },
+   [0x31] = {  2, { 0x0, 0x1 } },
+   [0x32] = {  3, { 0x0, 0x1, 0x2 } },
+   [0x33] = {  2, { 0x0, 0x1 } },
+   [0x34] = {  3, { 0x0, 0x1, 0x2 } },
+   [0x35] = {  2, { 0x0, 0x1 } },
+   [0x36] = {  2, { 0x0, 0x1 } },
+   [0x37] = {  2, { 0x0, 0x1 } },
+   [0x38] = {  2, { 0x0, 0x1 } },
+   [0x39] = {  3, { 0x0, 0x1, 0x2 } },
+   [0x3a] = {  2, { 0x0, 0x1 } },
+   [0x3b] = {  3, { 0x0, 0x1, 0x2 } },
+   [0x3c] = {  2, { 0x0, 0x1 } },
+   [0x3d] = {  2, { 0x0, 0x1 } },
+   [0x40] = {  2, { 0x0, 0x1 } },
+   [0x41] = {  2, { 0x0, 0x1 } },
+   [0x42] = {  2, { 0x0, 0x1 } },
+   [0x43] = {  2, { 0x0, 0x1 } },
+   [0x44] = {  2, { 0x0, 0x1 } },
+   [0x45] = {  2, { 0x0, 0x1 } },
+   [0x46] = {  1, { 0x0 } },
+   [0x47] = {  2, { 0x0, 0x1 } },
+   [0x48] = {  2, { 0x0, 0x1 } },
+   [0x49] = {  2, { 0x0, 0x1 } },
+   [0x4a] = {  1, { 0x0 } },
+   [0x4b] = {  2, { 0x0, 0x1 } },
+   [0x4c] = {  1, { 0x0 } },
+   [0x4d] = {  1, { 0x0 } },
+   [0x50] = {  2, { 0x0, 0x1 } },
+   [0x51] = {  2, { 0x0, 0x1 } },
+   [0x52] = {  3, { 0x0, 0x1, 0x2 } },
+   [0x53] = {  2, { 0x0, 0x1 } },
+   [0x54] = {  3, { 0x0, 0x1, 0x2 } },
+   [0x55] = {  2, { 0x0, 0x1 } },
+   [0x56] = {  2, { 0x0, 0x1 } },
+   [0x57] = {  2, { 0x0, 0x1 } },
+   [0x58] = {  2, { 0x0, 0x1 } },
+   [0x59] = {  3, { 0x0, 0x1, 0x2 } },
+   [0x5a] = {  2, { 0x0, 0x1 } },
+   [0x5b] = {  3, { 0x0, 0x1, 0x2 } },
+   [0x5c] = {  2, { 0x0, 0x1 } },
+   [0x5d] = {  2, { 0x0, 0x1 } },
+   [0x60] = {  2, { 0x0, 0x1 } },
+   [0x61] = {  2, { 0x0, 0x1 } },
+   [0x62] = {  3, { 0x0, 0x1, 0x2 } },
+   [0x63] = {  2, { 0x0, 0x1 } },
+   [0x64] = {  3, { 0x0, 0x1, 0x2 } },
+   [0x65] = {  2, { 0x0, 0x1 } },
+   [0x66] = {  2, { 0x0, 0x1 } },
+   [0x67] = {  2, { 0x0, 0x1 } },
+   [0x68] = {  2, { 0x0, 0x1 } },
+   [0x69] = {  3, { 0x0, 0x1, 0x2 } },
+   [0x6a] = {  2, { 0x0, 0x1 } },
+   [0x6b] = {  3, { 0x0, 0x1, 0x2 } },
+   [0x6c] = {  2, { 0x0, 0x1 } },
+   [0x6d] = {  2, { 0x0, 0x1 } },
+   [0x70] = {  2, { 0x0, 0x1 } },
+   [0x71] = {  2, { 0x0, 0x1 } },
+   [0x72] = {  2, { 0x0, 0x1 } },
+   [0x73] = {  2, { 0x0, 0x1 } },
+   [0x74] = {  2, { 0x0, 0x1 } },
+   [0x75] = {  2, { 0x0, 0x1 } },
+   [0x76] = {  2, { 0x0, 0x1 } },
+   [0x77] = {  2, { 0x0, 0x1 } },
+   [0x78] = {  2, { 0x0, 0x1 } },
+   [0x79] = {  2, { 0x0, 0x1 } },
+   [0x7a] = {  2, { 0x0, 0x1 } },
+   [0x7b] = {  2, { 0x0, 0x1 } },
+   [0x7c] = {  2, { 0x0, 0x1 } },
+   [0x7d] = {  2, { 0x0, 0x1 } },
+   [0x80] = {  1, { 0x0 } },
+   [0x81] = {  1, { 0x0 } },
+   [0x82] = {  1, { 0x0 } },
+   [0x83] = {  1, { 0x0 } },
+   [0x84] = {  2, { 0x0, 0x1 } },
+   [0x85] = {  1, { 0x0 } },
+   [0x86] = {  1, { 0x0 } },
+   [0x87] = {  1, { 0x0 } },
+   [0x88] = {  1, { 0x0 } },
+   [0x89] = {  2, { 0x0, 0x1 } },
+   [0x8a] = {  1, { 0x0 } },
+   [0x8b] = {  1, { 0x0 } },
+   [0x8c] = {  1, { 0x0 } },
+   [0x8d] = {  1, { 0x0 } },
+   [0x90] = {  1, { 0x0 } },
+   [0x91] = {  1, { 0x0 } },
+   [0x92] = {  1, { 0x0 } },
+   [0x93] = {  1, { 0x0 } },
+   [0x94] = {  2, { 0x0, 0x1 } },
+   [0x95] = {  1, { 0x0 } },
+   [0x96] = {  1, { 0x0 } },
+   [0x97] = {  1, { 0x0 } },
+   [0x98] = {  1, { 0x0 } },
+   [0x99] = {  2, { 0x0, 0x1 } },
+   [0x9a] = {  1, { 0x0 } },
+   [0x9b] = {  1, { 0x0 } },
+   [0x9c] = {  1, { 0x0 } },
+};
 
-   va_start(args, count);
-   for (k = 0; k < count; ++k)
-     {
-        arg = (uint8_t)va_arg(args, int);
-        buf[k] = arg;
-     }
-   va_end(args);
+static inline const Random_Tile *
+_random_tile_find(uint16_t tile)
+{
+   const Random_Tile *const rt = &(_random_tiles[(tile >> 4) & 0xff]);
+
+   /* Boundaries (any of the 8 most significant bits set) must have a
+    * boundary index: they never share the entries of solid tiles */
+   if ((tile & 0xff00) && (!(tile & 0x0f00))) return NULL;
+   return (rt->count) ? rt : NULL;
+}
+
+/*
+ * xorshift64* generator, seeded with splitmix64 so that close seeds do
+ * not give close sequences. It is not cryptographic, but fast and the
+ * same on all the platforms for a given seed.
+ */
+static inline uint64_t
+_random_next(uint64_t *state)
+{
+   uint64_t x = *state;
+
+   x ^= x >> 12;
+   x ^= x << 25;
+   x ^= x >> 27;
+   *state = x;
+   return x * UINT64_C(0x2545f4914f6cdd1d);
+}
+
+static inline uint64_t
+_random_seed(uint32_t seed)
+{
+   uint64_t z = (uint64_t)seed + UINT64_C(0x9e3779b97f4a7c15);
 
-   return k;
+   z = (z ^ (z >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+   z = (z ^ (z >> 27)) * UINT64_C(0x94d049bb133111eb);
+   z ^= z >> 31;
+   return (z) ? z : 1; /* The state must never be 0 */
 }
 
 PUDAPI uint8_t
 pud_random_tile_get(uint16_t tile)
 {
-   uint8_t rands[BUF_SIZE];
-   unsigned int count = 0;
+   const Random_Tile *const rt = _random_tile_find(tile);
+
+   if (!rt)
+     {
+        ERR("Invalid tile 0x%04x", tile);
+        return 0x00;
+     }
+   return rt->variants[rand() % rt->count];
+}
 
-#define GEN(cnt, ...) count = _rands_gen(rands, cnt, __VA_ARGS__)
+PUDAPI Pud_Bool
+pud_tiles_randomize(Pud            *pud,
+                    uint32_t        seed,
+                    const Pud_Rect *region)
+{
+   PUD_SANITY_CHECK(pud, PUD_OPEN_MODE_W, PUD_FALSE);
 
-   /* =====================================================
-    *
-    * The code below has been generated by tools/random_gen
-    *
-    * ==================== BIG FAT WARNING ================
-    *
-    * DON'T RELY ON THE GENERATOR ANYMORE!!! THE CODE HAS
-    * BEEN EDITED BY HAND TO COVER SPECIFIC CASES THE
-    * GENERATOR DOES NOT HANDLE (CUMBERSOME TO WRITE)
-    *
-    * ===================================================== */
+   const Random_Tile *rt;
+   uint64_t state;
+   uint16_t *tiles;
+   unsigned int x, y, x0 = 0, y0 = 0, w = pud->map_w, h = pud->map_h;
 
-   if ((tile & 0xff00) == 0x0000) /* Solid */
+   if (region)
      {
-        switch (tile & 0x00f0)
-          {
-           case 0x0010:
-              GEN(6, 0x1, 0x2, 0x3, 0x5, 0x6, 0x7); break;
-           case 0x0020:
-              GEN(7, 0x0, 0x1, 0x2, 0x3, 0x5, 0x6, 0x7); break;
-           case 0x0030:
-              GEN(11, 0x0, 0x1, 0x2, 0x4, 0x5, 0x6, 0x7, 0x8, 0x9, 0xa, 0xb); break;
-           case 0x0040:
-              GEN(11, 0x0, 0x1, 0x2, 0x4, 0x5, 0x6, 0x7, 0x8, 0x9, 0xa, 0xb); break;
-           case 0x0050:
-              GEN(15, 0x0, 0x1, 0x2, 0x4, 0x5, 0x6, 0x7, 0x8, 0x9, 0xa, 0xb, 0xc, 0xd, 0xe, 0xf); break;
-           case 0x0060:
-              GEN(15, 0x0, 0x1, 0x2, 0x4, 0x5, 0x6, 0x7, 0x8, 0x9, 0xa, 0xb, 0xc, 0xd, 0xe, 0xf); break;
-           case 0x0070:
-              GEN(3, 0x0, 0x1, 0x2); break;
-           case 0x0080:
-              GEN(4, 0x0, 0x1, 0x2, 0x3); break;
-           case 0x0090:
-              GEN(1, 0x0); break;
-           case 0x00a0:
-              GEN(1, 0x0); break;
-           case 0x00b0:
-              GEN(1, 0x0); break;
-           case 0x00c0:
-              GEN(1, 0x0); break;
-           default:
-              fprintf(stderr, "*** Invalid tile 0x%04x\n", tile);
-              return 0x0000;
-          }
+        if ((region->x >= pud->map_w) || (region->y >= pud->map_h) ||
+            (region->w > pud->map_w - region->x) ||
+            (region->h > pud->map_h - region->y))
+          DIE_RETURN(PUD_FALSE, "Invalid region (x=%u,y=%u,w=%u,h=%u)",
+                     region->x, region->y, region->w, region->h);
+        x0 = region->x;
+        y0 = region->y;
+        w = region->w;
+        h = region->h;
      }
-   else /* Boundry */
+
+   /* Tiles without valid variants are left as they are */
+   state = _random_seed(seed);
+   for (y = y0; y < y0 + h; y++)
      {
-        switch (tile & 0x0ff0)
+        tiles = &(pud->tiles_map[y * pud->map_w]);
+        for (x = x0; x < x0 + w; x++)
           {
-           case 0x0100:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0110:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0120:
-              GEN(3, 0x0, 0x1, 0x2); break;
-           case 0x0130:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0140:
-              GEN(3, 0x0, 0x1, 0x2); break;
-           case 0x0150:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0160:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0170:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0180:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0190:
-              GEN(3, 0x0, 0x1, 0x2); break;
-           case 0x01a0:
-              GEN(2, 0x0, 0x1); break;
-           case 0x01b0:
-              GEN(3, 0x0, 0x1, 0x2); break;
-           case 0x01c0:
-              GEN(2, 0x0, 0x1); break;
-           case 0x01d0:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0200:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0210:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0220:
-              GEN(3, 0x0, 0x1, 0x2); break;
-           case 0x0230:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0240:
-              GEN(3, 0x0, 0x1, 0x2); break;
-           case 0x0250:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0260:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0270:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0280:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0290:
-              GEN(3, 0x0, 0x1, 0x2); break;
-           case 0x02a0:
-              GEN(2, 0x0, 0x1); break;
-           case 0x02b0:
-              GEN(3, 0x0, 0x1, 0x2); break;
-           case 0x02c0:
-              GEN(2, 0x0, 0x1); break;
-           case 0x02d0:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0300:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0310:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0320:
-              GEN(3, 0x0, 0x1, 0x2); break;
-           case 0x0330:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0340:
-              GEN(3, 0x0, 0x1, 0x2); break;
-           case 0x0350:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0360:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0370:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0380:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0390:
-              GEN(3, 0x0, 0x1, 0x2); break;
-           case 0x03a0:
-              GEN(2, 0x0, 0x1); break;
-           case 0x03b0:
-              GEN(3, 0x0, 0x1, 0x2); break;
-           case 0x03c0:
-              GEN(2, 0x0, 0x1); break;
-           case 0x03d0:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0400:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0410:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0420:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0430:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0440:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0450:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0460:
-              GEN(1, 0x0); break;
-           case 0x0470:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0480:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0490:
-              GEN(2, 0x0, 0x1); break;
-           case 0x04a0:
-              GEN(1, 0x0); break;
-           case 0x04b0:
-              GEN(2, 0x0, 0x1); break;
-           case 0x04c0:
-              GEN(1, 0x0); break;
-           case 0x04d0:
-              GEN(1, 0x0); break;
-           case 0x0500:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0510:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0520:
-              GEN(3, 0x0, 0x1, 0x2); break;
-           case 0x0530:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0540:
-              GEN(3, 0x0, 0x1, 0x2); break;
-           case 0x0550:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0560:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0570:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0580:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0590:
-              GEN(3, 0x0, 0x1, 0x2); break;
-           case 0x05a0:
-              GEN(2, 0x0, 0x1); break;
-           case 0x05b0:
-              GEN(3, 0x0, 0x1, 0x2); break;
-           case 0x05c0:
-              GEN(2, 0x0, 0x1); break;
-           case 0x05d0:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0600:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0610:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0620:
-              GEN(3, 0x0, 0x1, 0x2); break;
-           case 0x0630:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0640:
-              GEN(3, 0x0, 0x1, 0x2); break;
-           case 0x0650:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0660:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0670:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0680:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0690:
-              GEN(3, 0x0, 0x1, 0x2); break;
-           case 0x06a0:
-              GEN(2, 0x0, 0x1); break;
-           case 0x06b0:
-              GEN(3, 0x0, 0x1, 0x2); break;
-           case 0x06c0:
-              GEN(2, 0x0, 0x1); break;
-           case 0x06d0:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0700:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0710:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0720:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0730:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0740:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0750:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0760:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0770:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0780:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0790:
-              GEN(2, 0x0, 0x1); break;
-           case 0x07a0:
-              GEN(2, 0x0, 0x1); break;
-           case 0x07b0:
-              GEN(2, 0x0, 0x1); break;
-           case 0x07c0:
-              GEN(2, 0x0, 0x1); break;
-           case 0x07d0:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0800:
-              GEN(1, 0x0); break;
-           case 0x0810:
-              GEN(1, 0x0); break;
-           case 0x0820:
-              GEN(1, 0x0); break;
-           case 0x0830:
-              GEN(1, 0x0); break;
-           case 0x0840:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0850:
-              GEN(1, 0x0); break;
-           case 0x0860:
-              GEN(1, 0x0); break;
-           case 0x0870:
-              GEN(1, 0x0); break;
-           case 0x0880:
-              GEN(1, 0x0); break;
-           case 0x0890:
-              GEN(2, 0x0, 0x1); break;
-           case 0x08a0:
-              GEN(1, 0x0); break;
-           case 0x08b0:
-              GEN(1, 0x0); break;
-           case 0x08c0:
-              GEN(1, 0x0); break;
-           case 0x08d0:
-              GEN(1, 0x0); break;
-           case 0x0900:
-              GEN(1, 0x0); break;
-           case 0x0910:
-              GEN(1, 0x0); break;
-           case 0x0920:
-              GEN(1, 0x0); break;
-           case 0x0930:
-              GEN(1, 0x0); break;
-           case 0x0940:
-              GEN(2, 0x0, 0x1); break;
-           case 0x0950:
-              GEN(1, 0x0); break;
-           case 0x0960:
-              GEN(1, 0x0); break;
-           case 0x0970:
-              GEN(1, 0x0); break;
-           case 0x0980:
-              GEN(1, 0x0); break;
-           case 0x0990:
-              GEN(2, 0x0, 0x1); break;
-           case 0x09a0:
-              GEN(1, 0x0); break;
-           case 0x09b0:
-              GEN(1, 0x0); break;
-           case 0x09c0:
-              GEN(1, 0x0); break;
-           default:
-              fprintf(stderr, "*** Invalid tile 0x%04x\n", tile);
-              return 0x0000;
+             rt = _random_tile_find(tiles[x]);
+             if (!rt) continue;
+             /* Scale 32 random bits to [0,count[ without a division */
+             tiles[x] = (tiles[x] & 0xfff0) |
+                rt->variants[((_random_next(&state) >> 32) * rt->count) >> 32];
           }
      }
 
-   /*
-    * End of generated code
-    */
-
-#undef GEN
+   if ((pud->private_data->change_cbs_count) && (w) && (h))
+     {
+        const Pud_Change change = {
+           .type = PUD_CHANGE_TILE,
+           .x    = x0,
+           .y    = y0,
+           .w    = w,
+           .h    = h,
+        };
+        pud_change_emit(pud, &change);
+     }
 
-   return (count == 0) ? rands[0] : rands[rand() % count];
+   return PUD_TRUE;
 }
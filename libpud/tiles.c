@@ -23,6 +23,10 @@
 #include "pud_private.h"
 #include "pud.h"
 
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#endif
+
 static const uint8_t _forest_colors[][3] =
 {
    [0x0010] = { 0x04, 0x38, 0x75 },
@@ -1596,43 +1600,117 @@ static const uint8_t _swamp_colors[][3] =
 };
 
 
-PUDAPI Pud_Color
-pud_minimap_tile_to_color(Pud_Era  era,
-                          uint16_t tile)
+/*
+ * The sparse tables above are turned once into dense tables of packed
+ * pixels, one per era and pixel format, so the minimap is a mere gather.
+ * Tiles that the tables do not handle are flashy, to be seen (debug).
+ */
+static const unsigned int _minimap_tiles[4] = {
+   [PUD_ERA_FOREST]    = ARRAY_SIZE(_forest_colors),
+   [PUD_ERA_WINTER]    = ARRAY_SIZE(_winter_colors),
+   [PUD_ERA_WASTELAND] = ARRAY_SIZE(_wasteland_colors),
+   [PUD_ERA_SWAMP]     = ARRAY_SIZE(_swamp_colors),
+};
+
+static uint32_t _minimap_lut[2][4][PUD_MINIMAP_LUT_SIZE];
+
+#ifdef HAVE_PTHREAD
+static pthread_once_t _minimap_lut_once = PTHREAD_ONCE_INIT;
+#else
+static Pud_Bool _minimap_lut_built = PUD_FALSE;
+#endif
+
+static void
+_minimap_lut_build(void)
 {
-   switch (era)
+   const uint8_t (*const tables[4])[3] = {
+      [PUD_ERA_FOREST]    = _forest_colors,
+      [PUD_ERA_WINTER]    = _winter_colors,
+      [PUD_ERA_WASTELAND] = _wasteland_colors,
+      [PUD_ERA_SWAMP]     = _swamp_colors,
+   };
+   const Pud_Color flashy = { 0xff, 0x00, 0xff, 0xff };
+   Pud_Color c;
+   unsigned int era, tile;
+
+   for (era = 0; era < 4; era++)
+     for (tile = 0; tile < PUD_MINIMAP_LUT_SIZE; tile++)
+       {
+          if (tile < _minimap_tiles[era])
+            c = color_make(tables[era][tile][0], tables[era][tile][1],
+                           tables[era][tile][2], 0xff);
+          else
+            c = flashy;
+          _minimap_lut[PUD_PIXEL_FORMAT_RGBA][era][tile] =
+             pud_minimap_color_pack(c, PUD_PIXEL_FORMAT_RGBA);
+          _minimap_lut[PUD_PIXEL_FORMAT_ARGB][era][tile] =
+             pud_minimap_color_pack(c, PUD_PIXEL_FORMAT_ARGB);
+       }
+}
+
+PUDAPI_INTERNAL uint32_t
+pud_minimap_color_pack(Pud_Color        c,
+                       Pud_Pixel_Format pfmt)
+{
+   uint8_t bytes[4];
+   uint32_t px;
+
+   /* Pixels are packed in memory order, whatever the endianness */
+   if (pfmt == PUD_PIXEL_FORMAT_ARGB)
      {
-      case PUD_ERA_FOREST:
-         if (tile >= ARRAY_SIZE(_forest_colors)) goto error;
-         return color_make(_forest_colors[tile][0],
-                           _forest_colors[tile][1],
-                           _forest_colors[tile][2],
-                           0xff);
+        bytes[0] = c.b;
+        bytes[1] = c.g;
+        bytes[2] = c.r;
+     }
+   else
+     {
+        bytes[0] = c.r;
+        bytes[1] = c.g;
+        bytes[2] = c.b;
+     }
+   bytes[3] = c.a;
+   memcpy(&px, bytes, sizeof(px));
 
-      case PUD_ERA_WINTER:
-         if (tile >= ARRAY_SIZE(_winter_colors)) goto error;
-         return color_make(_winter_colors[tile][0],
-                           _winter_colors[tile][1],
-                           _winter_colors[tile][2],
-                           0xff);
+   return px;
+}
 
+PUDAPI_INTERNAL const uint32_t *
+pud_minimap_lut_get(Pud_Era           era,
+                    Pud_Pixel_Format  pfmt,
+                    unsigned int     *handled)
+{
+   if (((unsigned int)era >= 4) || ((unsigned int)pfmt >= 2))
+     return NULL;
+   if (handled) *handled = _minimap_tiles[era];
 
-      case PUD_ERA_WASTELAND:
-         if (tile >= ARRAY_SIZE(_wasteland_colors)) goto error;
-         return color_make(_wasteland_colors[tile][0],
-                           _wasteland_colors[tile][1],
-                           _wasteland_colors[tile][2],
-                           0xff);
+#ifdef HAVE_PTHREAD
+   pthread_once(&_minimap_lut_once, _minimap_lut_build);
+#else
+   if (!_minimap_lut_built)
+     {
+        _minimap_lut_build();
+        _minimap_lut_built = PUD_TRUE;
+     }
+#endif
 
-      case PUD_ERA_SWAMP:
-         if (tile >= ARRAY_SIZE(_swamp_colors)) goto error;
-         return color_make(_swamp_colors[tile][0],
-                           _swamp_colors[tile][1],
-                           _swamp_colors[tile][2],
-                           0xff);
+   return _minimap_lut[pfmt][era];
+}
+
+PUDAPI Pud_Color
+pud_minimap_tile_to_color(Pud_Era  era,
+                          uint16_t tile)
+{
+   unsigned int handled = 0;
+   const uint32_t *const lut =
+      pud_minimap_lut_get(era, PUD_PIXEL_FORMAT_RGBA, &handled);
+   Pud_Color c;
+
+   if ((!lut) || (tile >= handled))
+     {
+        ERR("Unhandled tile [0x%04x] for era %s", tile, pud_era_to_string(era));
+        return color_make(0xff, 0x00, 0xff, 0xff); // Flashy to be seen (debug)
      }
 
-error:
-   ERR("Unhandled tile [0x%04x] for era %s", tile, pud_era_to_string(era));
-   return color_make(0xff, 0x00, 0xff, 0xff); // Flashy to be seen (debug)
+   memcpy(&c, &(lut[tile]), sizeof(c));
+   return c;
 }
@@ -0,0 +1,367 @@
+/*
+ * Copyright (c) 2017 Jean Guyomarc'h
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "war2_private.h"
+
+/*
+ * Frames are packed with a skyline bottom-left heuristic: the top edge of
+ * the packed frames is kept as a list of horizontal segments, and each
+ * frame is placed where its top is the lowest. Frames are placed from the
+ * tallest to the smallest.
+ */
+
+typedef struct
+{
+   unsigned int x;
+   unsigned int y;
+   unsigned int w;
+} Skyline;
+
+typedef struct
+{
+   unsigned int w;
+   unsigned int h;
+   unsigned int index;
+} Order;
+
+struct _War2_Atlas
+{
+   unsigned int      width;
+   unsigned int      padding;
+
+   War2_Atlas_Rect  *rects;
+   Pud_Color       **frames;
+   unsigned int      count;
+   unsigned int      alloc;
+
+   Pud_Color        *bitmap;
+   unsigned int      bitmap_w;
+   unsigned int      bitmap_h;
+};
+
+PUDAPI War2_Atlas *
+war2_atlas_new(unsigned int width,
+               unsigned int padding)
+{
+   War2_Atlas *atlas;
+
+   atlas = calloc(1, sizeof(War2_Atlas));
+   if (!atlas) DIE_RETURN(NULL, "Failed to allocate memory");
+
+   atlas->width = width;
+   atlas->padding = padding;
+
+   return atlas;
+}
+
+PUDAPI void
+war2_atlas_free(War2_Atlas *atlas)
+{
+   unsigned int i;
+
+   if (!atlas) return;
+
+   for (i = 0; i < atlas->count; ++i)
+     free(atlas->frames[i]);
+   free(atlas->frames);
+   free(atlas->rects);
+   free(atlas->bitmap);
+   free(atlas);
+}
+
+PUDAPI Pud_Bool
+war2_atlas_add_frame(War2_Atlas      *atlas,
+                     unsigned int     id,
+                     const Pud_Color *bitmap,
+                     unsigned int     w,
+                     unsigned int     h,
+                     int              x,
+                     int              y)
+{
+   War2_Atlas_Rect *rect;
+   Pud_Color *frame;
+   void *tmp;
+   unsigned int alloc;
+   const size_t size = (size_t)w * (size_t)h * sizeof(Pud_Color);
+
+   if ((!atlas) || ((!bitmap) && (size > 0)))
+     DIE_RETURN(PUD_FALSE, "Invalid arguments");
+
+   if (atlas->count == atlas->alloc)
+     {
+        alloc = (atlas->alloc) ? atlas->alloc * 2 : 64;
+        tmp = realloc(atlas->rects, alloc * sizeof(War2_Atlas_Rect));
+        if (!tmp) DIE_RETURN(PUD_FALSE, "Failed to allocate memory");
+        atlas->rects = tmp;
+        tmp = realloc(atlas->frames, alloc * sizeof(Pud_Color *));
+        if (!tmp) DIE_RETURN(PUD_FALSE, "Failed to allocate memory");
+        atlas->frames = tmp;
+        atlas->alloc = alloc;
+     }
+
+   /* Decoding callbacks only lend their bitmap */
+   frame = malloc(size + 1);
+   if (!frame) DIE_RETURN(PUD_FALSE, "Failed to allocate memory");
+   memcpy(frame, bitmap, size);
+   atlas->frames[atlas->count] = frame;
+
+   rect = &(atlas->rects[atlas->count]);
+   rect->id = id;
+   rect->x = 0;
+   rect->y = 0;
+   rect->w = w;
+   rect->h = h;
+   rect->origin_x = x;
+   rect->origin_y = y;
+
+   atlas->count++;
+
+   return PUD_TRUE;
+}
+
+static int
+_order_cmp(const void *a,
+           const void *b)
+{
+   const Order *const oa = a;
+   const Order *const ob = b;
+
+   /* Tallest first, then widest first. Insertion order breaks ties
+    * so packing is deterministic */
+   if (oa->h != ob->h) return (oa->h > ob->h) ? -1 : 1;
+   if (oa->w != ob->w) return (oa->w > ob->w) ? -1 : 1;
+   return (oa->index < ob->index) ? -1 : 1;
+}
+
+static Pud_Bool
+_skyline_fit(const Skyline *sky,
+             unsigned int   sky_count,
+             unsigned int   index,
+             unsigned int   w,
+             unsigned int   width,
+             unsigned int  *y_ret)
+{
+   const unsigned int x = sky[index].x;
+   unsigned int y = 0, i, left = w;
+
+   if (x + w > width) return PUD_FALSE;
+
+   /* The frame lies on the highest segment it covers */
+   for (i = index; left > 0; ++i)
+     {
+        if (i >= sky_count) return PUD_FALSE;
+        if (sky[i].y > y) y = sky[i].y;
+        left = (sky[i].w >= left) ? 0 : left - sky[i].w;
+     }
+   *y_ret = y;
+
+   return PUD_TRUE;
+}
+
+static void
+_skyline_add(Skyline      *sky,
+             unsigned int *sky_count,
+             unsigned int  index,
+             unsigned int  x,
+             unsigned int  y,
+             unsigned int  w)
+{
+   unsigned int i, shrink;
+
+   memmove(&(sky[index + 1]), &(sky[index]),
+           (*sky_count - index) * sizeof(Skyline));
+   sky[index].x = x;
+   sky[index].y = y;
+   sky[index].w = w;
+   (*sky_count)++;
+
+   /* Remove or shrink the segments below the new one */
+   for (i = index + 1; i < *sky_count; )
+     {
+        if (sky[i].x >= x + w) break;
+        shrink = x + w - sky[i].x;
+        if (sky[i].w <= shrink)
+          {
+             memmove(&(sky[i]), &(sky[i + 1]),
+                     (*sky_count - i - 1) * sizeof(Skyline));
+             (*sky_count)--;
+          }
+        else
+          {
+             sky[i].x += shrink;
+             sky[i].w -= shrink;
+             break;
+          }
+     }
+
+   /* Merge neighbours at the same height */
+   for (i = 0; i + 1 < *sky_count; )
+     {
+        if (sky[i].y == sky[i + 1].y)
+          {
+             sky[i].w += sky[i + 1].w;
+             memmove(&(sky[i + 1]), &(sky[i + 2]),
+                     (*sky_count - i - 2) * sizeof(Skyline));
+             (*sky_count)--;
+          }
+        else
+          i++;
+     }
+}
+
+PUDAPI Pud_Bool
+war2_atlas_pack(War2_Atlas *atlas)
+{
+   Order *order = NULL;
+   Skyline *sky = NULL;
+   unsigned int sky_count, i, k, best, best_y, best_w, y, w, h, width, height = 0;
+   unsigned long long area = 0;
+   War2_Atlas_Rect *r;
+   const Pud_Color *src;
+   Pud_Color *dst;
+
+   if (!atlas) DIE_RETURN(PUD_FALSE, "Invalid atlas");
+
+   free(atlas->bitmap);
+   atlas->bitmap = NULL;
+   atlas->bitmap_w = 0;
+   atlas->bitmap_h = 0;
+   if (atlas->count == 0) return PUD_TRUE;
+
+   /* Without a fixed width, aim at a squarish atlas */
+   width = atlas->width;
+   for (i = 0; i < atlas->count; ++i)
+     {
+        w = atlas->rects[i].w + atlas->padding;
+        h = atlas->rects[i].h + atlas->padding;
+        area += (unsigned long long)w * h;
+        if ((atlas->width == 0) && (w > width)) width = w;
+        if (w > width)
+          DIE_RETURN(PUD_FALSE, "Frame %u (%ux%u with padding) is wider "
+                     "than the atlas (%u)", atlas->rects[i].id, w, h, width);
+     }
+   if (atlas->width == 0)
+     {
+        for (k = 1; (unsigned long long)k * k < area + area / 8; ++k);
+        if (k > width) width = k;
+     }
+
+   order = malloc(atlas->count * sizeof(Order));
+   sky = malloc((atlas->count + 1) * sizeof(Skyline));
+   if ((!order) || (!sky))
+     {
+        free(order);
+        free(sky);
+        DIE_RETURN(PUD_FALSE, "Failed to allocate memory");
+     }
+
+   for (i = 0; i < atlas->count; ++i)
+     {
+        order[i].w = atlas->rects[i].w;
+        order[i].h = atlas->rects[i].h;
+        order[i].index = i;
+     }
+   qsort(order, atlas->count, sizeof(Order), _order_cmp);
+
+   sky[0].x = 0;
+   sky[0].y = 0;
+   sky[0].w = width;
+   sky_count = 1;
+
+   for (k = 0; k < atlas->count; ++k)
+     {
+        r = &(atlas->rects[order[k].index]);
+        w = r->w + atlas->padding;
+        h = r->h + atlas->padding;
+
+        /* Lowest top edge wins. Narrowest segment breaks ties */
+        best = sky_count;
+        best_y = best_w = UINT32_MAX;
+        for (i = 0; i < sky_count; ++i)
+          {
+             if (!_skyline_fit(sky, sky_count, i, w, width, &y)) continue;
+             if ((y + h < best_y) || ((y + h == best_y) && (sky[i].w < best_w)))
+               {
+                  best = i;
+                  best_y = y + h;
+                  best_w = sky[i].w;
+               }
+          }
+        /* Cannot happen: every frame fits in the width on top of the rest */
+        if (best == sky_count)
+          {
+             free(order);
+             free(sky);
+             DIE_RETURN(PUD_FALSE, "Failed to place frame %u", r->id);
+          }
+
+        r->x = sky[best].x;
+        r->y = best_y - h;
+        _skyline_add(sky, &sky_count, best, r->x, best_y, w);
+        if (best_y > height) height = best_y;
+     }
+
+   free(order);
+   free(sky);
+
+   /* All frames are known: blit them in a single buffer */
+   atlas->bitmap = calloc((size_t)width * height, sizeof(Pud_Color));
+   if (!atlas->bitmap) DIE_RETURN(PUD_FALSE, "Failed to allocate memory");
+   atlas->bitmap_w = width;
+   atlas->bitmap_h = height;
+
+   for (k = 0; k < atlas->count; ++k)
+     {
+        r = &(atlas->rects[k]);
+        src = atlas->frames[k];
+        dst = &(atlas->bitmap[(size_t)r->y * width + r->x]);
+        for (i = 0; i < r->h; ++i)
+          memcpy(&(dst[(size_t)i * width]), &(src[(size_t)i * r->w]),
+                 r->w * sizeof(Pud_Color));
+     }
+
+   return PUD_TRUE;
+}
+
+PUDAPI const Pud_Color *
+war2_atlas_bitmap_get(const War2_Atlas *atlas,
+                      unsigned int     *w,
+                      unsigned int     *h)
+{
+   if (!atlas) return NULL;
+   if (w) *w = atlas->bitmap_w;
+   if (h) *h = atlas->bitmap_h;
+   return atlas->bitmap;
+}
+
+PUDAPI const War2_Atlas_Rect *
+war2_atlas_rects_get(const War2_Atlas *atlas,
+                     unsigned int     *count)
+{
+   if (!atlas)
+     {
+        if (count) *count = 0;
+        return NULL;
+     }
+   if (count) *count = atlas->count;
+   return atlas->rects;
+}
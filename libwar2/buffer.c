@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2017 Jean Guyomarc'h
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "war2_private.h"
+
+/*
+ * Encoders append to a buffer by reserving room at its end, filling it,
+ * then committing what they wrote by increasing its size. The buffer
+ * grows geometrically, so appending many small chunks stays linear.
+ */
+
+PUDAPI_INTERNAL unsigned char *
+war2_buffer_reserve(War2_Buffer *buf,
+                    size_t       size)
+{
+   unsigned char *data;
+   size_t alloc;
+
+   if (size > buf->alloc - buf->size)
+     {
+        if (size > (size_t)-1 - buf->size)
+          DIE_RETURN(NULL, "Buffer too large");
+
+        alloc = (buf->alloc) ? buf->alloc : 256;
+        while (alloc - buf->size < size)
+          {
+             if (alloc > (size_t)-1 / 2)
+               {
+                  alloc = buf->size + size;
+                  break;
+               }
+             alloc *= 2;
+          }
+
+        data = realloc(buf->data, alloc);
+        if (!data) DIE_RETURN(NULL, "Failed to allocate memory");
+        buf->data = data;
+        buf->alloc = alloc;
+     }
+
+   return &(buf->data[buf->size]);
+}
+
+PUDAPI_INTERNAL Pud_Bool
+war2_buffer_append(War2_Buffer *buf,
+                   const void  *data,
+                   size_t       size)
+{
+   unsigned char *dst;
+
+   dst = war2_buffer_reserve(buf, size);
+   if (!dst) return PUD_FALSE;
+   memcpy(dst, data, size);
+   buf->size += size;
+
+   return PUD_TRUE;
+}
+
+PUDAPI void
+war2_buffer_free(War2_Buffer *buf)
+{
+   if (!buf) return;
+   free(buf->data);
+   buf->data = NULL;
+   buf->size = 0;
+   buf->alloc = 0;
+}
@@ -23,19 +23,16 @@
 #include "war2_private.h"
 
 
-PUDAPI Pud_Color *
-war2_cursors_decode(War2_Data *w2,
-                    unsigned int entry,
-                    int *x, int *y,
-                    unsigned int *w,
-                    unsigned int *h)
+PUDAPI unsigned char *
+war2_cursors_decode_indexed(War2_Data *w2,
+                            unsigned int entry,
+                            int *x, int *y,
+                            unsigned int *w,
+                            unsigned int *h)
 {
    unsigned char *mem;
    size_t size, img_size;
    uint16_t hotx, hoty, width, height;
-   Pud_Color *img_rgba;
-   unsigned int k;
-   const Pud_Color *const palette = war2_palette_get(w2, PUD_ERA_FOREST);
 
    mem = war2_entry_extract(w2, entry, &size);
    if (! mem) DIE_RETURN(NULL, "Failed to extract entry");
@@ -48,7 +45,40 @@ war2_cursors_decode(War2_Data *w2,
    memcpy(&hoty, &(mem[2]), sizeof(uint16_t));
    memcpy(&width, &(mem[4]), sizeof(uint16_t));
    memcpy(&height, &(mem[6]), sizeof(uint16_t));
-   mem += 8;
+
+   img_size = width * height;
+   if (size < img_size + 8)
+     {
+        free(mem);
+        DIE_RETURN(NULL, "Entry is too small (%zu bytes)", size);
+     }
+
+   /* The indexes are moved in place, so the entry itself is returned */
+   memmove(mem, mem + 8, img_size);
+
+   if (x) *x = hotx;
+   if (y) *y = hoty;
+   if (w) *w = width;
+   if (h) *h = height;
+   return mem;
+}
+
+PUDAPI Pud_Color *
+war2_cursors_decode(War2_Data *w2,
+                    unsigned int entry,
+                    int *x, int *y,
+                    unsigned int *w,
+                    unsigned int *h)
+{
+   unsigned char *mem;
+   unsigned int width, height;
+   size_t img_size;
+   Pud_Color *img_rgba;
+   unsigned int k;
+   const Pud_Color *const palette = war2_palette_get(w2, PUD_ERA_FOREST);
+
+   mem = war2_cursors_decode_indexed(w2, entry, x, y, &width, &height);
+   if (! mem) return NULL;
 
    img_size = width * height;
    img_rgba = malloc(img_size * sizeof(Pud_Color));
@@ -56,13 +86,8 @@ war2_cursors_decode(War2_Data *w2,
 
    for (k = 0; k < img_size; k++)
      img_rgba[k] = palette[mem[k]];
-
-   /* Free. Don't forget to go back of 8 bytes */
-   mem -= 8;
    free(mem);
 
-   if (x) *x = hotx;
-   if (y) *y = hoty;
    if (w) *w = width;
    if (h) *h = height;
    return img_rgba;
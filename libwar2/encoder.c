@@ -0,0 +1,223 @@
+/*
+ * Copyright (c) 2017 Jean Guyomarc'h
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "war2_private.h"
+
+/*
+ * An encoder dispatches to the codec of its format. The codecs of PNG and
+ * JPEG live in png.c and jpeg.c, and keep their state in enc->codec.
+ * Only PNG can store indexed images as they are: the other formats are
+ * given the RGBA expansion of the indexes.
+ */
+
+static Pud_Color *
+_encoder_expand(unsigned int         w,
+                unsigned int         h,
+                const unsigned char *indexes,
+                const Pud_Color     *palette,
+                int                  transparent)
+{
+   const size_t size = (size_t)w * h;
+   Pud_Color *img;
+   size_t k;
+
+   img = malloc(size * sizeof(Pud_Color));
+   if (!img) DIE_RETURN(NULL, "Failed to allocate memory");
+
+   for (k = 0; k < size; k++)
+     {
+        img[k] = palette[indexes[k]];
+        img[k].a = (indexes[k] == transparent) ? 0x00 : 0xff;
+     }
+
+   return img;
+}
+
+PUDAPI War2_Encoder *
+war2_encoder_new(War2_Encoder_Format          format,
+                 const War2_Encoder_Options *opts)
+{
+   War2_Encoder *enc;
+   Pud_Bool chk;
+
+   enc = calloc(1, sizeof(War2_Encoder));
+   if (!enc) DIE_RETURN(NULL, "Failed to allocate memory");
+   enc->format = format;
+   if (opts) enc->opts = *opts;
+
+   switch (format)
+     {
+      case WAR2_ENCODER_FORMAT_PNG:  chk = war2_png_encoder_init(enc);  break;
+      case WAR2_ENCODER_FORMAT_JPEG: chk = war2_jpeg_encoder_init(enc); break;
+      case WAR2_ENCODER_FORMAT_PPM:  chk = PUD_TRUE;                    break;
+      default:
+         ERR("Invalid encoder format %i", format);
+         chk = PUD_FALSE;
+         break;
+     }
+   if (!chk)
+     {
+        free(enc);
+        return NULL;
+     }
+
+   return enc;
+}
+
+PUDAPI void
+war2_encoder_free(War2_Encoder *enc)
+{
+   if (!enc) return;
+
+   switch (enc->format)
+     {
+      case WAR2_ENCODER_FORMAT_PNG:  war2_png_encoder_clear(enc);  break;
+      case WAR2_ENCODER_FORMAT_JPEG: war2_jpeg_encoder_clear(enc); break;
+      default: break;
+     }
+   free(enc);
+}
+
+PUDAPI Pud_Bool
+war2_encoder_encode(War2_Encoder        *enc,
+                    War2_Buffer         *buf,
+                    unsigned int         w,
+                    unsigned int         h,
+                    const unsigned char *data)
+{
+   size_t size;
+   Pud_Bool chk;
+
+   if ((!enc) || (!buf) || (!data)) DIE_RETURN(PUD_FALSE, "Invalid arguments");
+
+   size = buf->size;
+   switch (enc->format)
+     {
+      case WAR2_ENCODER_FORMAT_PNG:
+         chk = war2_png_encoder_encode(enc, NULL, buf, w, h, data, NULL, -1);
+         break;
+      case WAR2_ENCODER_FORMAT_JPEG:
+         chk = war2_jpeg_encoder_encode(enc, NULL, buf, w, h, data);
+         break;
+      default:
+         chk = war2_ppm_encode(buf, w, h, data, enc->opts.ppm_format);
+         break;
+     }
+
+   /* On failure, drop what was partially appended */
+   if (!chk) buf->size = size;
+   return chk;
+}
+
+PUDAPI Pud_Bool
+war2_encoder_write(War2_Encoder        *enc,
+                   const char          *file,
+                   unsigned int         w,
+                   unsigned int         h,
+                   const unsigned char *data)
+{
+   FILE *f;
+   Pud_Bool chk;
+
+   if ((!enc) || (!file) || (!data)) DIE_RETURN(PUD_FALSE, "Invalid arguments");
+
+   if (enc->format == WAR2_ENCODER_FORMAT_PPM)
+     return war2_ppm_format_write(file, w, h, data, enc->opts.ppm_format);
+
+   f = fopen(file, "wb");
+   if (!f) DIE_RETURN(PUD_FALSE, "Failed to open [%s]", file);
+
+   if (enc->format == WAR2_ENCODER_FORMAT_PNG)
+     chk = war2_png_encoder_encode(enc, f, NULL, w, h, data, NULL, -1);
+   else
+     chk = war2_jpeg_encoder_encode(enc, f, NULL, w, h, data);
+   if (fclose(f) != 0) chk = PUD_FALSE;
+
+   return chk;
+}
+
+PUDAPI Pud_Bool
+war2_encoder_encode_indexed(War2_Encoder        *enc,
+                            War2_Buffer         *buf,
+                            unsigned int         w,
+                            unsigned int         h,
+                            const unsigned char *indexes,
+                            const Pud_Color     *palette,
+                            int                  transparent_index)
+{
+   Pud_Color *img;
+   size_t size;
+   Pud_Bool chk;
+
+   if ((!enc) || (!buf) || (!indexes) || (!palette))
+     DIE_RETURN(PUD_FALSE, "Invalid arguments");
+
+   if (enc->format == WAR2_ENCODER_FORMAT_PNG)
+     {
+        size = buf->size;
+        chk = war2_png_encoder_encode(enc, NULL, buf, w, h, indexes,
+                                      palette, transparent_index);
+        if (!chk) buf->size = size;
+        return chk;
+     }
+
+   img = _encoder_expand(w, h, indexes, palette, transparent_index);
+   if (!img) return PUD_FALSE;
+   chk = war2_encoder_encode(enc, buf, w, h, (const unsigned char *)img);
+   free(img);
+
+   return chk;
+}
+
+PUDAPI Pud_Bool
+war2_encoder_write_indexed(War2_Encoder        *enc,
+                           const char          *file,
+                           unsigned int         w,
+                           unsigned int         h,
+                           const unsigned char *indexes,
+                           const Pud_Color     *palette,
+                           int                  transparent_index)
+{
+   FILE *f;
+   Pud_Color *img;
+   Pud_Bool chk;
+
+   if ((!enc) || (!file) || (!indexes) || (!palette))
+     DIE_RETURN(PUD_FALSE, "Invalid arguments");
+
+   if (enc->format == WAR2_ENCODER_FORMAT_PNG)
+     {
+        f = fopen(file, "wb");
+        if (!f) DIE_RETURN(PUD_FALSE, "Failed to open [%s]", file);
+        chk = war2_png_encoder_encode(enc, f, NULL, w, h, indexes,
+                                      palette, transparent_index);
+        if (fclose(f) != 0) chk = PUD_FALSE;
+        return chk;
+     }
+
+   img = _encoder_expand(w, h, indexes, palette, transparent_index);
+   if (!img) return PUD_FALSE;
+   chk = war2_encoder_write(enc, file, w, h, (const unsigned char *)img);
+   free(img);
+
+   return chk;
+}
@@ -24,77 +24,289 @@
 #include "war2_private.h"
 
 #if HAVE_JPEG
+# include <setjmp.h>
 # include <jpeglib.h>
+# include <jerror.h>
 #endif
 
-PUDAPI Pud_Bool
-war2_jpeg_write(const char          *file,
-                unsigned int         w,
-                unsigned int         h,
-                const unsigned char *data)
-{
 #if HAVE_JPEG
-   struct jpeg_compress_struct cinfo;
-   struct jpeg_error_mgr jerr;
-   JSAMPROW row_pointer[1];
-   int row_stride;
-   FILE *f;
-   unsigned char *data_rgb;
-   int i, k, size;
-   const JSAMPLE *p;
-
-   data_rgb = malloc(sizeof(unsigned char) * 3 * w * h);
-   if (!data_rgb) DIE_RETURN(PUD_FALSE, "Failed to allocate rgb buffer");
-
-   /* data is RGBA. JPEG does not like alpha */
-   size = w * h * 4;
-   for (i = 0, k = 0; i < size; i += 4, k += 3)
+/* Chunk reserved at the end of the buffer each time libjpeg fills it */
+#define JPEG_CHUNK 16384
+
+typedef struct
+{
+   struct jpeg_error_mgr  mgr;
+   jmp_buf                jmp;
+} Jpeg_Error;
+
+typedef struct
+{
+   struct jpeg_destination_mgr  mgr;
+   War2_Buffer                 *buf;
+   FILE                        *f; /* If set, buf is flushed in f */
+} Jpeg_Dest;
+
+/*
+ * The compression object is created once per encoder, and only the size
+ * of the images changes from one image to the next. Images are always
+ * encoded in a buffer: when writing a file, the chunks are flushed to the
+ * file as soon as libjpeg has filled them.
+ */
+typedef struct
+{
+   struct jpeg_compress_struct  cinfo;
+   Jpeg_Error                   jerr;
+   Jpeg_Dest                    dest;
+   War2_Buffer                  scratch;
+#ifndef JCS_EXTENSIONS
+   JSAMPLE                     *row;
+   unsigned int                 row_alloc;
+#endif
+} Jpeg_Codec;
+
+static void
+_jpeg_error_exit_cb(j_common_ptr cinfo)
+{
+   Jpeg_Error *const err = (Jpeg_Error *)cinfo->err;
+
+   /* Do not let libjpeg exit() the program */
+   (*cinfo->err->output_message)(cinfo);
+   longjmp(err->jmp, 1);
+}
+
+static void
+_jpeg_dest_fail(j_compress_ptr cinfo,
+                int            code)
+{
+   cinfo->err->msg_code = code;
+   (*cinfo->err->error_exit)((j_common_ptr)cinfo);
+}
+
+static void
+_jpeg_dest_commit(j_compress_ptr cinfo,
+                  size_t         size)
+{
+   Jpeg_Dest *const dest = (Jpeg_Dest *)cinfo->dest;
+
+   dest->buf->size += size;
+   if (dest->f)
      {
-        data_rgb[k + 0] = data[i + 0];
-        data_rgb[k + 1] = data[i + 1];
-        data_rgb[k + 2] = data[i + 2];
+        if (fwrite(dest->buf->data, 1, dest->buf->size, dest->f) != dest->buf->size)
+          _jpeg_dest_fail(cinfo, JERR_FILE_WRITE);
+        dest->buf->size = 0;
      }
-   p = data_rgb;
+}
+
+static void
+_jpeg_dest_reserve(j_compress_ptr cinfo)
+{
+   Jpeg_Dest *const dest = (Jpeg_Dest *)cinfo->dest;
+
+   dest->mgr.next_output_byte = war2_buffer_reserve(dest->buf, JPEG_CHUNK);
+   if (!dest->mgr.next_output_byte)
+     _jpeg_dest_fail(cinfo, JERR_OUT_OF_MEMORY);
+   dest->mgr.free_in_buffer = JPEG_CHUNK;
+}
+
+static void
+_jpeg_dest_init_cb(j_compress_ptr cinfo)
+{
+   _jpeg_dest_reserve(cinfo);
+}
+
+static boolean
+_jpeg_dest_empty_cb(j_compress_ptr cinfo)
+{
+   /* The whole chunk has been filled */
+   _jpeg_dest_commit(cinfo, JPEG_CHUNK);
+   _jpeg_dest_reserve(cinfo);
+   return TRUE;
+}
+
+static void
+_jpeg_dest_term_cb(j_compress_ptr cinfo)
+{
+   Jpeg_Dest *const dest = (Jpeg_Dest *)cinfo->dest;
+
+   _jpeg_dest_commit(cinfo, JPEG_CHUNK - dest->mgr.free_in_buffer);
+}
+#endif
+
+PUDAPI_INTERNAL Pud_Bool
+war2_jpeg_encoder_init(War2_Encoder *enc)
+{
+#if HAVE_JPEG
+   static const J_DCT_METHOD dcts[] = {
+      [WAR2_JPEG_DCT_ISLOW] = JDCT_ISLOW,
+      [WAR2_JPEG_DCT_IFAST] = JDCT_IFAST,
+      [WAR2_JPEG_DCT_FLOAT] = JDCT_FLOAT,
+   };
+   const War2_Encoder_Options *const opts = &(enc->opts);
+   Jpeg_Codec *codec;
+
+   codec = calloc(1, sizeof(Jpeg_Codec));
+   if (!codec) DIE_RETURN(PUD_FALSE, "Failed to allocate memory");
 
-   f = fopen(file, "wb");
-   if (!f)
+   codec->cinfo.err = jpeg_std_error(&(codec->jerr.mgr));
+   codec->jerr.mgr.error_exit = _jpeg_error_exit_cb;
+   if (setjmp(codec->jerr.jmp))
      {
-        free(data_rgb);
-        DIE_RETURN(PUD_FALSE, "Failed to open file [%s]", file);
+        jpeg_destroy_compress(&(codec->cinfo));
+        free(codec);
+        DIE_RETURN(PUD_FALSE, "Failed to create jpeg encoder");
      }
+   jpeg_create_compress(&(codec->cinfo));
 
-   cinfo.err = jpeg_std_error(&jerr);
-   jpeg_create_compress(&cinfo);
-   jpeg_stdio_dest(&cinfo, f);
+   codec->dest.mgr.init_destination = _jpeg_dest_init_cb;
+   codec->dest.mgr.empty_output_buffer = _jpeg_dest_empty_cb;
+   codec->dest.mgr.term_destination = _jpeg_dest_term_cb;
+   codec->cinfo.dest = &(codec->dest.mgr);
+
+   /* libjpeg-turbo skips the alpha channel by itself */
+#ifdef JCS_EXTENSIONS
+   codec->cinfo.input_components = 4;
+   codec->cinfo.in_color_space = JCS_EXT_RGBX;
+#else
+   codec->cinfo.input_components = 3;
+   codec->cinfo.in_color_space = JCS_RGB;
+#endif
+   jpeg_set_defaults(&(codec->cinfo));
+   jpeg_set_quality(&(codec->cinfo),
+                    ((opts->jpeg_quality >= 1) && (opts->jpeg_quality <= 100))
+                    ? (int)opts->jpeg_quality : 100, TRUE);
+   if ((unsigned int)opts->jpeg_dct < sizeof(dcts) / sizeof(dcts[0]))
+     codec->cinfo.dct_method = dcts[opts->jpeg_dct];
+
+   enc->codec = codec;
+   return PUD_TRUE;
+#else
+   (void) enc;
+   DIE_RETURN(PUD_FALSE, "libwar2 was compiled without JPEG support");
+#endif
+}
 
-   cinfo.image_width = w;
-   cinfo.image_height = h;
-   cinfo.input_components = 3;
-   cinfo.in_color_space = JCS_RGB;
+PUDAPI_INTERNAL void
+war2_jpeg_encoder_clear(War2_Encoder *enc)
+{
+#if HAVE_JPEG
+   Jpeg_Codec *const codec = enc->codec;
 
-   row_stride = w * 3;
+   if (!codec) return;
+   jpeg_destroy_compress(&(codec->cinfo));
+   war2_buffer_free(&(codec->scratch));
+# ifndef JCS_EXTENSIONS
+   free(codec->row);
+# endif
+   free(codec);
+   enc->codec = NULL;
+#else
+   (void) enc;
+#endif
+}
 
-   jpeg_set_defaults(&cinfo);
-   jpeg_set_quality(&cinfo, 100, TRUE);
-   jpeg_start_compress(&cinfo, TRUE);
+PUDAPI_INTERNAL Pud_Bool
+war2_jpeg_encoder_encode(War2_Encoder        *enc,
+                         FILE                *f,
+                         War2_Buffer         *buf,
+                         unsigned int         w,
+                         unsigned int         h,
+                         const unsigned char *data)
+{
+#if HAVE_JPEG
+   Jpeg_Codec *const codec = enc->codec;
+   struct jpeg_compress_struct *const cinfo = &(codec->cinfo);
+   JSAMPROW row_pointer[1];
+# ifndef JCS_EXTENSIONS
+   const unsigned char *s;
+   JSAMPLE *row;
+   unsigned int i;
 
-   while (cinfo.next_scanline < cinfo.image_height)
+   /* data is RGBA. JPEG does not like alpha: convert it row by row */
+   if (w > codec->row_alloc)
      {
-        row_pointer[0] = (JSAMPROW)(&p[cinfo.next_scanline * row_stride]);
-        jpeg_write_scanlines(&cinfo, row_pointer, 1);
+        row = realloc(codec->row, (size_t)w * 3);
+        if (!row) DIE_RETURN(PUD_FALSE, "Failed to allocate memory");
+        codec->row = row;
+        codec->row_alloc = w;
      }
+# endif
+
+   codec->scratch.size = 0;
+   codec->dest.buf = (buf) ? buf : &(codec->scratch);
+   codec->dest.f = f;
 
-   jpeg_finish_compress(&cinfo);
-   fclose(f);
-   jpeg_destroy_compress(&cinfo);
-   free(data_rgb);
+   if (setjmp(codec->jerr.jmp))
+     {
+        /* The compression object can be used again */
+        jpeg_abort_compress(cinfo);
+        DIE_RETURN(PUD_FALSE, "Failed to encode jpeg");
+     }
+
+   cinfo->image_width = w;
+   cinfo->image_height = h;
+   jpeg_start_compress(cinfo, TRUE);
+
+   while (cinfo->next_scanline < cinfo->image_height)
+     {
+# ifdef JCS_EXTENSIONS
+        row_pointer[0] = (JSAMPROW)(&data[(size_t)cinfo->next_scanline * w * 4]);
+# else
+        s = &data[(size_t)cinfo->next_scanline * w * 4];
+        for (i = 0; i < w; i++, s += 4)
+          {
+             codec->row[i * 3 + 0] = s[0];
+             codec->row[i * 3 + 1] = s[1];
+             codec->row[i * 3 + 2] = s[2];
+          }
+        row_pointer[0] = codec->row;
+# endif
+        jpeg_write_scanlines(cinfo, row_pointer, 1);
+     }
+
+   jpeg_finish_compress(cinfo);
 
    return PUD_TRUE;
 #else
-   (void) file;
+   (void) enc;
+   (void) f;
+   (void) buf;
    (void) w;
    (void) h;
    (void) data;
    return PUD_FALSE;
 #endif
 }
+
+PUDAPI Pud_Bool
+war2_jpeg_write(const char          *file,
+                unsigned int         w,
+                unsigned int         h,
+                const unsigned char *data)
+{
+   War2_Encoder *enc;
+   Pud_Bool chk;
+
+   enc = war2_encoder_new(WAR2_ENCODER_FORMAT_JPEG, NULL);
+   if (!enc) return PUD_FALSE;
+   chk = war2_encoder_write(enc, file, w, h, data);
+   war2_encoder_free(enc);
+
+   return chk;
+}
+
+PUDAPI Pud_Bool
+war2_jpeg_encode(War2_Buffer         *buf,
+                 unsigned int         w,
+                 unsigned int         h,
+                 const unsigned char *data)
+{
+   War2_Encoder *enc;
+   Pud_Bool chk;
+
+   enc = war2_encoder_new(WAR2_ENCODER_FORMAT_JPEG, NULL);
+   if (!enc) return PUD_FALSE;
+   chk = war2_encoder_encode(enc, buf, w, h, data);
+   war2_encoder_free(enc);
+
+   return chk;
+}
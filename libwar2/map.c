@@ -0,0 +1,430 @@
+/*
+ * Copyright (c) 2017 Jean Guyomarc'h
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "war2_private.h"
+
+/*
+ * The map is rendered by horizontal strips of tiles. A batch of strips
+ * (one per worker) is rendered in parallel, then delivered in order from
+ * the calling thread, so only one batch is held in memory at once.
+ */
+
+#define STRIP_ROWS_DEFAULT 4
+
+typedef struct
+{
+   const Pud           *pud;
+   War2_Tileset        *ts;
+   unsigned int         w;
+   unsigned int         h;
+   unsigned int         strip_h;
+
+   War2_Unit_Sprites    sprites;
+   /* Units in drawing order: flying units are drawn last */
+   const Pud_Unit_Info **units;
+   unsigned int         units_count;
+
+   /* Strips of the current batch */
+   unsigned int         first;
+   Pud_Color           *strips;
+} Map;
+
+static Pud_Bool
+_map_units_sort(Map *map)
+{
+   const Pud *const pud = map->pud;
+   unsigned int i, pass;
+   Pud_Bool flying;
+
+   map->units = malloc(pud->units_count * sizeof(*map->units) + 1);
+   if (!map->units) DIE_RETURN(PUD_FALSE, "Failed to allocate memory");
+
+   for (pass = 0; pass < 2; ++pass)
+     {
+        for (i = 0; i < pud->units_count; ++i)
+          {
+             const Pud_Unit_Info *const u = &(pud->units[i]);
+
+             if (!war2_unit_sprite_get(NULL, &(map->sprites), u->type, u->player))
+               continue;
+             flying = pud_unit_flying_is(u->type);
+             if ((pass == 0) != (!flying)) continue;
+             map->units[map->units_count++] = u;
+          }
+     }
+
+   return PUD_TRUE;
+}
+
+static void
+_map_area_render(Map          *map,
+                 Pud_Color    *buf,
+                 unsigned int  x0,
+                 unsigned int  y0,
+                 unsigned int  w,
+                 unsigned int  h)
+{
+   const Pud *const pud = map->pud;
+   const War2_Unit_Sprite *sp;
+   const Pud_Unit_Info *u;
+   unsigned int tx, ty, tx_end, ty_end, i;
+   int x, y;
+
+   memset(buf, 0, (size_t)w * h * sizeof(Pud_Color));
+
+   tx_end = (x0 + w + 31) / 32;
+   ty_end = (y0 + h + 31) / 32;
+   if (tx_end > pud->map_w) tx_end = pud->map_w;
+   if (ty_end > pud->map_h) ty_end = pud->map_h;
+   for (ty = y0 / 32; ty < ty_end; ++ty)
+     for (tx = x0 / 32; tx < tx_end; ++tx)
+       war2_tileset_tile_render(map->ts, pud->tiles_map[ty * pud->map_w + tx],
+                                buf, w, h, (int)(tx * 32 - x0),
+                                (int)(ty * 32 - y0));
+
+   /* Sprites may overlap several areas: each area blits its part */
+   for (i = 0; i < map->units_count; ++i)
+     {
+        u = map->units[i];
+        sp = war2_unit_sprite_get(NULL, &(map->sprites), u->type, u->player);
+        x = (int)(u->x * 32) + sp->x - (int)x0;
+        y = (int)(u->y * 32) + sp->y - (int)y0;
+        if ((x >= (int)w) || (x + (int)sp->w <= 0) ||
+            (y >= (int)h) || (y + (int)sp->h <= 0))
+          continue;
+        war2_sprites_blit(buf, w, h, x, y, sp->pixels, sp->w, sp->h, PUD_FALSE);
+     }
+}
+
+static void
+_map_strip_job(void         *data,
+               unsigned int  job)
+{
+   Map *const map = data;
+   const unsigned int y0 = (map->first + job) * map->strip_h;
+   const unsigned int h = (y0 + map->strip_h > map->h) ? map->h - y0 : map->strip_h;
+
+   _map_area_render(map, &(map->strips[(size_t)job * map->w * map->strip_h]),
+                    0, y0, map->w, h);
+}
+
+static Map *
+_map_new(War2_Data    *w2,
+         const Pud    *pud,
+         Pud_Bool      units)
+{
+   Map *map;
+
+   map = calloc(1, sizeof(Map));
+   if (!map) DIE_RETURN(NULL, "Failed to allocate memory");
+   map->pud = pud;
+   map->w = pud->map_w * 32;
+   map->h = pud->map_h * 32;
+   war2_unit_sprites_init(&(map->sprites), pud->era);
+
+   map->ts = war2_tileset_open(w2, pud->era);
+   if (!map->ts) goto fail;
+
+   if (units)
+     {
+        /* Sprites are loaded once for all, workers only read them */
+        if ((!war2_unit_sprites_load(w2, &(map->sprites), pud)) ||
+            (!_map_units_sort(map)))
+          goto fail;
+     }
+
+   return map;
+
+fail:
+   war2_tileset_close(map->ts);
+   war2_unit_sprites_clear(&(map->sprites));
+   free(map->units);
+   free(map);
+   return NULL;
+}
+
+static void
+_map_free(Map *map)
+{
+   free(map->strips);
+   free(map->units);
+   war2_unit_sprites_clear(&(map->sprites));
+   war2_tileset_close(map->ts);
+   free(map);
+}
+
+PUDAPI Pud_Bool
+war2_map_render(War2_Data                     *w2,
+                const Pud                     *pud,
+                const War2_Map_Render_Options *opts,
+                const War2_Map_Sink           *sink)
+{
+   const War2_Map_Render_Options defaults = {
+      .strip_rows = STRIP_ROWS_DEFAULT,
+      .nthreads = 0,
+      .units = PUD_TRUE,
+   };
+   Map *map;
+   unsigned int strips, batch, count, j, y, rows;
+   Pud_Bool ok = PUD_FALSE;
+
+   if ((!w2) || (!pud) || (!sink) || (!sink->rows))
+     DIE_RETURN(PUD_FALSE, "Invalid arguments");
+   if (!opts) opts = &defaults;
+
+   map = _map_new(w2, pud, opts->units);
+   if (!map) return PUD_FALSE;
+   map->strip_h = ((opts->strip_rows) ? opts->strip_rows : STRIP_ROWS_DEFAULT) * 32;
+
+   strips = (map->h + map->strip_h - 1) / map->strip_h;
+   batch = war2_workers_count(opts->nthreads);
+   if (batch > strips) batch = strips;
+   map->strips = malloc((size_t)batch * map->w * map->strip_h * sizeof(Pud_Color) + 1);
+   if (!map->strips) DIE_GOTO(end, "Failed to allocate memory");
+
+   for (map->first = 0; map->first < strips; map->first += count)
+     {
+        count = strips - map->first;
+        if (count > batch) count = batch;
+        war2_jobs_run(count, opts->nthreads, _map_strip_job, map);
+
+        for (j = 0; j < count; ++j)
+          {
+             y = (map->first + j) * map->strip_h;
+             rows = (y + map->strip_h > map->h) ? map->h - y : map->strip_h;
+             if (!sink->rows(sink->data,
+                             &(map->strips[(size_t)j * map->w * map->strip_h]),
+                             map->w, y, rows))
+               {
+                  WAR2_VERBOSE(w2, 1, "Rendering aborted at row %u", y);
+                  goto end;
+               }
+          }
+     }
+   ok = PUD_TRUE;
+
+end:
+   _map_free(map);
+   return ok;
+}
+
+/*============================================================================*
+ *                                  Pyramid                                   *
+ *============================================================================*/
+
+/*
+ * The base level is rendered one row of tiles at a time. Each tile, once
+ * delivered, is reduced by a 2x2 box filter into its quadrant of the tile
+ * above it, in a row buffer kept for each coarser level. When the last
+ * row of tiles feeding a row of a coarser level is done, this row is
+ * delivered and reduced in turn. So only one row of tiles per level is
+ * ever held in memory, never the whole map.
+ */
+
+#define PYRAMID_T WAR2_PYRAMID_TILE_SIZE
+#define PYRAMID_LEVELS_MAX 32
+
+typedef struct
+{
+   Map                    *map;
+   War2_Pyramid_Tile_Func  func;
+   void                   *data;
+
+   unsigned int            levels;
+   unsigned int            cols[PYRAMID_LEVELS_MAX];
+   unsigned int            rows[PYRAMID_LEVELS_MAX];
+   /* One row of tiles per level. The finest one is rendered, the others
+    * are filled by reducing the level below */
+   Pud_Color              *tiles[PYRAMID_LEVELS_MAX];
+
+   /* Row being delivered, and the result of each of its tiles */
+   unsigned int            level;
+   unsigned int            row;
+   Pud_Bool               *ok;
+} Pyramid;
+
+static unsigned int
+_pyramid_levels(unsigned int w,
+                unsigned int h)
+{
+   unsigned int levels = 1, size = PYRAMID_T;
+
+   while ((size < w) || (size < h))
+     {
+        size *= 2;
+        levels++;
+     }
+   return levels;
+}
+
+static void
+_pyramid_reduce(const Pud_Color *src,
+                Pud_Color       *dst)
+{
+   const unsigned char *s0, *s1;
+   unsigned char *d;
+   unsigned int x, y, c;
+
+   /* dst is a quadrant of a tile, so its rows are a whole tile apart */
+   for (y = 0; y < PYRAMID_T / 2; ++y)
+     {
+        s0 = (const unsigned char *)&(src[(2 * y) * PYRAMID_T]);
+        s1 = (const unsigned char *)&(src[(2 * y + 1) * PYRAMID_T]);
+        d = (unsigned char *)&(dst[y * PYRAMID_T]);
+        for (x = 0; x < PYRAMID_T / 2; ++x)
+          {
+             for (c = 0; c < 4; ++c)
+               d[c] = (s0[c] + s0[c + 4] + s1[c] + s1[c + 4] + 2) >> 2;
+             s0 += 8;
+             s1 += 8;
+             d += 4;
+          }
+     }
+}
+
+static void
+_pyramid_tile_job(void         *data,
+                  unsigned int  job)
+{
+   Pyramid *const p = data;
+   const unsigned int level = p->level;
+   Pud_Color *const tile = &(p->tiles[level][(size_t)job * PYRAMID_T * PYRAMID_T]);
+   const unsigned int x0 = job * PYRAMID_T, y0 = p->row * PYRAMID_T;
+   Pud_Color *parent;
+   unsigned int y;
+
+   if (level == p->levels - 1)
+     {
+        _map_area_render(p->map, tile, x0, y0, PYRAMID_T, PYRAMID_T);
+
+        /* Sprites may overhang the edges of the map: clear past them */
+        for (y = 0; y < PYRAMID_T; ++y)
+          {
+             if (y0 + y >= p->map->h)
+               memset(&(tile[y * PYRAMID_T]), 0, PYRAMID_T * sizeof(Pud_Color));
+             else if (x0 + PYRAMID_T > p->map->w)
+               memset(&(tile[y * PYRAMID_T + (p->map->w - x0)]), 0,
+                      (x0 + PYRAMID_T - p->map->w) * sizeof(Pud_Color));
+          }
+     }
+
+   p->ok[job] = p->func(p->data, tile, level, job, p->row);
+
+   /* Sibling tiles fill distinct quadrants of their parent */
+   if (level > 0)
+     {
+        parent = &(p->tiles[level - 1][(size_t)(job / 2) * PYRAMID_T * PYRAMID_T]);
+        _pyramid_reduce(tile, &(parent[((p->row & 1) * PYRAMID_T + (job & 1)) *
+                                       (PYRAMID_T / 2)]));
+     }
+}
+
+static Pud_Bool
+_pyramid_row(Pyramid      *p,
+             unsigned int  level,
+             unsigned int  row,
+             unsigned int  nthreads)
+{
+   unsigned int i;
+
+   p->level = level;
+   p->row = row;
+   war2_jobs_run(p->cols[level], nthreads, _pyramid_tile_job, p);
+   for (i = 0; i < p->cols[level]; ++i)
+     if (!p->ok[i]) return PUD_FALSE;
+
+   /* The coarser levels are accumulated: start afresh for the next row */
+   if (level != p->levels - 1)
+     memset(p->tiles[level], 0,
+            (size_t)p->cols[level] * PYRAMID_T * PYRAMID_T * sizeof(Pud_Color));
+
+   /* The parent row is complete when its bottom half has been filled */
+   if ((level > 0) && ((row & 1) || (row == p->rows[level] - 1)))
+     return _pyramid_row(p, level - 1, row / 2, nthreads);
+   return PUD_TRUE;
+}
+
+PUDAPI unsigned int
+war2_map_pyramid_levels_get(const Pud *pud)
+{
+   if (!pud) DIE_RETURN(0, "Invalid arguments");
+   return _pyramid_levels(pud->map_w * 32, pud->map_h * 32);
+}
+
+PUDAPI Pud_Bool
+war2_map_pyramid_render(War2_Data                     *w2,
+                        const Pud                     *pud,
+                        const War2_Map_Render_Options *opts,
+                        War2_Pyramid_Tile_Func         func,
+                        void                          *data)
+{
+   const War2_Map_Render_Options defaults = {
+      .nthreads = 0,
+      .units = PUD_TRUE,
+   };
+   Pyramid p;
+   unsigned int l, w, h, row;
+   Pud_Bool ok = PUD_FALSE;
+
+   if ((!w2) || (!pud) || (!func))
+     DIE_RETURN(PUD_FALSE, "Invalid arguments");
+   if (!opts) opts = &defaults;
+
+   memset(&p, 0, sizeof(p));
+   p.func = func;
+   p.data = data;
+   p.map = _map_new(w2, pud, opts->units);
+   if (!p.map) return PUD_FALSE;
+
+   /* Level 0 is a single tile, each level doubles the resolution */
+   p.levels = _pyramid_levels(p.map->w, p.map->h);
+   if (p.levels > PYRAMID_LEVELS_MAX) DIE_GOTO(end, "Map too large");
+   for (l = p.levels; l-- > 0; )
+     {
+        w = (p.map->w + (1u << (p.levels - 1 - l)) - 1) >> (p.levels - 1 - l);
+        h = (p.map->h + (1u << (p.levels - 1 - l)) - 1) >> (p.levels - 1 - l);
+        p.cols[l] = (w + PYRAMID_T - 1) / PYRAMID_T;
+        p.rows[l] = (h + PYRAMID_T - 1) / PYRAMID_T;
+        p.tiles[l] = calloc((size_t)p.cols[l] * PYRAMID_T * PYRAMID_T,
+                            sizeof(Pud_Color));
+        if (!p.tiles[l]) DIE_GOTO(end, "Failed to allocate memory");
+     }
+   p.ok = malloc(p.cols[p.levels - 1] * sizeof(Pud_Bool));
+   if (!p.ok) DIE_GOTO(end, "Failed to allocate memory");
+
+   for (row = 0; row < p.rows[p.levels - 1]; ++row)
+     if (!_pyramid_row(&p, p.levels - 1, row, opts->nthreads))
+       {
+          WAR2_VERBOSE(w2, 1, "Pyramid aborted at level %u, row %u",
+                       p.level, p.row);
+          goto end;
+       }
+   ok = PUD_TRUE;
+
+end:
+   for (l = 0; l < p.levels && l < PYRAMID_LEVELS_MAX; ++l)
+     free(p.tiles[l]);
+   free(p.ok);
+   _map_free(p.map);
+   return ok;
+}
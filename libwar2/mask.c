@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2017 Jean Guyomarc'h
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "war2_private.h"
+
+PUDAPI Pud_Bool
+war2_mask_hit(const War2_Mask *mask,
+              int              x,
+              int              y)
+{
+   if ((!mask) || (x < 0) || (y < 0) ||
+       ((unsigned int)x >= mask->w) || ((unsigned int)y >= mask->h))
+     return PUD_FALSE;
+
+   return (mask->bits[y * mask->stride + (x >> 3)] & (1 << (x & 0x7)))
+      ? PUD_TRUE : PUD_FALSE;
+}
+
+PUDAPI War2_Mask *
+war2_mask_dup(const War2_Mask *mask)
+{
+   War2_Mask *m;
+   const size_t size = (size_t)mask->stride * (size_t)mask->h;
+
+   /* Bits are allocated along with the mask */
+   m = malloc(sizeof(War2_Mask) + size);
+   if (!m) DIE_RETURN(NULL, "Failed to allocate memory");
+
+   m->w = mask->w;
+   m->h = mask->h;
+   m->stride = mask->stride;
+   m->bits = (unsigned char *)(m + 1);
+   memcpy(m->bits, mask->bits, size);
+
+   return m;
+}
+
+PUDAPI void
+war2_mask_free(War2_Mask *mask)
+{
+   free(mask);
+}
@@ -27,59 +27,440 @@
 # include <png.h>
 #endif
 
-PUDAPI Pud_Bool
-war2_png_write(const char          *file,
-               unsigned int          w,
-               unsigned int          h,
-               const unsigned char *data)
+#if HAVE_PNG
+typedef struct
+{
+   /* Rows of the image being encoded, grown as needed */
+   png_bytepp     rows;
+   unsigned int   rows_alloc;
+   /* Remapped indexes of a paletted image, grown as needed */
+   unsigned char *pixels;
+   size_t         pixels_alloc;
+} Png_Codec;
+
+static void
+_png_buffer_write_cb(png_structp  png_ptr,
+                     png_bytep    data,
+                     png_size_t   size)
+{
+   War2_Buffer *const buf = png_get_io_ptr(png_ptr);
+
+   if (!war2_buffer_append(buf, data, size))
+     png_error(png_ptr, "Failed to grow buffer");
+}
+
+static void
+_png_buffer_flush_cb(png_structp png_ptr)
+{
+   (void) png_ptr;
+}
+#endif
+
+PUDAPI_INTERNAL Pud_Bool
+war2_png_encoder_init(War2_Encoder *enc)
+{
+#if HAVE_PNG
+   enc->codec = calloc(1, sizeof(Png_Codec));
+   if (!enc->codec) DIE_RETURN(PUD_FALSE, "Failed to allocate memory");
+   return PUD_TRUE;
+#else
+   (void) enc;
+   DIE_RETURN(PUD_FALSE, "libwar2 was compiled without PNG support");
+#endif
+}
+
+PUDAPI_INTERNAL void
+war2_png_encoder_clear(War2_Encoder *enc)
+{
+#if HAVE_PNG
+   Png_Codec *const codec = enc->codec;
+
+   if (codec)
+     {
+        free(codec->rows);
+        free(codec->pixels);
+     }
+   free(codec);
+   enc->codec = NULL;
+#else
+   (void) enc;
+#endif
+}
+
+#if HAVE_PNG
+/*
+ * Only the colors actually used are stored in the palette, the
+ * transparent one first so tRNS is a single byte. The pixels are remapped
+ * into the codec, and are packed by libpng at the smallest bit depth that
+ * can hold the palette. Returns the bit depth.
+ */
+static int
+_png_palette_set(png_structp          png_ptr,
+                 png_infop            info_ptr,
+                 Png_Codec           *codec,
+                 unsigned int         w,
+                 unsigned int         h,
+                 const unsigned char *indexes,
+                 const Pud_Color     *palette,
+                 int                  transparent)
+{
+   png_color colors[WAR2_PALETTE_SIZE];
+   png_byte alpha = 0x00;
+   unsigned char map[WAR2_PALETTE_SIZE];
+   unsigned char used[WAR2_PALETTE_SIZE] = { 0 };
+   const size_t size = (size_t)w * h;
+   size_t k;
+   unsigned int i, count = 0;
+   Pud_Bool has_transparent = PUD_FALSE;
+
+   for (k = 0; k < size; k++)
+     used[indexes[k]] = 1;
+
+   if ((transparent >= 0) && (transparent < WAR2_PALETTE_SIZE) &&
+       (used[transparent]))
+     {
+        map[transparent] = count;
+        colors[count].red = palette[transparent].r;
+        colors[count].green = palette[transparent].g;
+        colors[count].blue = palette[transparent].b;
+        count++;
+        has_transparent = PUD_TRUE;
+     }
+   for (i = 0; i < WAR2_PALETTE_SIZE; i++)
+     {
+        if ((!used[i]) || ((has_transparent) && ((int)i == transparent)))
+          continue;
+        map[i] = count;
+        colors[count].red = palette[i].r;
+        colors[count].green = palette[i].g;
+        colors[count].blue = palette[i].b;
+        count++;
+     }
+   if (count == 0) /* Empty image */
+     {
+        memset(&(colors[0]), 0, sizeof(png_color));
+        count = 1;
+     }
+
+   for (k = 0; k < size; k++)
+     codec->pixels[k] = map[indexes[k]];
+
+   png_set_PLTE(png_ptr, info_ptr, colors, count);
+   if (has_transparent)
+     png_set_tRNS(png_ptr, info_ptr, &alpha, 1, NULL);
+
+   if (count <= 2) return 1;
+   else if (count <= 4) return 2;
+   else if (count <= 16) return 4;
+   else return 8;
+}
+#endif
+
+/*
+ * Encodes an image either in a file or at the end of a buffer. A png
+ * struct cannot encode more than one image, so only the rows array is
+ * kept. Errors of libpng (including a buffer that cannot grow) jump back
+ * here. When a palette is given, data holds one index per pixel instead
+ * of RGBA pixels.
+ */
+PUDAPI_INTERNAL Pud_Bool
+war2_png_encoder_encode(War2_Encoder        *enc,
+                        FILE                *f,
+                        War2_Buffer         *buf,
+                        unsigned int         w,
+                        unsigned int         h,
+                        const unsigned char *data,
+                        const Pud_Color     *palette,
+                        int                  transparent)
 {
 #if HAVE_PNG
-   FILE *f;
-   int i;
+   static const int filters[] = {
+      [WAR2_PNG_FILTER_ADAPTIVE] = PNG_ALL_FILTERS,
+      [WAR2_PNG_FILTER_NONE]     = PNG_FILTER_NONE,
+      [WAR2_PNG_FILTER_SUB]      = PNG_FILTER_SUB,
+      [WAR2_PNG_FILTER_UP]       = PNG_FILTER_UP,
+      [WAR2_PNG_FILTER_AVG]      = PNG_FILTER_AVG,
+      [WAR2_PNG_FILTER_PAETH]    = PNG_FILTER_PAETH,
+   };
+   Png_Codec *const codec = enc->codec;
+   const War2_Encoder_Options *const opts = &(enc->opts);
+   const unsigned int bpp = (palette) ? 1 : 4;
+   const size_t size = (size_t)w * h;
    png_structp png_ptr;
    png_infop info_ptr;
-   png_bytepp row_pointers;
+   png_bytepp rows;
+   unsigned char *pixels;
+   unsigned int i;
+   int depth = 8;
 
-   f = fopen(file, "wb");
-   if (!f) DIE_RETURN(PUD_FALSE, "Failed to open [%s]", file);
+   if (h > codec->rows_alloc)
+     {
+        rows = realloc(codec->rows, h * sizeof(png_bytep));
+        if (!rows) DIE_RETURN(PUD_FALSE, "Failed to allocate memory");
+        codec->rows = rows;
+        codec->rows_alloc = h;
+     }
+   if ((palette) && (size > codec->pixels_alloc))
+     {
+        pixels = realloc(codec->pixels, size);
+        if (!pixels) DIE_RETURN(PUD_FALSE, "Failed to allocate memory");
+        codec->pixels = pixels;
+        codec->pixels_alloc = size;
+     }
 
    png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
-   if (!png_ptr) DIE_GOTO(err, "Failed to create png struct");
+   if (!png_ptr) DIE_RETURN(PUD_FALSE, "Failed to create png struct");
 
    info_ptr = png_create_info_struct(png_ptr);
-   if (!info_ptr) DIE_GOTO(errf, "Failed to create png info struct");
+   if (!info_ptr) DIE_GOTO(err, "Failed to create png info struct");
 
-   png_init_io(png_ptr, f);
+   if (setjmp(png_jmpbuf(png_ptr)))
+     DIE_GOTO(err, "Failed to encode png");
 
-   png_set_IHDR(png_ptr, info_ptr, w, h, 8, PNG_COLOR_TYPE_RGBA,
-                PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_BASE,
-                PNG_FILTER_TYPE_BASE);
-   png_write_info(png_ptr, info_ptr);
+   if (buf)
+     png_set_write_fn(png_ptr, buf, _png_buffer_write_cb, _png_buffer_flush_cb);
+   else
+     png_init_io(png_ptr, f);
+
+   /* The defaults of libpng are left untouched unless asked otherwise */
+   if ((opts->png_level >= 1) && (opts->png_level <= 9))
+     png_set_compression_level(png_ptr, opts->png_level);
+   if ((opts->png_filter != WAR2_PNG_FILTER_ADAPTIVE) &&
+       ((unsigned int)opts->png_filter < sizeof(filters) / sizeof(filters[0])))
+     png_set_filter(png_ptr, PNG_FILTER_TYPE_BASE, filters[opts->png_filter]);
 
-   row_pointers = malloc(h * sizeof(unsigned char *));
-   if (!row_pointers) DIE_GOTO(errf, "Failed to allocate memory");
+   if (palette)
+     {
+        depth = _png_palette_set(png_ptr, info_ptr, codec, w, h, data,
+                                 palette, transparent);
+        data = codec->pixels;
+     }
    for (i = 0; i < h; i++)
-     row_pointers[i] = (png_bytep)(&(data[i * w * 4]));
+     codec->rows[i] = (png_bytep)(&(data[(size_t)i * w * bpp]));
 
-   png_write_image(png_ptr, row_pointers);
+   png_set_IHDR(png_ptr, info_ptr, w, h, depth,
+                (palette) ? PNG_COLOR_TYPE_PALETTE : PNG_COLOR_TYPE_RGBA,
+                PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_BASE,
+                PNG_FILTER_TYPE_BASE);
+   png_write_info(png_ptr, info_ptr);
+   /* Rows hold one index per byte, whatever the bit depth */
+   if (depth < 8) png_set_packing(png_ptr);
+   png_write_image(png_ptr, codec->rows);
    png_write_end(png_ptr, NULL);
    png_destroy_write_struct(&png_ptr, &info_ptr);
-   free(row_pointers);
-   fclose(f);
 
    return PUD_TRUE;
 
-errf:
-   png_destroy_write_struct(&png_ptr, &info_ptr);
 err:
-   fclose(f);
+   png_destroy_write_struct(&png_ptr, &info_ptr);
+   return PUD_FALSE;
+#else
+   (void) enc;
+   (void) f;
+   (void) buf;
+   (void) w;
+   (void) h;
+   (void) data;
+   (void) palette;
+   (void) transparent;
    return PUD_FALSE;
+#endif
+}
+
+PUDAPI Pud_Bool
+war2_png_write(const char          *file,
+               unsigned int          w,
+               unsigned int          h,
+               const unsigned char *data)
+{
+   War2_Encoder *enc;
+   Pud_Bool chk;
+
+   enc = war2_encoder_new(WAR2_ENCODER_FORMAT_PNG, NULL);
+   if (!enc) return PUD_FALSE;
+   chk = war2_encoder_write(enc, file, w, h, data);
+   war2_encoder_free(enc);
+
+   return chk;
+}
+
+PUDAPI Pud_Bool
+war2_png_encode(War2_Buffer         *buf,
+                unsigned int         w,
+                unsigned int         h,
+                const unsigned char *data)
+{
+   War2_Encoder *enc;
+   Pud_Bool chk;
+
+   enc = war2_encoder_new(WAR2_ENCODER_FORMAT_PNG, NULL);
+   if (!enc) return PUD_FALSE;
+   chk = war2_encoder_encode(enc, buf, w, h, data);
+   war2_encoder_free(enc);
+
+   return chk;
+}
+
+PUDAPI Pud_Bool
+war2_png_write_indexed(const char          *file,
+                       unsigned int         w,
+                       unsigned int         h,
+                       const unsigned char *indexes,
+                       const Pud_Color     *palette,
+                       int                  transparent_index)
+{
+   War2_Encoder *enc;
+   Pud_Bool chk;
+
+   enc = war2_encoder_new(WAR2_ENCODER_FORMAT_PNG, NULL);
+   if (!enc) return PUD_FALSE;
+   chk = war2_encoder_write_indexed(enc, file, w, h, indexes, palette,
+                                    transparent_index);
+   war2_encoder_free(enc);
+
+   return chk;
+}
+
+PUDAPI Pud_Bool
+war2_png_encode_indexed(War2_Buffer         *buf,
+                        unsigned int         w,
+                        unsigned int         h,
+                        const unsigned char *indexes,
+                        const Pud_Color     *palette,
+                        int                  transparent_index)
+{
+   War2_Encoder *enc;
+   Pud_Bool chk;
+
+   enc = war2_encoder_new(WAR2_ENCODER_FORMAT_PNG, NULL);
+   if (!enc) return PUD_FALSE;
+   chk = war2_encoder_encode_indexed(enc, buf, w, h, indexes, palette,
+                                     transparent_index);
+   war2_encoder_free(enc);
+
+   return chk;
+}
+
+struct _War2_Png_Writer
+{
+#if HAVE_PNG
+   FILE         *f;
+   png_structp   png_ptr;
+   png_infop     info_ptr;
+#endif
+   unsigned int  w;
+   unsigned int  h;
+   unsigned int  rows;
+   /* libpng is not called anymore once it has failed */
+   Pud_Bool      failed;
+};
+
+PUDAPI War2_Png_Writer *
+war2_png_writer_new(const char   *file,
+                    unsigned int  w,
+                    unsigned int  h)
+{
+#if HAVE_PNG
+   War2_Png_Writer *png;
+
+   png = calloc(1, sizeof(War2_Png_Writer));
+   if (!png) DIE_RETURN(NULL, "Failed to allocate memory");
+   png->w = w;
+   png->h = h;
+
+   png->f = fopen(file, "wb");
+   if (!png->f) DIE_GOTO(err, "Failed to open [%s]", file);
+
+   png->png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+   if (!png->png_ptr) DIE_GOTO(errf, "Failed to create png struct");
+
+   png->info_ptr = png_create_info_struct(png->png_ptr);
+   if (!png->info_ptr) DIE_GOTO(errp, "Failed to create png info struct");
+
+   if (setjmp(png_jmpbuf(png->png_ptr)))
+     DIE_GOTO(errp, "Failed to write png header in [%s]", file);
+
+   png_init_io(png->png_ptr, png->f);
+
+   png_set_IHDR(png->png_ptr, png->info_ptr, w, h, 8, PNG_COLOR_TYPE_RGBA,
+                PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_BASE,
+                PNG_FILTER_TYPE_BASE);
+   png_write_info(png->png_ptr, png->info_ptr);
+
+   return png;
+
+errp:
+   png_destroy_write_struct(&png->png_ptr, &png->info_ptr);
+errf:
+   fclose(png->f);
+err:
+   free(png);
+   return NULL;
 
 #else
    (void) file;
    (void) w;
    (void) h;
-   (void) data;
+   return NULL;
+#endif
+}
+
+PUDAPI Pud_Bool
+war2_png_writer_rows_write(War2_Png_Writer *png,
+                           const Pud_Color *rows,
+                           unsigned int     count)
+{
+#if HAVE_PNG
+   unsigned int i;
+
+   if (png->failed) DIE_RETURN(PUD_FALSE, "Writer already failed");
+   if (png->rows + count > png->h)
+     DIE_RETURN(PUD_FALSE, "Too many rows (%u + %u > %u)",
+                png->rows, count, png->h);
+
+   if (setjmp(png_jmpbuf(png->png_ptr)))
+     {
+        png->failed = PUD_TRUE;
+        DIE_RETURN(PUD_FALSE, "Failed to write png rows");
+     }
+
+   for (i = 0; i < count; i++)
+     png_write_row(png->png_ptr, (png_const_bytep)(&(rows[i * png->w])));
+   png->rows += count;
+
+   return PUD_TRUE;
+#else
+   (void) png;
+   (void) rows;
+   (void) count;
    return PUD_FALSE;
 #endif
 }
+
+PUDAPI Pud_Bool
+war2_png_writer_close(War2_Png_Writer *png)
+{
+   Pud_Bool complete;
+
+   if (!png) return PUD_FALSE;
+   complete = ((png->rows == png->h) && (!png->failed));
+
+#if HAVE_PNG
+   /* An incomplete or failed image cannot be ended */
+   if (complete)
+     {
+        if (setjmp(png_jmpbuf(png->png_ptr)))
+          {
+             ERR("Failed to end png");
+             complete = PUD_FALSE;
+          }
+        else
+          png_write_end(png->png_ptr, NULL);
+     }
+   png_destroy_write_struct(&png->png_ptr, &png->info_ptr);
+   if (fclose(png->f) != 0) complete = PUD_FALSE;
+#endif
+   free(png);
+
+   return complete;
+}
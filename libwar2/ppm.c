@@ -20,30 +20,114 @@
  * DEALINGS IN THE SOFTWARE.
  */
 
-#include "war2.h"
-#include <inttypes.h>
+#include "war2_private.h"
+
+/*
+ * The whole image is encoded in memory: alpha is stripped while copying
+ * the pixels (P6), or the values are formatted by hand (P3), so the file
+ * is written by a single fwrite() rather than one call per pixel.
+ */
+
+static unsigned char *
+_ascii_byte(unsigned char *p,
+            unsigned char  v)
+{
+   if (v >= 100)
+     {
+        *(p++) = '0' + v / 100;
+        *(p++) = '0' + (v / 10) % 10;
+     }
+   else if (v >= 10)
+     *(p++) = '0' + v / 10;
+   *(p++) = '0' + v % 10;
+   return p;
+}
 
 PUDAPI Pud_Bool
-war2_ppm_write(const char          *file,
-               unsigned int         w,
-               unsigned int         h,
-               const unsigned char *data)
+war2_ppm_encode(War2_Buffer         *buf,
+                unsigned int         w,
+                unsigned int         h,
+                const unsigned char *data,
+                War2_Ppm_Format      format)
 {
-   const unsigned int size = w * h * 4u;
-   FILE *f;
-   unsigned int i;
+   const size_t count = (size_t)w * h;
+   const unsigned char *s;
+   unsigned char *d;
+   char header[64];
+   size_t i, bpp;
+   int len;
 
-   f = fopen(file, "w+");
-   if (f == NULL) return PUD_FALSE;
+   if ((!buf) || (!data) || (w == 0) || (h == 0))
+     DIE_RETURN(PUD_FALSE, "Invalid arguments");
 
-   fprintf(f, "P3\n%u %u\n255\n", w, h);
-   for (i = 0; i < size; i += 4)
+   len = snprintf(header, sizeof(header), "%s\n%u %u\n255\n",
+                  (format == WAR2_PPM_FORMAT_ASCII) ? "P3" : "P6", w, h);
+
+   /* At most "255 255 255\n" per pixel in ASCII */
+   bpp = (format == WAR2_PPM_FORMAT_ASCII) ? 12 : 3;
+   if (count > ((size_t)-1 - len) / bpp)
+     DIE_RETURN(PUD_FALSE, "Image too large");
+   d = war2_buffer_reserve(buf, len + count * bpp);
+   if (!d) return PUD_FALSE;
+
+   memcpy(d, header, len);
+   d += len;
+   s = data;
+   if (format == WAR2_PPM_FORMAT_ASCII)
      {
-        fprintf(f, "%" PRIu8 " %" PRIu8 " %" PRIu8 "\n",
-                data[i], data[i + 1], data[i + 2]);
+        for (i = 0; i < count; i++, s += 4)
+          {
+             d = _ascii_byte(d, s[0]);
+             *(d++) = ' ';
+             d = _ascii_byte(d, s[1]);
+             *(d++) = ' ';
+             d = _ascii_byte(d, s[2]);
+             *(d++) = '\n';
+          }
      }
-
-   fclose(f);
+   else
+     {
+        for (i = 0; i < count; i++, s += 4, d += 3)
+          {
+             d[0] = s[0];
+             d[1] = s[1];
+             d[2] = s[2];
+          }
+     }
+   buf->size = d - buf->data;
 
    return PUD_TRUE;
 }
+
+PUDAPI Pud_Bool
+war2_ppm_format_write(const char          *file,
+                      unsigned int         w,
+                      unsigned int         h,
+                      const unsigned char *data,
+                      War2_Ppm_Format      format)
+{
+   War2_Buffer buf = { NULL, 0, 0 };
+   Pud_Bool ok = PUD_FALSE;
+   FILE *f;
+
+   if (!war2_ppm_encode(&buf, w, h, data, format)) return PUD_FALSE;
+
+   f = fopen(file, "wb");
+   if (!f) DIE_GOTO(end, "Failed to open [%s]", file);
+   ok = (fwrite(buf.data, 1, buf.size, f) == buf.size);
+   if (fclose(f) != 0) ok = PUD_FALSE;
+   if (!ok) ERR("Failed to write [%s]", file);
+
+end:
+   war2_buffer_free(&buf);
+   return ok;
+}
+
+PUDAPI Pud_Bool
+war2_ppm_write(const char          *file,
+               unsigned int         w,
+               unsigned int         h,
+               const unsigned char *data)
+{
+   return war2_ppm_format_write(file, w, h, data, WAR2_PPM_FORMAT_BINARY);
+}
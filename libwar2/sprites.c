@@ -25,6 +25,9 @@
 #define RLE_REPEAT (1 << 6)
 #define RLE_LEAVE  (1 << 7)
 
+/* Pud_Player values fit in 4 bits (neutral is 15) */
+#define PLAYER_BIT(p_) (((unsigned int)(p_) < 16) ? (1u << (p_)) : 0u)
+
 typedef struct
 {
    unsigned char r;
@@ -85,47 +88,288 @@ static const Col _colors[8][4] =
 };
 
 
+typedef struct
+{
+   uint16_t      entries[4]; /* Indexed by Pud_Era. 0 means no entry */
+   War2_Sprites  type;
+   Pud_Side      side;
+} Object_Entries;
+
+#define OBJ(type_, side_, a_, b_, c_, d_) \
+   { { a_, b_, c_, d_ }, WAR2_SPRITES_ ## type_, PUD_SIDE_ ## side_ }
+#define HUMAN_UNIT(a_, b_, c_, d_) OBJ(UNITS, HUMAN, a_, b_, c_, d_)
+#define ORC_UNIT(a_, b_, c_, d_) OBJ(UNITS, ORC, a_, b_, c_, d_)
+#define NEUTRAL_UNIT(a_, b_, c_, d_) OBJ(UNITS, NEUTRAL, a_, b_, c_, d_)
+#define HUMAN_START(a_, b_, c_, d_) OBJ(SYSTEM, HUMAN, a_, b_, c_, d_)
+#define ORC_START(a_, b_, c_, d_) OBJ(SYSTEM, ORC, a_, b_, c_, d_)
+#define HUMAN_BUILDING(a_, b_, c_, d_) OBJ(BUILDINGS, HUMAN, a_, b_, c_, d_)
+#define ORC_BUILDING(a_, b_, c_, d_) OBJ(BUILDINGS, ORC, a_, b_, c_, d_)
+#define NEUTRAL_BUILDING(a_, b_, c_, d_) OBJ(BUILDINGS, NEUTRAL, a_, b_, c_, d_)
+
+/* Entries of the sprites of each object, for each era.
+ * Objects without sprites (walls, ...) have no entry. */
+static const Object_Entries _objects[PUD_UNIT_NONE] =
+{
+   [PUD_UNIT_DWARVES]                = HUMAN_UNIT( 33,  33,  33,  33),
+   [PUD_UNIT_GOBLIN_SAPPER]          = ORC_UNIT( 34,  34,  34,  34),
+   [PUD_UNIT_GRYPHON_RIDER]          = HUMAN_UNIT( 35,  35,  35,  35),
+   [PUD_UNIT_DRAGON]                 = ORC_UNIT( 36,  36,  36,  36),
+   [PUD_UNIT_EYE_OF_KILROGG]         = ORC_UNIT( 37,  37,  37,  37),
+   [PUD_UNIT_GNOMISH_FLYING_MACHINE] = HUMAN_UNIT( 38,  38,  38,  38),
+   [PUD_UNIT_HUMAN_TRANSPORT]        = HUMAN_UNIT( 39,  39,  39,  39),
+   [PUD_UNIT_ORC_TRANSPORT]          = ORC_UNIT( 40,  40,  40,  40),
+   [PUD_UNIT_BATTLESHIP]             = HUMAN_UNIT( 41,  41,  41,  41),
+   [PUD_UNIT_JUGGERNAUGHT]           = ORC_UNIT( 42,  42,  42,  42),
+   [PUD_UNIT_GNOMISH_SUBMARINE]      = HUMAN_UNIT( 43,  43, 182, 526),
+   [PUD_UNIT_GIANT_TURTLE]           = ORC_UNIT( 44,  44, 183, 527),
+   [PUD_UNIT_FOOTMAN]                = HUMAN_UNIT( 45,  45,  45,  45),
+   [PUD_UNIT_GRUNT]                  = ORC_UNIT( 46,  46,  46,  46),
+   [PUD_UNIT_PEASANT]                = HUMAN_UNIT( 47,  47,  47,  47),
+   [PUD_UNIT_PEON]                   = ORC_UNIT( 48,  48,  48,  48),
+   [PUD_UNIT_BALLISTA]               = HUMAN_UNIT( 49,  49,  49,  49),
+   [PUD_UNIT_CATAPULT]               = ORC_UNIT( 50,  50,  50,  50),
+   [PUD_UNIT_KNIGHT]                 = HUMAN_UNIT( 51,  51,  51,  51),
+   [PUD_UNIT_OGRE]                   = ORC_UNIT( 52,  52,  52,  52),
+   [PUD_UNIT_ARCHER]                 = HUMAN_UNIT( 53,  53,  53,  53),
+   [PUD_UNIT_AXETHROWER]             = ORC_UNIT( 54,  54,  54,  54),
+   [PUD_UNIT_MAGE]                   = HUMAN_UNIT( 55,  55,  55,  55),
+   [PUD_UNIT_DEATH_KNIGHT]           = ORC_UNIT( 58,  58,  58,  58),
+   [PUD_UNIT_HUMAN_TANKER]           = HUMAN_UNIT( 59,  59,  59,  59),
+   [PUD_UNIT_ORC_TANKER]             = ORC_UNIT( 60,  60,  60,  60),
+   [PUD_UNIT_ELVEN_DESTROYER]        = HUMAN_UNIT( 61,  61,  61,  61),
+   [PUD_UNIT_TROLL_DESTROYER]        = ORC_UNIT( 62,  62,  62,  62),
+   [PUD_UNIT_GOBLIN_ZEPPLIN]         = HUMAN_UNIT( 63,  63,  63,  63),
+   [PUD_UNIT_CRITTER_SHEEP]          = NEUTRAL_UNIT( 64,  64,  64,  64),
+   [PUD_UNIT_CRITTER_PIG]            = NEUTRAL_UNIT( 65,  65,  65,  65),
+   [PUD_UNIT_CRITTER_SEAL]           = NEUTRAL_UNIT( 66,  66,  66,  66),
+   [PUD_UNIT_CRITTER_RED_PIG]        = NEUTRAL_UNIT(470, 470, 470, 470),
+   [PUD_UNIT_SKELETON]               = NEUTRAL_UNIT( 69,  69,  69,  69),
+   [PUD_UNIT_DAEMON]                 = NEUTRAL_UNIT( 70,  70,  70,  70),
+   [PUD_UNIT_HUMAN_START]            = HUMAN_START(164, 164, 164, 164),
+   [PUD_UNIT_ORC_START]              = ORC_START(165, 165, 165, 165),
+   [PUD_UNIT_HUMAN_GUARD_TOWER]      = HUMAN_BUILDING( 80, 169,  80, 507),
+   [PUD_UNIT_ORC_GUARD_TOWER]        = ORC_BUILDING( 81, 170,  81, 508),
+   [PUD_UNIT_HUMAN_CANNON_TOWER]     = HUMAN_BUILDING( 82, 171,  82, 509),
+   [PUD_UNIT_ORC_CANNON_TOWER]       = ORC_BUILDING( 83, 172,  83, 510),
+   [PUD_UNIT_MAGE_TOWER]             = HUMAN_BUILDING( 84, 160,  84, 505),
+   [PUD_UNIT_TEMPLE_OF_THE_DAMNED]   = ORC_BUILDING( 85, 161,  85, 506),
+   [PUD_UNIT_KEEP]                   = HUMAN_BUILDING( 86, 128,  86, 473),
+   [PUD_UNIT_STRONGHOLD]             = ORC_BUILDING( 87, 129,  87, 474),
+   [PUD_UNIT_GRYPHON_AVIARY]         = HUMAN_BUILDING( 88, 130,  88, 475),
+   [PUD_UNIT_DRAGON_ROOST]           = ORC_BUILDING( 89, 131,  89, 476),
+   [PUD_UNIT_GNOMISH_INVENTOR]       = HUMAN_BUILDING( 90, 132,  90, 477),
+   [PUD_UNIT_GOBLIN_ALCHEMIST]       = ORC_BUILDING( 91, 133,  91, 478),
+   [PUD_UNIT_FARM]                   = HUMAN_BUILDING( 92, 134, 173, 479),
+   [PUD_UNIT_PIG_FARM]               = ORC_BUILDING( 93, 135, 174, 480),
+   [PUD_UNIT_HUMAN_BARRACKS]         = HUMAN_BUILDING( 94, 136,  94, 481),
+   [PUD_UNIT_ORC_BARRACKS]           = ORC_BUILDING( 95, 137,  95, 482),
+   [PUD_UNIT_CHURCH]                 = HUMAN_BUILDING( 96, 138,  96, 483),
+   [PUD_UNIT_ALTAR_OF_STORMS]        = ORC_BUILDING( 97, 139,  97, 484),
+   [PUD_UNIT_HUMAN_SCOUT_TOWER]      = HUMAN_BUILDING( 98, 140,  98, 485),
+   [PUD_UNIT_ORC_SCOUT_TOWER]        = ORC_BUILDING( 99, 141,  99, 486),
+   [PUD_UNIT_TOWN_HALL]              = HUMAN_BUILDING(100, 142, 100, 487),
+   [PUD_UNIT_GREAT_HALL]             = ORC_BUILDING(101, 143, 101, 488),
+   [PUD_UNIT_ELVEN_LUMBER_MILL]      = HUMAN_BUILDING(102, 144, 175, 489),
+   [PUD_UNIT_TROLL_LUMBER_MILL]      = ORC_BUILDING(103, 145, 176, 490),
+   [PUD_UNIT_STABLES]                = HUMAN_BUILDING(104, 146, 104, 491),
+   [PUD_UNIT_OGRE_MOUND]             = ORC_BUILDING(105, 147, 105, 492),
+   [PUD_UNIT_HUMAN_BLACKSMITH]       = HUMAN_BUILDING(106, 148, 106, 493),
+   [PUD_UNIT_ORC_BLACKSMITH]         = ORC_BUILDING(107, 149, 107, 494),
+   [PUD_UNIT_HUMAN_SHIPYARD]         = HUMAN_BUILDING(108, 150, 108, 495),
+   [PUD_UNIT_ORC_SHIPYARD]           = ORC_BUILDING(109, 151, 109, 496),
+   [PUD_UNIT_HUMAN_FOUNDRY]          = HUMAN_BUILDING(110, 152, 110, 497),
+   [PUD_UNIT_ORC_FOUNDRY]            = ORC_BUILDING(111, 153, 111, 498),
+   [PUD_UNIT_HUMAN_REFINERY]         = HUMAN_BUILDING(112, 154, 112, 499),
+   [PUD_UNIT_ORC_REFINERY]           = ORC_BUILDING(113, 155, 113, 500),
+   [PUD_UNIT_HUMAN_OIL_WELL]         = HUMAN_BUILDING(114, 156, 177, 501),
+   [PUD_UNIT_ORC_OIL_WELL]           = ORC_BUILDING(115, 157, 178, 502),
+   [PUD_UNIT_CASTLE]                 = HUMAN_BUILDING(116, 158, 116, 503),
+   [PUD_UNIT_FORTRESS]               = ORC_BUILDING(117, 159, 117, 504),
+   [PUD_UNIT_OIL_PATCH]              = NEUTRAL_BUILDING(118, 118, 180, 515),
+   [PUD_UNIT_GOLD_MINE]              = NEUTRAL_BUILDING(119, 162, 179, 511),
+   [PUD_UNIT_DARK_PORTAL]            = NEUTRAL_BUILDING(167, 184, 185, 513),
+   [PUD_UNIT_RUNESTONE]              = NEUTRAL_BUILDING(181, 186, 181, 514),
+   [PUD_UNIT_CIRCLE_OF_POWER]        = NEUTRAL_BUILDING(166, 166, 166, 525),
+};
+
+static const Object_Entries _icons = OBJ(ICONS, NEUTRAL, 356, 357, 358, 471);
+
+#undef NEUTRAL_BUILDING
+#undef ORC_BUILDING
+#undef HUMAN_BUILDING
+#undef ORC_START
+#undef HUMAN_START
+#undef NEUTRAL_UNIT
+#undef ORC_UNIT
+#undef HUMAN_UNIT
+#undef OBJ
+
 static void
-_sprites_colorize(Pud_Color    *sprite,
-                  unsigned int  size,
-                  Pud_Player    color)
+_sprites_palette_colorize(const Pud_Color *palette,
+                          Pud_Player       color,
+                          Pud_Color       *out)
 {
    unsigned int i, k;
-   Pud_Color *col;
 
-   if (color == PUD_PLAYER_RED) return;
+   memcpy(out, palette, WAR2_PALETTE_SIZE * sizeof(Pud_Color));
 
-   for (k = 0; k < size; ++k)
+   /* Red is the reference color. Neutral has no color of its own */
+   if ((color == PUD_PLAYER_RED) || ((unsigned int)color >= ARRAY_SIZE(_colors)))
+     return;
+
+   /* Colorizing the 256 entries of the palette once is equivalent to
+    * colorizing each pixel of each sprite */
+   for (k = 0; k < WAR2_PALETTE_SIZE; ++k)
      {
-        col = &(sprite[k]);
         for (i = 0; i < 4; ++i)
           {
-             if (!memcmp(col, &(_colors[0][i]), sizeof(Col)))
+             if (!memcmp(&(out[k]), &(_colors[0][i]), sizeof(Col)))
                {
-                  memcpy(col, &(_colors[color][i]), sizeof(Col));
+                  memcpy(&(out[k]), &(_colors[color][i]), sizeof(Col));
                   break;
                }
           }
      }
 }
 
+static inline void
+_sprites_span_opaque(unsigned char *bits,
+                     unsigned int   from,
+                     unsigned int   to,
+                     int           *first,
+                     int           *last)
+{
+   unsigned int px;
+
+   if ((int)from < *first) *first = from;
+   if ((int)to > *last) *last = to;
+   if (bits)
+     {
+        for (px = from; px <= to; ++px)
+          bits[px >> 3] |= (1 << (px & 0x7));
+     }
+}
+
+/*
+ * Walk through an RLE row of w pixels. Decoded pixels are written in out
+ * (if not NULL), and opaque pixels are set in the bits of a mask row (if
+ * not NULL). Color 0 is transparent in all the palettes.
+ * The extent of opaque pixels is returned in [first;last]. Returns
+ * PUD_FALSE if the row has no opaque pixel.
+ */
+static Pud_Bool
+_sprites_row_walk(const unsigned char *o,
+                  unsigned int         w,
+                  Pud_Bool             flip_x,
+                  unsigned char       *out,
+                  unsigned char       *bits,
+                  int                 *first,
+                  int                 *last)
+{
+   unsigned int pcount, k, px;
+   unsigned char c;
+
+   *first = w;
+   *last = -1;
+
+   for (pcount = 0; pcount < w;)
+     {
+        c = *(o++);
+        /* NOTE:
+         * The order of bits examination is important and
+         * not specified in the documentation!
+         */
+        if (c & RLE_LEAVE)
+          {
+             /* Leave (c \ RLE_LEAVE) pixels transparent */
+             c &= 0x7f;
+             if (c > w - pcount) c = w - pcount;
+             if (out)
+               {
+                  if (flip_x) memset(&(out[w - pcount - c]), 0, c);
+                  else memset(&(out[pcount]), 0, c);
+               }
+          }
+        else if (c & RLE_REPEAT)
+          {
+             /* Repeat the next byte (c \ RLE_REPEAT) times as pixel value */
+             c &= 0x3f;
+             if (c > w - pcount) c = w - pcount;
+             px = (flip_x) ? w - pcount - c : pcount;
+             if (out) memset(&(out[px]), *o, c);
+             if ((*o != 0) && (c > 0))
+               _sprites_span_opaque(bits, px, px + c - 1, first, last);
+             o++;
+          }
+        else
+          {
+             /* Take the next (c) bytes as pixel values */
+             if (c > w - pcount) c = w - pcount;
+             for (k = 0; k < c; ++k)
+               {
+                  /* Runs are written from the right edge of the row, so
+                   * a mirrored row comes out of the very same pass */
+                  px = (flip_x) ? w - 1 - pcount - k : pcount + k;
+                  if (out) out[px] = o[k];
+                  if (o[k] != 0)
+                    _sprites_span_opaque(bits, px, px, first, last);
+               }
+             o += c;
+          }
+        pcount += c;
+     }
+
+   return (*last >= 0) ? PUD_TRUE : PUD_FALSE;
+}
+
+static void
+_sprites_mask_crop(const War2_Mask *src,
+                   War2_Mask       *dst,
+                   unsigned int     x,
+                   unsigned int     y,
+                   unsigned int     w,
+                   unsigned int     h)
+{
+   unsigned int i, j;
+
+   dst->w = w;
+   dst->h = h;
+   dst->stride = (w + 7) / 8;
+   memset(dst->bits, 0, dst->stride * h);
+
+   for (j = 0; j < h; ++j)
+     for (i = 0; i < w; ++i)
+       if (war2_mask_hit(src, x + i, y + j))
+         dst->bits[j * dst->stride + (i >> 3)] |= (1 << (i & 0x7));
+}
 
 static Pud_Bool
 _sprites_entry_parse(War2_Data                *w2,
                      War2_Sprites_Descriptor  *ud,
                      unsigned int              entry,
+                     unsigned int              player_mask,
                      War2_Sprites_Decode_Func  func,
                      void                     *func_data)
 {
-   unsigned char *ptr;
+   War2_Entry e;
+   const unsigned char *ptr, *rows;
    uint16_t count, i, oline, max_w, max_h;
-   uint8_t x, y, w, h, c;
+   uint8_t x, y, w, h;
    uint32_t dstart;
-   size_t size, max_size;
-   unsigned int offset, l, pcount, k;
-   unsigned char *img = NULL, *pimg, *rows, *o;
+   size_t size, max_size, mask_size;
+   unsigned int offset, l, k, p, players_count = 0, out_w, out_h;
+   unsigned char *img = NULL;
    Pud_Color *img_rgba = NULL;
+   Pud_Color (*palettes)[WAR2_PALETTE_SIZE] = NULL;
+   Pud_Player players[16];
+   War2_Mask mask, trimmed;
    const Pud_Color *const palette = war2_palette_get(w2, ud->era);
+   const Pud_Bool flip_x = !!(ud->flags & WAR2_SPRITES_DECODE_FLIP_X);
+   const Pud_Bool with_mask = !!(ud->flags & WAR2_SPRITES_DECODE_MASK);
+   const Pud_Bool no_pixels = !!(ud->flags & WAR2_SPRITES_DECODE_NO_PIXELS);
+   const Pud_Bool trim = !!(ud->flags & WAR2_SPRITES_DECODE_TRIM);
+   const Pud_Bool indexed = !!(ud->flags & WAR2_SPRITES_DECODE_INDEXED);
+   int fx, first, last, x0, x1, y0, y1;
 
    /* If no callback has been specified, do nothing */
    if (!func)
@@ -133,17 +377,58 @@ _sprites_entry_parse(War2_Data                *w2,
         WAR2_VERBOSE(w2, 1, "Warning: No callback specified.");
         return PUD_TRUE;
      }
-
-   ptr = war2_entry_extract(w2, entry, &size);
-   if (!ptr) DIE_RETURN(PUD_FALSE, "Failed to extract entry");
+   if (!palette)
+     DIE_RETURN(PUD_FALSE, "Invalid era [%i]", ud->era);
+
+   /* Colorized palettes are computed once for all the frames */
+   for (p = 0; p < ARRAY_SIZE(players); ++p)
+     if (player_mask & (1u << p))
+       players[players_count++] = p;
+   if (players_count == 0)
+     DIE_RETURN(PUD_FALSE, "Invalid player mask [0x%x]", player_mask);
+   palettes = malloc(players_count * sizeof(*palettes));
+   if (!palettes) DIE_RETURN(PUD_FALSE, "Failed to allocate memory");
+   for (p = 0; p < players_count; ++p)
+     _sprites_palette_colorize(palette, players[p], palettes[p]);
+
+   if (!war2_entry_get(w2, entry, &e))
+     {
+        free(palettes);
+        DIE_RETURN(PUD_FALSE, "Failed to extract entry");
+     }
+   ptr = e.data;
 
    memcpy(&count, &(ptr[0]), sizeof(uint16_t));
    memcpy(&max_w, &(ptr[2]), sizeof(uint16_t));
    memcpy(&max_h, &(ptr[4]), sizeof(uint16_t));
 
    max_size = (size_t)max_w * (size_t)max_h;
-   img = malloc(max_size * sizeof(unsigned char));
-   img_rgba = malloc(max_size * sizeof(Pud_Color));
+   mask_size = (((size_t)max_w + 7) / 8) * (size_t)max_h;
+   mask.bits = NULL;
+   trimmed.bits = NULL;
+   ud->mask = NULL;
+   ud->indexes = NULL;
+   if (!no_pixels)
+     {
+        img = malloc(max_size * sizeof(unsigned char));
+        if (!indexed) img_rgba = malloc(max_size * sizeof(Pud_Color));
+     }
+   if (with_mask)
+     {
+        mask.bits = malloc(mask_size);
+        if (trim) trimmed.bits = malloc(mask_size);
+     }
+   if (((!no_pixels) && ((!img) || ((!indexed) && (!img_rgba)))) ||
+       ((with_mask) && ((!mask.bits) || ((trim) && (!trimmed.bits)))))
+     {
+        free(trimmed.bits);
+        free(mask.bits);
+        free(img_rgba);
+        free(img);
+        war2_entry_release(&e);
+        free(palettes);
+        DIE_RETURN(PUD_FALSE, "Failed to allocate memory");
+     }
 
    for (i = 0, offset = 6; i < count; ++i, offset += 8)
      {
@@ -153,75 +438,218 @@ _sprites_entry_parse(War2_Data                *w2,
         memcpy(&h, &(ptr[offset + 3]), sizeof(uint8_t));
         memcpy(&dstart, &(ptr[offset + 4]), sizeof(uint32_t));
 
-        rows = ptr + dstart;
-        pimg = img;
+        if (with_mask)
+          {
+             mask.w = w;
+             mask.h = h;
+             mask.stride = (w + 7) / 8;
+             memset(mask.bits, 0, mask.stride * mask.h);
+          }
 
+        /* RLE decoding happens once per frame, whatever the amount of
+         * requested players. The mask and the bounding box of the opaque
+         * pixels are built from the RLE runs along the way. */
+        x0 = w; x1 = -1;
+        y0 = h; y1 = -1;
+        rows = ptr + dstart;
         for (l = 0; l < h; ++l)
           {
              memcpy(&oline, rows + (l * sizeof(uint16_t)), sizeof(uint16_t));
-             o = rows + oline;
+             if (_sprites_row_walk(rows + oline, w, flip_x,
+                                   (no_pixels) ? NULL : &(img[l * w]),
+                                   (with_mask) ? &(mask.bits[l * mask.stride]) : NULL,
+                                   &first, &last))
+               {
+                  if (first < x0) x0 = first;
+                  if (last > x1) x1 = last;
+                  if ((int)l < y0) y0 = l;
+                  y1 = l;
+               }
+          }
+        if (y1 < 0) /* Fully transparent frame */
+          {
+             ud->bbox_x = ud->bbox_y = 0;
+             ud->bbox_w = ud->bbox_h = 0;
+          }
+        else
+          {
+             ud->bbox_x = x0;
+             ud->bbox_y = y0;
+             ud->bbox_w = x1 - x0 + 1;
+             ud->bbox_h = y1 - y0 + 1;
+          }
+
+        /* A mirrored frame is mirrored within the bounding box of the
+         * whole sprite set, so its origin moves to the other side */
+        fx = (flip_x) ? (int)max_w - (int)x - (int)w : (int)x;
 
-             for (pcount = 0; pcount < w;)
+        if (trim)
+          {
+             /* Rows are moved towards the beginning of the buffer,
+              * so they can be compacted in place */
+             if (!no_pixels)
                {
-                  c = *(o++);
-                  /* NOTE:
-                   * The order of bits examination is important and
-                   * not specified in the documentation!
-                   */
-                  if (c & RLE_LEAVE)
-                    {
-                       /* Leave (c \ RLE_LEAVE) pixels transparent */
-                       c &= 0x7f;
-                       memset(&(pimg[pcount]), 0, c);
-                       pcount += c;
-                    }
-                  else if (c & RLE_REPEAT)
-                    {
-                       /* Repeat the next byte (c \ RLE_REPEAT) times as pixel value */
-                       c &= 0x3f;
-                       memset(&(pimg[pcount]), *(o++), c);
-                       pcount += c;
-                    }
-                  else
-                    {
-                       /* Take the next (c) bytes as pixel values */
-                       memcpy(&(pimg[pcount]), o, c);
-                       pcount += c;
-                       o += c;
-                    }
+                  for (l = 0; l < ud->bbox_h; ++l)
+                    memmove(&(img[l * ud->bbox_w]),
+                            &(img[(ud->bbox_y + l) * w + ud->bbox_x]),
+                            ud->bbox_w);
                }
-             pimg += pcount;
+             if (with_mask)
+               _sprites_mask_crop(&mask, &trimmed, ud->bbox_x, ud->bbox_y,
+                                  ud->bbox_w, ud->bbox_h);
+             fx += ud->bbox_x;
+             out_w = ud->bbox_w;
+             out_h = ud->bbox_h;
+          }
+        else
+          {
+             out_w = w;
+             out_h = h;
           }
+        if (with_mask) ud->mask = (trim) ? &trimmed : &mask;
+        if ((indexed) && (!no_pixels)) ud->indexes = img;
 
-        size = w * h;
-        for (k = 0; k < size; ++k)
-          img_rgba[k] = palette[img[k]];
+        size = out_w * out_h;
+        for (p = 0; p < players_count; ++p)
+          {
+             /* Indexes are the same for all the players: only their
+              * palette changes */
+             if (img_rgba)
+               {
+                  for (k = 0; k < size; ++k)
+                    img_rgba[k] = palettes[p][img[k]];
+               }
 
-        _sprites_colorize(img_rgba, size, ud->color);
-        func(func_data, img_rgba, x, y, w, h, ud, i);
+             ud->color = players[p];
+             ud->palette = palettes[p];
+             func(func_data, img_rgba, fx, (trim) ? y + ud->bbox_y : y,
+                  out_w, out_h, ud, i);
+          }
      }
 
+   ud->mask = NULL;
+   ud->indexes = NULL;
+   ud->palette = NULL;
+   free(trimmed.bits);
+   free(mask.bits);
    free(img_rgba);
    free(img);
-   free(ptr);
+   war2_entry_release(&e);
+   free(palettes);
 
    return PUD_TRUE;
 }
 
+PUDAPI Pud_Bool
+war2_sprites_decode_entry_full(War2_Data                  *w2,
+                               Pud_Player                  player_color,
+                               unsigned int                entry,
+                               War2_Sprites_Decode_Flags   flags,
+                               War2_Sprites_Decode_Func    func,
+                               void                       *data)
+{
+   War2_Sprites_Descriptor ud;
+
+   memset(&ud, 0, sizeof(ud));
+   ud.color = player_color;
+   ud.object = entry;
+   ud.era = PUD_ERA_FOREST;
+   ud.flags = flags;
+
+   return _sprites_entry_parse(w2, &ud, entry, PLAYER_BIT(player_color),
+                               func, data);
+}
+
 PUDAPI Pud_Bool
 war2_sprites_decode_entry(War2_Data                *w2,
                           Pud_Player                player_color,
                           unsigned int              entry,
                           War2_Sprites_Decode_Func  func,
                           void                     *data)
+{
+   return war2_sprites_decode_entry_full(w2, player_color, entry,
+                                         WAR2_SPRITES_DECODE_NONE,
+                                         func, data);
+}
+
+static Pud_Bool
+_sprites_decode(War2_Data                  *w2,
+                unsigned int                player_mask,
+                Pud_Era                     era,
+                unsigned int                object,
+                War2_Sprites_Decode_Flags   flags,
+                War2_Sprites_Decode_Func    func,
+                void                       *data)
 {
    War2_Sprites_Descriptor ud;
+   unsigned int entry;
+   War2_Sprites type;
+   Pud_Side side;
 
-   ud.color = player_color;
-   ud.object = entry;
-   ud.era = PUD_ERA_FOREST;
+   if (!war2_sprites_entry_for(object, era, &entry, &type, &side))
+     DIE_RETURN(PUD_FALSE, "Invalid object [%u]", object);
+   WAR2_VERBOSE(w2, 1, "Decoding entry [%i] for object [%u] (%s,%s)",
+                entry, object,
+                (type == WAR2_SPRITES_ICONS) ? "<ICON>" : pud_unit_to_string(object, PUD_FALSE),
+                pud_era_to_string(era));
+
+   ud.era = era;
+   ud.color = PUD_PLAYER_RED;
+   ud.object = object;
+   ud.sprite_type = type;
+   ud.side = side;
+   ud.flags = flags;
 
-   return _sprites_entry_parse(w2, &ud, entry, func, data);
+   return _sprites_entry_parse(w2, &ud, entry, player_mask, func, data);
+}
+
+PUDAPI Pud_Bool
+war2_sprites_entry_for(unsigned int   object,
+                       Pud_Era        era,
+                       unsigned int  *entry,
+                       War2_Sprites  *type,
+                       Pud_Side      *side)
+{
+   const Object_Entries *obj;
+
+   if ((unsigned int)era >= 4) return PUD_FALSE;
+
+   if (object == WAR2_SPRITES_ICONS) obj = &_icons;
+   else if (object < ARRAY_SIZE(_objects)) obj = &(_objects[object]);
+   else return PUD_FALSE;
+
+   if (obj->entries[era] == 0) return PUD_FALSE;
+
+   if (entry) *entry = obj->entries[era];
+   if (type) *type = obj->type;
+   if (side) *side = obj->side;
+
+   return PUD_TRUE;
+}
+
+PUDAPI Pud_Bool
+war2_sprites_decode_full(War2_Data                  *w2,
+                         Pud_Player                  player_color,
+                         Pud_Era                     era,
+                         unsigned int                object,
+                         War2_Sprites_Decode_Flags   flags,
+                         War2_Sprites_Decode_Func    func,
+                         void                       *data)
+{
+   return _sprites_decode(w2, PLAYER_BIT(player_color), era, object,
+                          flags, func, data);
+}
+
+PUDAPI Pud_Bool
+war2_sprites_decode_multi(War2_Data                *w2,
+                          Pud_Era                   era,
+                          unsigned int              object,
+                          unsigned int              player_mask,
+                          War2_Sprites_Decode_Func  func,
+                          void                     *data)
+{
+   return _sprites_decode(w2, player_mask, era, object,
+                          WAR2_SPRITES_DECODE_NONE, func, data);
 }
 
 PUDAPI Pud_Bool
@@ -232,195 +660,66 @@ war2_sprites_decode(War2_Data                *w2,
                     War2_Sprites_Decode_Func  func,
                     void                     *data)
 {
-   War2_Sprites_Descriptor ud;
-   unsigned int entry = 0;
-   War2_Sprites type;
-   Pud_Side side = PUD_SIDE_NEUTRAL;
+   return war2_sprites_decode_full(w2, player_color, era, object,
+                                   WAR2_SPRITES_DECODE_NONE, func, data);
+}
 
-   if (object == WAR2_SPRITES_ICONS)
-     type = WAR2_SPRITES_ICONS;
-   else
-     {
-        switch (object)
-          {
-#define ORC_UNIT(val_) entry = val_; type = WAR2_SPRITES_UNITS;  side = PUD_SIDE_ORC
-#define HUMAN_UNIT(val_) entry = val_; type = WAR2_SPRITES_UNITS; side = PUD_SIDE_HUMAN
-#define NEUTRAL_UNIT(val_) entry = val_; type = WAR2_SPRITES_UNITS; side = PUD_SIDE_NEUTRAL
-#define ORC_START(val_) entry = val_; type = WAR2_SPRITES_SYSTEM; side = PUD_SIDE_ORC
-#define HUMAN_START(val_) entry = val_; type = WAR2_SPRITES_SYSTEM; side = PUD_SIDE_HUMAN
-
-#define ORC_UNIT_SWITCH(a_, b_, c_, d_) \
-               { \
-                  switch (era) { \
-                   case PUD_ERA_FOREST:    entry = a_; break; \
-                   case PUD_ERA_WINTER:    entry = b_; break; \
-                   case PUD_ERA_WASTELAND: entry = c_; break; \
-                   case PUD_ERA_SWAMP:     entry = d_; break; \
-                  } \
-                  type = WAR2_SPRITES_UNITS; side = PUD_SIDE_ORC; \
-               }
+PUDAPI Pud_Bool
+war2_sprites_frame_for_direction(War2_Direction  direction,
+                                 unsigned int    step,
+                                 unsigned int   *frame,
+                                 Pud_Bool       *flip_x)
+{
+   /* Sprites only store the 5 directions from north to south (clockwise).
+    * The 3 western directions are the mirrors of the eastern ones */
+   static const unsigned char columns[8] = { 0, 1, 2, 3, 4, 3, 2, 1 };
+   const unsigned int dir = direction;
 
-#define HUMAN_UNIT_SWITCH(a_, b_, c_, d_) \
-               { \
-                  switch (era) { \
-                   case PUD_ERA_FOREST:    entry = a_; break; \
-                   case PUD_ERA_WINTER:    entry = b_; break; \
-                   case PUD_ERA_WASTELAND: entry = c_; break; \
-                   case PUD_ERA_SWAMP:     entry = d_; break; \
-                  } \
-                  type = WAR2_SPRITES_UNITS; side = PUD_SIDE_HUMAN; \
-               }
+   if (dir >= 8)
+     DIE_RETURN(PUD_FALSE, "Invalid direction [%u]", dir);
 
+   if (frame) *frame = (step * 5) + columns[dir];
+   if (flip_x) *flip_x = (dir > WAR2_DIRECTION_SOUTH) ? PUD_TRUE : PUD_FALSE;
 
-#define ORC_BUILDING_SWITCH(a_, b_, c_, d_) \
-               { \
-                  switch (era) { \
-                   case PUD_ERA_FOREST:    entry = a_; break; \
-                   case PUD_ERA_WINTER:    entry = b_; break; \
-                   case PUD_ERA_WASTELAND: entry = c_; break; \
-                   case PUD_ERA_SWAMP:     entry = d_; break; \
-                  } \
-                  type = WAR2_SPRITES_BUILDINGS; side = PUD_SIDE_ORC; \
-               }
-#define HUMAN_BUILDING_SWITCH(a_, b_, c_, d_) \
-               { \
-                  switch (era) { \
-                   case PUD_ERA_FOREST:    entry = a_; break; \
-                   case PUD_ERA_WINTER:    entry = b_; break; \
-                   case PUD_ERA_WASTELAND: entry = c_; break; \
-                   case PUD_ERA_SWAMP:     entry = d_; break; \
-                  } \
-                  type = WAR2_SPRITES_BUILDINGS; side = PUD_SIDE_HUMAN; \
-               }
-#define NEUTRAL_BUILDING_SWITCH(a_, b_, c_, d_) \
-               { \
-                  switch (era) { \
-                   case PUD_ERA_FOREST:    entry = a_; break; \
-                   case PUD_ERA_WINTER:    entry = b_; break; \
-                   case PUD_ERA_WASTELAND: entry = c_; break; \
-                   case PUD_ERA_SWAMP:     entry = d_; break; \
-                  } \
-                  type = WAR2_SPRITES_BUILDINGS; side = PUD_SIDE_NEUTRAL; \
-               }
+   return PUD_TRUE;
+}
 
-             /* Units */
-           case PUD_UNIT_DWARVES               : HUMAN_UNIT(33); break;
-           case PUD_UNIT_GOBLIN_SAPPER         : ORC_UNIT(34); break;
-           case PUD_UNIT_GRYPHON_RIDER         : HUMAN_UNIT(35); break;
-           case PUD_UNIT_DRAGON                : ORC_UNIT(36); break;
-           case PUD_UNIT_EYE_OF_KILROGG        : ORC_UNIT(37); break;
-           case PUD_UNIT_GNOMISH_FLYING_MACHINE: HUMAN_UNIT(38); break;
-           case PUD_UNIT_HUMAN_TRANSPORT       : HUMAN_UNIT(39); break;
-           case PUD_UNIT_ORC_TRANSPORT         : ORC_UNIT(40); break;
-           case PUD_UNIT_BATTLESHIP            : HUMAN_UNIT(41); break;
-           case PUD_UNIT_JUGGERNAUGHT          : ORC_UNIT(42); break;
-           case PUD_UNIT_GNOMISH_SUBMARINE     : HUMAN_UNIT_SWITCH(43, 43, 182, 526); break;
-           case PUD_UNIT_GIANT_TURTLE          : ORC_UNIT_SWITCH(44, 44, 183, 527); break;
-           case PUD_UNIT_FOOTMAN               : HUMAN_UNIT(45); break;
-           case PUD_UNIT_GRUNT                 : ORC_UNIT(46); break;
-           case PUD_UNIT_PEASANT               : HUMAN_UNIT(47); break;
-           case PUD_UNIT_PEON                  : ORC_UNIT(48); break;
-           case PUD_UNIT_BALLISTA              : HUMAN_UNIT(49); break;
-           case PUD_UNIT_CATAPULT              : ORC_UNIT(50); break;
-           case PUD_UNIT_KNIGHT                : HUMAN_UNIT(51); break;
-           case PUD_UNIT_OGRE                  : ORC_UNIT(52); break;
-           case PUD_UNIT_ARCHER                : HUMAN_UNIT(53); break;
-           case PUD_UNIT_AXETHROWER            : ORC_UNIT(54); break;
-           case PUD_UNIT_MAGE                  : HUMAN_UNIT(55); break;
-           case PUD_UNIT_DEATH_KNIGHT          : ORC_UNIT(58); break;
-           case PUD_UNIT_HUMAN_TANKER          : HUMAN_UNIT(59); break;
-           case PUD_UNIT_ORC_TANKER            : ORC_UNIT(60); break;
-           case PUD_UNIT_ELVEN_DESTROYER       : HUMAN_UNIT(61); break;
-           case PUD_UNIT_TROLL_DESTROYER       : ORC_UNIT(62); break;
-           case PUD_UNIT_GOBLIN_ZEPPLIN        : HUMAN_UNIT(63); break;
-           case PUD_UNIT_CRITTER_SHEEP         : NEUTRAL_UNIT(64); break;
-           case PUD_UNIT_CRITTER_PIG           : NEUTRAL_UNIT(65); break;
-           case PUD_UNIT_CRITTER_SEAL          : NEUTRAL_UNIT(66); break;
-           case PUD_UNIT_CRITTER_RED_PIG       : NEUTRAL_UNIT(470); break;
-           case PUD_UNIT_SKELETON              : NEUTRAL_UNIT(69); break;
-           case PUD_UNIT_DAEMON                : NEUTRAL_UNIT(70); break;
-
-                                                 /* Start Locations */
-           case PUD_UNIT_HUMAN_START           : HUMAN_START(164); break;
-           case PUD_UNIT_ORC_START             : ORC_START(165); break;
-
-                                                 /* Buildings */
-           case PUD_UNIT_HUMAN_GUARD_TOWER   :   HUMAN_BUILDING_SWITCH( 80, 169,  80, 507); break;
-           case PUD_UNIT_ORC_GUARD_TOWER     :     ORC_BUILDING_SWITCH( 81, 170,  81, 508); break;
-           case PUD_UNIT_HUMAN_CANNON_TOWER  :   HUMAN_BUILDING_SWITCH( 82, 171,  82, 509); break;
-           case PUD_UNIT_ORC_CANNON_TOWER    :     ORC_BUILDING_SWITCH( 83, 172,  83, 510); break;
-           case PUD_UNIT_MAGE_TOWER          :   HUMAN_BUILDING_SWITCH( 84, 160,  84, 505); break;
-           case PUD_UNIT_TEMPLE_OF_THE_DAMNED:     ORC_BUILDING_SWITCH( 85, 161,  85, 506); break;
-           case PUD_UNIT_KEEP                :   HUMAN_BUILDING_SWITCH( 86, 128,  86, 473); break;
-           case PUD_UNIT_STRONGHOLD          :     ORC_BUILDING_SWITCH( 87, 129,  87, 474); break;
-           case PUD_UNIT_GRYPHON_AVIARY      :   HUMAN_BUILDING_SWITCH( 88, 130,  88, 475); break;
-           case PUD_UNIT_DRAGON_ROOST        :     ORC_BUILDING_SWITCH( 89, 131,  89, 476); break;
-           case PUD_UNIT_GNOMISH_INVENTOR    :   HUMAN_BUILDING_SWITCH( 90, 132,  90, 477); break;
-           case PUD_UNIT_GOBLIN_ALCHEMIST    :     ORC_BUILDING_SWITCH( 91, 133,  91, 478); break;
-           case PUD_UNIT_FARM                :   HUMAN_BUILDING_SWITCH( 92, 134, 173, 479); break;
-           case PUD_UNIT_PIG_FARM            :     ORC_BUILDING_SWITCH( 93, 135, 174, 480); break;
-           case PUD_UNIT_HUMAN_BARRACKS      :   HUMAN_BUILDING_SWITCH( 94, 136,  94, 481); break;
-           case PUD_UNIT_ORC_BARRACKS        :     ORC_BUILDING_SWITCH( 95, 137,  95, 482); break;
-           case PUD_UNIT_CHURCH              :   HUMAN_BUILDING_SWITCH( 96, 138,  96, 483); break;
-           case PUD_UNIT_ALTAR_OF_STORMS     :     ORC_BUILDING_SWITCH( 97, 139,  97, 484); break;
-           case PUD_UNIT_HUMAN_SCOUT_TOWER   :   HUMAN_BUILDING_SWITCH( 98, 140,  98, 485); break;
-           case PUD_UNIT_ORC_SCOUT_TOWER     :     ORC_BUILDING_SWITCH( 99, 141,  99, 486); break;
-           case PUD_UNIT_TOWN_HALL           :   HUMAN_BUILDING_SWITCH(100, 142, 100, 487); break;
-           case PUD_UNIT_GREAT_HALL          :     ORC_BUILDING_SWITCH(101, 143, 101, 488); break;
-           case PUD_UNIT_ELVEN_LUMBER_MILL   :   HUMAN_BUILDING_SWITCH(102, 144, 175, 489); break;
-           case PUD_UNIT_TROLL_LUMBER_MILL   :     ORC_BUILDING_SWITCH(103, 145, 176, 490); break;
-           case PUD_UNIT_STABLES             :   HUMAN_BUILDING_SWITCH(104, 146, 104, 491); break;
-           case PUD_UNIT_OGRE_MOUND          :     ORC_BUILDING_SWITCH(105, 147, 105, 492); break;
-           case PUD_UNIT_HUMAN_BLACKSMITH    :   HUMAN_BUILDING_SWITCH(106, 148, 106, 493); break;
-           case PUD_UNIT_ORC_BLACKSMITH      :     ORC_BUILDING_SWITCH(107, 149, 107, 494); break;
-           case PUD_UNIT_HUMAN_SHIPYARD      :   HUMAN_BUILDING_SWITCH(108, 150, 108, 495); break;
-           case PUD_UNIT_ORC_SHIPYARD        :     ORC_BUILDING_SWITCH(109, 151, 109, 496); break;
-           case PUD_UNIT_HUMAN_FOUNDRY       :   HUMAN_BUILDING_SWITCH(110, 152, 110, 497); break;
-           case PUD_UNIT_ORC_FOUNDRY         :     ORC_BUILDING_SWITCH(111, 153, 111, 498); break;
-           case PUD_UNIT_HUMAN_REFINERY      :   HUMAN_BUILDING_SWITCH(112, 154, 112, 499); break;
-           case PUD_UNIT_ORC_REFINERY        :     ORC_BUILDING_SWITCH(113, 155, 113, 500); break;
-           case PUD_UNIT_HUMAN_OIL_WELL      :   HUMAN_BUILDING_SWITCH(114, 156, 177, 501); break;
-           case PUD_UNIT_ORC_OIL_WELL        :     ORC_BUILDING_SWITCH(115, 157, 178, 502); break;
-           case PUD_UNIT_CASTLE              :   HUMAN_BUILDING_SWITCH(116, 158, 116, 503); break;
-           case PUD_UNIT_FORTRESS            :     ORC_BUILDING_SWITCH(117, 159, 117, 504); break;
-           case PUD_UNIT_OIL_PATCH           : NEUTRAL_BUILDING_SWITCH(118, 118, 180, 515); break;
-           case PUD_UNIT_GOLD_MINE           : NEUTRAL_BUILDING_SWITCH(119, 162, 179, 511); break;
-           case PUD_UNIT_DARK_PORTAL         : NEUTRAL_BUILDING_SWITCH(167, 184, 185, 513); break;
-           case PUD_UNIT_RUNESTONE           : NEUTRAL_BUILDING_SWITCH(181, 186, 181, 514); break;
-           case PUD_UNIT_CIRCLE_OF_POWER     : NEUTRAL_BUILDING_SWITCH(166, 166, 166, 525); break;
-
-           default:
-             DIE_RETURN(PUD_FALSE, "Unhandled object 0x%x", object);
-          }
-     }
+PUDAPI void
+war2_sprites_blit(Pud_Color       *dst,
+                  unsigned int     dst_w,
+                  unsigned int     dst_h,
+                  int              x,
+                  int              y,
+                  const Pud_Color *sprite,
+                  unsigned int     w,
+                  unsigned int     h,
+                  Pud_Bool         flip_x)
+{
+   int i, j, i_start, i_end, j_start, j_end, sx;
+   const Pud_Color *src;
+   Pud_Color *d;
+
+   if ((!dst) || (!sprite)) return;
+
+   /* Clip the sprite against the destination */
+   i_start = (x < 0) ? -x : 0;
+   j_start = (y < 0) ? -y : 0;
+   i_end = ((long)x + (long)w > (long)dst_w) ? (int)dst_w - x : (int)w;
+   j_end = ((long)y + (long)h > (long)dst_h) ? (int)dst_h - y : (int)h;
 
-   /* Set entry for palette conversion */
-   if (type == WAR2_SPRITES_ICONS)
+   for (j = j_start; j < j_end; ++j)
      {
-        switch (era)
+        src = &(sprite[j * w]);
+        /* x may be negative: point to the first visible pixel */
+        d = &(dst[(size_t)(y + j) * dst_w + (x + i_start)]);
+        for (i = i_start; i < i_end; ++i)
           {
-           case PUD_ERA_FOREST:    entry = 356; break;
-           case PUD_ERA_WINTER:    entry = 357; break;
-           case PUD_ERA_WASTELAND: entry = 358; break;
-           case PUD_ERA_SWAMP:     entry = 471; break;
+             sx = (flip_x) ? (int)w - 1 - i : i;
+             /* Only fully transparent pixels are skipped */
+             if (src[sx].a != 0x00)
+               d[i - i_start] = src[sx];
           }
      }
-
-   /* Check object is valid (assigned entry) */
-   if (entry == 0)
-     DIE_RETURN(PUD_FALSE, "Invalid object [%u]", object);
-   WAR2_VERBOSE(w2, 1, "Decoding entry [%i] for object [%u] (%s,%s)",
-                entry, object,
-                (type == WAR2_SPRITES_ICONS) ? "<ICON>" : pud_unit_to_string(object, PUD_FALSE),
-                pud_era_to_string(era));
-
-   ud.era = era;
-   ud.color = player_color;
-   ud.object = object;
-   ud.sprite_type = type;
-   ud.side = side;
-
-   return _sprites_entry_parse(w2, &ud, entry, func, data);
 }
 
 PUDAPI void
@@ -441,7 +740,9 @@ war2_sprites_color_convert(Pud_Player     from,
    };
    const Col *ptr;
 
-   if (from == to)
+   if ((from == to) ||
+       ((unsigned int)from >= ARRAY_SIZE(_colors)) ||
+       ((unsigned int)to >= ARRAY_SIZE(_colors)))
      goto no_conversion;
 
    for (i = 0; i < 4; ++i)
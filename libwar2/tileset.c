@@ -22,200 +22,528 @@
 
 #include "war2_private.h"
 
+/* Entries of the tilesets, indexed by Pud_Era.
+ * Last 3 entries are unknown (cf. doc) */
+static const unsigned int _entries[4][3] =
+{
+   { 3, 4, 5/*, 6, 7, 8*/ }, /* Forest */
+   { 19, 20, 21/*, 22, 23, 24*/ }, /* Winter */
+   { 11, 12, 13/*, 14, 15, 16*/ }, /* Wasteland */
+   { 439, 440, 441/*, 442, 443, 444*/ }, /* Swamp */
+};
+
 static void
-_tile_decode(const Pud_Color *palette,
-             War2_Tileset_Descriptor  *ts,
-             War2_Tileset_Decode_Func  func,
-             void                     *func_data,
-             unsigned char            *ptr,
-             unsigned char            *data,
-             unsigned char            *map,
-             uint16_t                  tile)
-{
-   /* Lookup table (flip table): 0=>7, 1=>6, 2=>5, ... 7=>0
-    * Thanks wargus for the tip. */
-   const int ft[8] = { 7, 6, 5, 4, 3, 2, 1, 0 };
-   Pud_Color img[1024];
-   int j, i_img, off, offset, o, x, y;
-   Pud_Bool flip_x, flip_y;
-   unsigned char col;
-   const Pud_Color black = { 0, 0, 0, 0xff };
+_minitile_flip(unsigned char       *dst,
+               const unsigned char *src,
+               Pud_Bool             flip_x,
+               Pud_Bool             flip_y)
+{
+   unsigned int x, y, sx, sy;
 
-   off = ((tile >> 4) * 42) + ((tile & 0xf) * 2);
+   for (y = 0; y < 8; ++y)
+     {
+        sy = (flip_y) ? 7 - y : y;
+        for (x = 0; x < 8; ++x)
+          {
+             sx = (flip_x) ? 7 - x : x;
+             dst[y * 8 + x] = src[sy * 8 + sx];
+          }
+     }
+}
+
+static Pud_Bool
+_ts_variants_build(War2_Tileset *ts)
+{
+   const unsigned int refs_count = ts->graphics_count * 16;
+   const unsigned int count = ts->minitiles_count;
+   const War2_Minitile_Ref *ref;
+   uint32_t *lookup;
+   unsigned int i, key, flips;
+
+   /* A minitile may be referenced with any of the 3 flips. Each
+    * (flips, minitile) that is actually used gets one variant, stored at
+    * lookup[(flips - 1) * count + minitile] - 1 */
+   lookup = calloc(3 * count + 1, sizeof(uint32_t));
+   if (!lookup) DIE_RETURN(PUD_FALSE, "Failed to allocate memory");
+
+   for (i = 0; i < refs_count; ++i)
+     {
+        ref = &(ts->refs[i]);
+        flips = (ref->flip_x << 1) | ref->flip_y;
+        if (flips == 0) continue;
+        key = (flips - 1) * count + ref->minitile;
+        if (lookup[key] == 0) lookup[key] = ++ts->flipped_count;
+     }
+
+   ts->flipped = malloc(ts->flipped_count * 64 + 1);
+   ts->pixels = malloc(refs_count * sizeof(*ts->pixels) + 1);
+   if ((!ts->flipped) || (!ts->pixels))
+     {
+        free(lookup);
+        DIE_RETURN(PUD_FALSE, "Failed to allocate memory");
+     }
 
-   offset = 0;
-   memcpy(&offset, &(map[off]), sizeof(uint16_t));
-   offset *= 32;
-   if (offset == 0) return;
+   for (key = 0; key < 3 * count; ++key)
+     {
+        if (lookup[key] == 0) continue;
+        flips = key / count + 1;
+        _minitile_flip(&(ts->flipped[(lookup[key] - 1) * 64]),
+                       &(ts->minitiles[(key % count) * 64]),
+                       flips & 2, flips & 1);
+     }
 
-   /* For each word in the block of 16 */
-   for (j = 0, i_img = 0; j < 32; j += 2, i_img++)
+   /* Unflipped references directly use the minitiles bank */
+   for (i = 0; i < refs_count; ++i)
      {
-        /* Get offset and flips */
-        o = 0;
-        memcpy(&o, &(ptr[offset + j]), sizeof(uint16_t));
-        flip_x = o & 2; // 0b10
-        flip_y = o & 1; // 0b01
-        o = (o & 0xfffc) * 16;
-
-        /* Decode a minitile (8x8) */
-        for (y = 0; y < 8; y++)
+        ref = &(ts->refs[i]);
+        flips = (ref->flip_x << 1) | ref->flip_y;
+        if (flips == 0)
+          ts->pixels[i] = &(ts->minitiles[ref->minitile * 64]);
+        else
           {
-             for (x = 0; x < 8; x++)
-               {
-                  /* If flip_x/flip_y are PUD_TRUE, the minitile must be flipped on
-                   * its x/y axis. We use a flip table which avoids calculations
-                   * to do so. */
-                  col = data[o + ((flip_x ? ft[x] : x) + (flip_y ? ft[y] : y) * 8)];
-
-                  /* Maths: we have 16 blocks of 8x8 to place in a 32x32
-                   * image which has a linear memory layout */
-                  const int xblock = x + ((i_img % 4) * 8);
-                  const int yblock = y + ((i_img / 4) * 8);
-
-                  /* Convert the byte to color thanks to the palette */
-                  img[xblock + 32 * yblock] = palette[col];
-               }
+             key = (flips - 1) * count + ref->minitile;
+             ts->pixels[i] = &(ts->flipped[(lookup[key] - 1) * 64]);
           }
      }
-   if (memcmp(&(img[0]), &black, 3))
-     func(func_data, img, 32, 32, ts, tile);
+
+   free(lookup);
+   return PUD_TRUE;
+}
+
+static void
+_tile_assemble(const War2_Tileset *ts,
+               uint16_t            graphic,
+               unsigned char      *out)
+{
+   const unsigned char *const *pixels = &(ts->pixels[graphic * 16]);
+   unsigned int mx, my, y;
+
+   /* Maths: we have 16 blocks of 8x8 to place in a 32x32 image which has
+    * a linear memory layout. Flips are already applied, so each row of
+    * a minitile is a plain 8 bytes copy */
+   for (my = 0; my < 4; ++my)
+     for (y = 0; y < 8; ++y)
+       for (mx = 0; mx < 4; ++mx)
+         memcpy(&(out[(my * 8 + y) * 32 + mx * 8]),
+                &(pixels[my * 4 + mx][y * 8]), 8);
+}
+
+static inline void
+_palette_expand(const Pud_Color     *palette,
+                const unsigned char *indexes,
+                Pud_Color           *out,
+                unsigned int         count)
+{
+   unsigned int i;
+
+   for (i = 0; i < count; ++i)
+     out[i] = palette[indexes[i]];
 }
 
 static Pud_Bool
-_ts_entries_parse(War2_Data                *w2,
-                  War2_Tileset_Descriptor  *ts,
-                  const unsigned int       *entries,
-                  War2_Tileset_Decode_Func  func,
-                  void                     *func_data)
-{
-   unsigned char *ptr, *data, *map;
-   size_t size, map_size;
-   int tile;
-   int i, j, k;
-   const Pud_Color *const palette = war2_palette_get(w2, ts->era);
+_tile_decode(const War2_Tileset *ts,
+             uint16_t            tile,
+             Pud_Color          *img)
+{
+   const Pud_Color black = { 0, 0, 0, 0xff };
+   unsigned char indexes[1024];
+
+   /* Tiles without graphic, or starting with a black pixel, are skipped */
+   if (!war2_tile_decode(ts, tile, NULL, indexes)) return PUD_FALSE;
+   if (!memcmp(&(ts->palette[indexes[0]]), &black, 3)) return PUD_FALSE;
+
+   _palette_expand(ts->palette, indexes, img, 1024);
+   return PUD_TRUE;
+}
+
+/* Order in which tiles are decoded: solid tiles, then boundaries */
+#define TILES_ORDER_COUNT ((0xc * 0x10) + (0x9 * 0xe * 0x10))
+
+static void
+_tiles_order(uint16_t *tiles)
+{
+   unsigned int i, j, k, n = 0;
+
+   for (j = 0x1; j <= 0xc; j++)
+     for (i = 0; i <= 0xf; i++)
+       tiles[n++] = (j * 0x10) + i;
+
+   for (j = 0x1; j <= 0x9; j++)
+     for (i = 0x0; i <= 0xd; i++)
+       for (k = 0x0; k <= 0xf; k++)
+         tiles[n++] = (j * 0x100) + (i * 0x10) + k;
+}
+
+/* Tiles decoded by a job */
+#define PARALLEL_CHUNK 16
+/* Jobs per worker between two ordered deliveries */
+#define PARALLEL_BATCH 4
+
+typedef struct
+{
+   War2_Tileset            *ts;
+   War2_Tileset_Descriptor  desc;
+} Parallel_Era;
+
+typedef struct
+{
+   War2_Data                *w2;
+   War2_Tileset_Decode_Func  func;
+   void                     *func_data;
+
+   Parallel_Era              eras[4];
+   unsigned int              eras_count;
+   uint16_t                  order[TILES_ORDER_COUNT];
+
+   /* Tiles being decoded: items are indexes in eras x order */
+   unsigned int              first;
+   unsigned int              items;
+
+   /* For ordered delivery, one slot per item of the batch */
+   Pud_Color                *slots;
+   Pud_Bool                 *decoded;
+} Parallel;
+
+static void
+_parallel_open_job(void         *data,
+                   unsigned int  job)
+{
+   Parallel *const p = data;
+   Parallel_Era *const era = &(p->eras[job]);
+
+   era->ts = war2_tileset_open(p->w2, era->desc.era);
+}
+
+static void
+_parallel_decode_job(void         *data,
+                     unsigned int  job)
+{
+   Parallel *const p = data;
+   const Parallel_Era *era;
+   Pud_Color local[1024];
+   Pud_Color *img;
+   unsigned int i, start, end;
+   uint16_t tile;
+   Pud_Bool ok;
+
+   start = job * PARALLEL_CHUNK;
+   end = start + PARALLEL_CHUNK;
+   if (end > p->items) end = p->items;
+
+   for (i = start; i < end; ++i)
+     {
+        era = &(p->eras[(p->first + i) / TILES_ORDER_COUNT]);
+        tile = p->order[(p->first + i) % TILES_ORDER_COUNT];
+        img = (p->slots) ? &(p->slots[i * 1024]) : local;
+
+        ok = _tile_decode(era->ts, tile, img);
+        if (p->slots)
+          p->decoded[i] = ok;
+        else if (ok)
+          p->func(p->func_data, img, 32, 32, &(era->desc), tile);
+     }
+}
+
+PUDAPI_INTERNAL const unsigned int *
+war2_tileset_entries_get(Pud_Era era)
+{
+   if ((unsigned int)era >= ARRAY_SIZE(_entries)) return NULL;
+   return _entries[era];
+}
+
+PUDAPI unsigned int
+war2_tileset_decode(War2_Data                *w2,
+                    Pud_Era                   era,
+                    War2_Tileset_Decode_Func  func,
+                    void                     *data)
+{
+   War2_Tileset *ts;
+   War2_Tileset_Descriptor desc;
+   uint16_t order[TILES_ORDER_COUNT];
+   Pud_Color img[1024];
+   unsigned int i;
+
+   if (!war2_tileset_entries_get(era)) DIE_RETURN(0, "Invalid era [%i]", era);
 
    /* If no callback has been specified, do nothing */
    if (!func)
      {
         WAR2_VERBOSE(w2, 1, "Warning: No callback specified.");
-        return PUD_TRUE;
+        return 0;
      }
 
-   /* Get minitiles info */
-   ptr = war2_entry_extract(w2, entries[0], &size);
-   if (!ptr)
-     DIE_RETURN(PUD_FALSE, "Failed to extract entry minitile info [%i]", entries[0]);
-   data = war2_entry_extract(w2, entries[1], NULL);
-   if (!data)
+   ts = war2_tileset_open(w2, era);
+   if (!ts) return 0;
+
+   desc.era = era;
+   desc.tiles = ts->graphics_count;
+
+   _tiles_order(order);
+   for (i = 0; i < TILES_ORDER_COUNT; i++)
+     {
+        if (_tile_decode(ts, order[i], img))
+          func(data, img, 32, 32, &desc, order[i]);
+     }
+
+   war2_tileset_close(ts);
+
+   return desc.tiles;
+}
+
+PUDAPI unsigned int
+war2_tileset_decode_parallel(War2_Data                *w2,
+                             unsigned int              era_mask,
+                             unsigned int              nthreads,
+                             Pud_Bool                  ordered,
+                             War2_Tileset_Decode_Func  func,
+                             void                     *data)
+{
+   Parallel *p;
+   const Parallel_Era *era;
+   unsigned int e, i, total, batch, tiles = 0;
+
+   if ((era_mask == 0) || (era_mask & ~WAR2_ERA_MASK_ALL))
+     DIE_RETURN(0, "Invalid era mask [0x%x]", era_mask);
+
+   /* If no callback has been specified, do nothing */
+   if (!func)
      {
-        free(ptr);
-        DIE_RETURN(PUD_FALSE, "Failed to extract entry minitile data [%i]", entries[1]);
+        WAR2_VERBOSE(w2, 1, "Warning: No callback specified.");
+        return 0;
      }
-   map = war2_entry_extract(w2, entries[2], &map_size);
-   if (!map)
+
+   p = calloc(1, sizeof(Parallel));
+   if (!p) DIE_RETURN(0, "Failed to allocate memory");
+   p->w2 = w2;
+   p->func = func;
+   p->func_data = data;
+   _tiles_order(p->order);
+   for (e = 0; e < ARRAY_SIZE(p->eras); e++)
      {
-        free(ptr);
-        free(data);
-        DIE_RETURN(PUD_FALSE, "Failed to extract entry map [%i]", entries[2]);
+        if (era_mask & WAR2_ERA_MASK(e))
+          p->eras[p->eras_count++].desc.era = e;
      }
-   ts->tiles = size / 32;
 
-   for (j = 0x1; j <= 0xc; j++)
+   /* Tilesets are loaded in parallel as well */
+   war2_jobs_run(p->eras_count, nthreads, _parallel_open_job, p);
+   for (e = 0; e < p->eras_count; e++)
      {
-        for (i = 0; i <= 0xf; i++)
-          {
-             tile = (j * 0x10) + i;
-             _tile_decode(palette, ts, func, func_data, ptr, data, map, tile);
-          }
+        if (!p->eras[e].ts) goto end;
+        p->eras[e].desc.tiles = p->eras[e].ts->graphics_count;
      }
 
-   for (j = 0x1; j <= 0x9; j++)
+   total = p->eras_count * TILES_ORDER_COUNT;
+   if (!ordered)
      {
-        for (i = 0x0; i <= 0xd; i++)
+        p->first = 0;
+        p->items = total;
+        war2_jobs_run((total + PARALLEL_CHUNK - 1) / PARALLEL_CHUNK,
+                      nthreads, _parallel_decode_job, p);
+     }
+   else
+     {
+        /* Tiles are decoded by batches. Once a batch is done, its tiles
+         * are delivered in order from the calling thread */
+        batch = war2_workers_count(nthreads) * PARALLEL_BATCH * PARALLEL_CHUNK;
+        if (batch > total) batch = total;
+        p->slots = malloc(batch * 1024 * sizeof(Pud_Color));
+        p->decoded = malloc(batch * sizeof(Pud_Bool));
+        if ((!p->slots) || (!p->decoded))
+          DIE_GOTO(end, "Failed to allocate memory");
+
+        for (p->first = 0; p->first < total; p->first += p->items)
           {
-             for (k = 0x0; k <= 0xf; k++)
+             p->items = total - p->first;
+             if (p->items > batch) p->items = batch;
+             war2_jobs_run((p->items + PARALLEL_CHUNK - 1) / PARALLEL_CHUNK,
+                           nthreads, _parallel_decode_job, p);
+
+             for (i = 0; i < p->items; i++)
                {
-                  tile = (j * 0x100) + (i * 0x10) + k;
-                  _tile_decode(palette, ts, func, func_data, ptr, data, map, tile);
+                  if (!p->decoded[i]) continue;
+                  era = &(p->eras[(p->first + i) / TILES_ORDER_COUNT]);
+                  func(data, &(p->slots[i * 1024]), 32, 32, &(era->desc),
+                       p->order[(p->first + i) % TILES_ORDER_COUNT]);
                }
           }
      }
 
+   for (e = 0; e < p->eras_count; e++)
+     tiles += p->eras[e].desc.tiles;
+
+end:
+   for (e = 0; e < p->eras_count; e++)
+     war2_tileset_close(p->eras[e].ts);
+   free(p->decoded);
+   free(p->slots);
+   free(p);
+   return tiles;
+}
+
+PUDAPI War2_Tileset *
+war2_tileset_open(War2_Data *w2,
+                  Pud_Era    era)
+{
+   War2_Tileset *ts;
+   War2_Entry info, minitiles, map;
+   const unsigned int *entries;
+   const Pud_Color *palette;
+   unsigned int g, k, tile, off;
+   uint16_t word;
+
+   entries = war2_tileset_entries_get(era);
+   palette = war2_palette_get(w2, era);
+   if ((!entries) || (!palette)) DIE_RETURN(NULL, "Invalid era [%i]", era);
 
-#if 0
-   // FIXME Fog of war (16 first tiles) */
-   int img_ctr;
-   /* Jump by blocks of 16 words */
-   for (i = 0, img_ctr = 1; i < size; i += 32, img_ctr++)
+   ts = calloc(1, sizeof(War2_Tileset));
+   if (!ts) DIE_RETURN(NULL, "Failed to allocate memory");
+   ts->era = era;
+   memcpy(ts->palette, palette, sizeof(ts->palette));
+
+   if (!war2_entry_get(w2, entries[0], &info))
+     DIE_GOTO(fail, "Failed to extract entry minitile info [%u]", entries[0]);
+   if (!war2_entry_get(w2, entries[1], &minitiles))
+     DIE_GOTO(fail_info, "Failed to extract entry minitile data [%u]", entries[1]);
+   if (!war2_entry_get(w2, entries[2], &map))
+     DIE_GOTO(fail_minitiles, "Failed to extract entry map [%u]", entries[2]);
+
+   /* Minitiles are kept as they are */
+   ts->minitiles_count = minitiles.size / 64;
+   ts->minitiles = malloc(ts->minitiles_count * 64 + 1);
+   if (!ts->minitiles) DIE_GOTO(fail_map, "Failed to allocate memory");
+   memcpy(ts->minitiles, minitiles.data, ts->minitiles_count * 64);
+
+   /* Each graphic is a block of 16 words, one per minitile:
+    * 0b10 is the X flip, 0b01 the Y flip and (word & 0xfffc) * 16 is
+    * the offset of the minitile (64 bytes) in the minitiles data */
+   ts->graphics_count = info.size / 32;
+   ts->refs = malloc(ts->graphics_count * 16 * sizeof(War2_Minitile_Ref) + 1);
+   if (!ts->refs) DIE_GOTO(fail_map, "Failed to allocate memory");
+   for (g = 0; g < ts->graphics_count; ++g)
      {
-        /* For each word in the block of 16 */
-        for (j = 0, i_img = 0; j < 32; j += 2, i_img++)
+        for (k = 0; k < 16; ++k)
           {
-             /* Get offset and flips */
-             o = 0;
-             memcpy(&o, &(ptr[i + j]), sizeof(uint16_t));
-             flip_x = o & 2; // 0b10
-             flip_y = o & 1; // 0b01
-             o = (o & 0xfffc) * 16;
-
-             /* Decode a minitile (8x8) */
-             for (y = 0; y < 8; y++)
-               {
-                  for (x = 0; x < 8; x++)
-                    {
-                       /* If flip_x/flip_y are PUD_TRUE, the minitile must be flipped on
-                        * its x/y axis. We use a flip table which avoids calculations
-                        * to do so. */
-                       col = data[o + ((flip_x ? ft[x] : x) + (flip_y ? ft[y] : y) * 8)];
-
-                       /* Maths: we have 16 blocks of 8x8 to place in a 32x32
-                        * image which has a linear memory layout */
-                       const int xblock = x + ((i_img % 4) * 8);
-                       const int yblock = y + ((i_img / 4) * 8);
-
-                       /* Convert the byte to color thanks to the palette */
-                       img[xblock + 32 * yblock] = ts->palette[col];
-                    }
-               }
+             War2_Minitile_Ref *const ref = &(ts->refs[g * 16 + k]);
+
+             memcpy(&word, &(info.data[g * 32 + k * 2]), sizeof(uint16_t));
+             ref->minitile = word >> 2;
+             ref->flip_x = !!(word & 2);
+             ref->flip_y = !!(word & 1);
+             if (ref->minitile >= ts->minitiles_count)
+               DIE_GOTO(fail_map, "Graphic %u refers to minitile %u (max is %u)",
+                        g, ref->minitile, ts->minitiles_count);
           }
+     }
 
-        func(img, 32, 32, ts, img_ctr);
+   /* The map gives the graphic of each tile */
+   for (tile = 0; tile < WAR2_TILESET_TILES_MAX; ++tile)
+     {
+        off = ((tile >> 4) * 42) + ((tile & 0xf) * 2);
+        if (off + sizeof(uint16_t) > map.size) continue;
+        memcpy(&word, &(map.data[off]), sizeof(uint16_t));
+        if (word < ts->graphics_count)
+          ts->graphics[tile] = word;
      }
-#endif
 
-   free(ptr);
-   free(data);
-   free(map);
+   if (!_ts_variants_build(ts)) goto fail_map;
+
+   war2_entry_release(&map);
+   war2_entry_release(&minitiles);
+   war2_entry_release(&info);
+
+   return ts;
+
+fail_map:
+   war2_entry_release(&map);
+fail_minitiles:
+   war2_entry_release(&minitiles);
+fail_info:
+   war2_entry_release(&info);
+fail:
+   war2_tileset_close(ts);
+   return NULL;
+}
+
+PUDAPI void
+war2_tileset_close(War2_Tileset *ts)
+{
+   if (!ts) return;
+   free(ts->pixels);
+   free(ts->flipped);
+   free(ts->refs);
+   free(ts->minitiles);
+   free(ts);
+}
+
+PUDAPI const Pud_Color *
+war2_tileset_palette_get(const War2_Tileset *ts)
+{
+   return ts->palette;
+}
+
+PUDAPI const unsigned char *
+war2_tileset_minitiles_get(const War2_Tileset *ts,
+                           unsigned int       *count)
+{
+   if (count) *count = ts->minitiles_count;
+   return ts->minitiles;
+}
+
+PUDAPI const War2_Minitile_Ref *
+war2_tileset_tile_refs_get(const War2_Tileset *ts,
+                           uint16_t            tile)
+{
+   if ((tile >= WAR2_TILESET_TILES_MAX) || (ts->graphics[tile] == 0))
+     return NULL;
+   return &(ts->refs[ts->graphics[tile] * 16]);
+}
+
+PUDAPI Pud_Bool
+war2_tile_decode(const War2_Tileset *ts,
+                 uint16_t            tile,
+                 Pud_Color          *out_rgba,
+                 unsigned char      *out_indexed)
+{
+   unsigned char indexes[1024];
+   unsigned char *const buf = (out_indexed) ? out_indexed : indexes;
+
+   if ((!out_rgba) && (!out_indexed))
+     DIE_RETURN(PUD_FALSE, "No output provided for tile 0x%04x", tile);
+   if ((tile >= WAR2_TILESET_TILES_MAX) || (ts->graphics[tile] == 0))
+     return PUD_FALSE;
+
+   _tile_assemble(ts, ts->graphics[tile], buf);
+   if (out_rgba) _palette_expand(ts->palette, buf, out_rgba, 1024);
 
    return PUD_TRUE;
 }
 
-PUDAPI unsigned int
-war2_tileset_decode(War2_Data                *w2,
-                    Pud_Era                   era,
-                    War2_Tileset_Decode_Func  func,
-                    void                     *data)
+PUDAPI Pud_Bool
+war2_tileset_tile_render(const War2_Tileset *ts,
+                         uint16_t            tile,
+                         Pud_Color          *fb,
+                         unsigned int        fb_w,
+                         unsigned int        fb_h,
+                         int                 x,
+                         int                 y)
 {
-   /* Last 3 entries are unknown (cf. doc) */
-   const unsigned int forest[] = { 3, 4, 5/*, 6, 7, 8*/ };
-   const unsigned int wasteland[] = { 11, 12, 13/*, 14, 15, 16*/ };
-   const unsigned int winter[] = { 19, 20, 21/*, 22, 23, 24*/ };
-   const unsigned int swamp[] = { 439, 440, 441/*, 442, 443, 444*/ };
-   const unsigned int *entries;
-   War2_Tileset_Descriptor ts;
+   unsigned char indexes[1024];
+   int py, x0, x1, y0, y1;
 
-   ts.era = era;
+   if ((tile >= WAR2_TILESET_TILES_MAX) || (ts->graphics[tile] == 0))
+     return PUD_FALSE;
 
-   switch (era)
-     {
-      case PUD_ERA_FOREST:    entries = forest;    break;
-      case PUD_ERA_WASTELAND: entries = wasteland; break;
-      case PUD_ERA_WINTER:    entries = winter;    break;
-      case PUD_ERA_SWAMP:     entries = swamp;     break;
-     }
+   /* Clip the tile against the framebuffer */
+   x0 = (x < 0) ? -x : 0;
+   y0 = (y < 0) ? -y : 0;
+   x1 = ((long)x + 32 > (long)fb_w) ? (int)fb_w - x : 32;
+   y1 = ((long)y + 32 > (long)fb_h) ? (int)fb_h - y : 32;
+   if ((x0 >= x1) || (y0 >= y1)) return PUD_TRUE;
 
-   _ts_entries_parse(w2, &ts, entries, func, data);
+   _tile_assemble(ts, ts->graphics[tile], indexes);
+   for (py = y0; py < y1; ++py)
+     _palette_expand(ts->palette, &(indexes[py * 32 + x0]),
+                     &(fb[(size_t)(y + py) * fb_w + x + x0]), x1 - x0);
 
-   return ts.tiles;
+   return PUD_TRUE;
 }
@@ -22,6 +22,39 @@
 
 #include "war2_private.h"
 
+PUDAPI unsigned char *
+war2_ui_decode_indexed(War2_Data *w2,
+                       unsigned int entry,
+                       unsigned int *w,
+                       unsigned int *h)
+{
+   unsigned char *ptr;
+   size_t size;
+   uint16_t width, height;
+   unsigned int img_size;
+
+   ptr = war2_entry_extract(w2, entry, &size);
+   if (! ptr) DIE_RETURN(NULL, "Failed to extract entry");
+
+   memcpy(&width, &ptr[0], sizeof(uint16_t));
+   memcpy(&height, &ptr[2], sizeof(uint16_t));
+
+   img_size = width * height;
+   if (size < img_size + 4)
+     {
+        free(ptr);
+        DIE_RETURN(NULL, "Entry is too small (%zu bytes)", size);
+     }
+
+   /* The indexes follow the 4 bytes of the header: they are moved in
+    * place, so the entry itself is returned */
+   memmove(ptr, ptr + 4, img_size);
+
+   if (w) *w = width;
+   if (h) *h = height;
+   return ptr;
+}
+
 PUDAPI Pud_Color *
 war2_ui_decode(War2_Data *w2,
                unsigned int entry,
@@ -29,18 +62,14 @@ war2_ui_decode(War2_Data *w2,
                unsigned int *h)
 {
    unsigned char *ptr;
-   size_t size;
-   uint16_t width, height;
+   unsigned int width, height;
    unsigned int img_size;
    unsigned int i;
    Pud_Color *img;
    const Pud_Color *const palette = war2_palette_get(w2, PUD_ERA_FOREST);
 
-   ptr = war2_entry_extract(w2, entry, &size);
-   if (! ptr) DIE_RETURN(NULL, "Failed to extract entry");
-
-   memcpy(&width, &ptr[0], sizeof(uint16_t));
-   memcpy(&height, &ptr[2], sizeof(uint16_t));
+   ptr = war2_ui_decode_indexed(w2, entry, &width, &height);
+   if (! ptr) return NULL;
 
    img_size = width * height;
    img = malloc(img_size * sizeof(Pud_Color));
@@ -50,12 +79,9 @@ war2_ui_decode(War2_Data *w2,
         DIE_RETURN(NULL, "Failed to allocate memory");
      }
 
-   ptr += 4;
    for (i = 0; i < img_size; i++)
-     {
-       img[i] = palette[ptr[i]]; 
-     }
-   free(ptr - 4);
+     img[i] = palette[ptr[i]];
+   free(ptr);
 
    if (w) *w = width;
    if (h) *h = height;
@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2017 Jean Guyomarc'h
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "war2_private.h"
+
+/*
+ * Units are shown with one frame of their sprites: facing south for
+ * units, complete for buildings. The box the frames are placed in is
+ * centered on the footprint of the unit.
+ */
+
+typedef struct
+{
+   War2_Unit_Sprites *us;
+   unsigned int       type;
+   unsigned int       frame;
+   int                ox;
+   int                oy;
+} Load;
+
+static void
+_sprite_cb(void                          *data,
+           const Pud_Color               *img,
+           int                            x,
+           int                            y,
+           unsigned int                   w,
+           unsigned int                   h,
+           const War2_Sprites_Descriptor *ud,
+           uint16_t                       img_nb)
+{
+   Load *const load = data;
+   War2_Unit_Sprite *sp;
+
+   if ((img_nb != load->frame) || ((unsigned int)ud->color >= 16)) return;
+   sp = &(load->us->sprites[load->type][ud->color]);
+   if (sp->pixels) return;
+
+   sp->pixels = malloc(w * h * sizeof(Pud_Color) + 1);
+   if (!sp->pixels) DIE_RETURN(VOID, "Failed to allocate memory");
+   memcpy(sp->pixels, img, w * h * sizeof(Pud_Color));
+   sp->x = load->ox + x;
+   sp->y = load->oy + y;
+   sp->w = w;
+   sp->h = h;
+}
+
+static Pud_Bool
+_sprites_load(War2_Data         *w2,
+              War2_Unit_Sprites *us,
+              unsigned int       type,
+              unsigned int       players)
+{
+   unsigned int entry, size;
+   uint16_t box_w, box_h;
+   War2_Entry e;
+   Load load;
+
+   /* Even on failure, they will not be loaded again */
+   us->loaded[type] |= players;
+
+   /* Start locations and the like have no sprites */
+   if (!war2_sprites_entry_for(type, us->era, &entry, NULL, NULL))
+     return PUD_TRUE;
+
+   if (!war2_entry_get(w2, entry, &e))
+     DIE_RETURN(PUD_FALSE, "Failed to extract entry [%u]", entry);
+   if (e.size < 6)
+     {
+        war2_entry_release(&e);
+        DIE_RETURN(PUD_FALSE, "Invalid sprites entry [%u]", entry);
+     }
+   memcpy(&box_w, &(e.data[2]), sizeof(uint16_t));
+   memcpy(&box_h, &(e.data[4]), sizeof(uint16_t));
+   war2_entry_release(&e);
+
+   size = pud_unit_size_get(type);
+   if (size == 0) size = 1;
+   load.us = us;
+   load.type = type;
+   load.ox = (int)(size * 16) - (int)(box_w / 2);
+   load.oy = (int)(size * 16) - (int)(box_h / 2);
+   load.frame = 0;
+   if (!pud_unit_building_is(type))
+     war2_sprites_frame_for_direction(WAR2_DIRECTION_SOUTH, 0,
+                                      &load.frame, NULL);
+
+   if (!war2_sprites_decode_multi(w2, us->era, type, players,
+                                  _sprite_cb, &load))
+     DIE_RETURN(PUD_FALSE, "Failed to decode sprites of unit %u", type);
+
+   return PUD_TRUE;
+}
+
+PUDAPI_INTERNAL void
+war2_unit_sprites_init(War2_Unit_Sprites *us,
+                       Pud_Era            era)
+{
+   memset(us, 0, sizeof(*us));
+   us->era = era;
+}
+
+PUDAPI_INTERNAL void
+war2_unit_sprites_clear(War2_Unit_Sprites *us)
+{
+   unsigned int i, j;
+
+   for (i = 0; i < PUD_UNIT_NONE; ++i)
+     for (j = 0; j < 16; ++j)
+       free(us->sprites[i][j].pixels);
+   war2_unit_sprites_init(us, us->era);
+}
+
+PUDAPI_INTERNAL Pud_Bool
+war2_unit_sprites_load(War2_Data         *w2,
+                       War2_Unit_Sprites *us,
+                       const Pud         *pud)
+{
+   unsigned int players[PUD_UNIT_NONE] = { 0 };
+   unsigned int i, type;
+
+   /* Sprites of all the players of a type are decoded at once */
+   for (i = 0; i < pud->units_count; ++i)
+     {
+        type = pud->units[i].type;
+        if ((type < PUD_UNIT_NONE) && (pud->units[i].player < 16))
+          players[type] |= 1u << pud->units[i].player;
+     }
+
+   for (type = 0; type < PUD_UNIT_NONE; ++type)
+     {
+        players[type] &= ~(unsigned int)us->loaded[type];
+        if ((players[type]) && (!_sprites_load(w2, us, type, players[type])))
+          return PUD_FALSE;
+     }
+
+   return PUD_TRUE;
+}
+
+PUDAPI_INTERNAL const War2_Unit_Sprite *
+war2_unit_sprite_get(War2_Data         *w2,
+                     War2_Unit_Sprites *us,
+                     unsigned int       type,
+                     unsigned int       player)
+{
+   if ((type >= PUD_UNIT_NONE) || (player >= 16)) return NULL;
+   if ((w2) && (!(us->loaded[type] & (1u << player))))
+     _sprites_load(w2, us, type, 1u << player);
+   return (us->sprites[type][player].pixels) ? &(us->sprites[type][player]) : NULL;
+}
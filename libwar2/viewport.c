@@ -0,0 +1,410 @@
+/*
+ * Copyright (c) 2017 Jean Guyomarc'h
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "war2_private.h"
+
+/*
+ * Cells of the map are marked dirty when they are modified (through the
+ * change callbacks of libpud) or exposed by a scroll. Rendering only
+ * redraws the visible dirty cells: the tile, then the parts of the units
+ * that overlap the cell. The sprites that overlap the dirty cells are
+ * collected once per render, so cells do not walk all the units.
+ */
+
+typedef struct
+{
+   const War2_Unit_Sprite *sp;
+   /* Top-left corner of the sprite within the map, in pixels */
+   int                     x;
+   int                     y;
+} Sprite_Draw;
+
+struct _War2_Viewport
+{
+   War2_Data         *w2;
+   Pud               *pud;
+   War2_Tileset      *ts;
+   War2_Unit_Sprites  sprites;
+
+   Pud_Color         *fb;
+   unsigned int       w;
+   unsigned int       h;
+
+   /* Position of the viewport within the map, in pixels */
+   int                x;
+   int                y;
+
+   /* One per cell of the map */
+   unsigned char     *dirty;
+
+   /* Sprites to be drawn by the current render, flying units last */
+   Sprite_Draw       *draws;
+   unsigned int       draws_count;
+   unsigned int       draws_alloc;
+};
+
+static void
+_area_invalidate(War2_Viewport *vp,
+                 int            px,
+                 int            py,
+                 int            pw,
+                 int            ph)
+{
+   const Pud *const pud = vp->pud;
+   int cx, cy, cx0, cy0, cx1, cy1;
+
+   /* Pixels of the map to cells */
+   if ((pw <= 0) || (ph <= 0)) return;
+   cx0 = (px < 0) ? 0 : px / 32;
+   cy0 = (py < 0) ? 0 : py / 32;
+   cx1 = (px + pw + 31) / 32;
+   cy1 = (py + ph + 31) / 32;
+   if (cx1 > (int)pud->map_w) cx1 = pud->map_w;
+   if (cy1 > (int)pud->map_h) cy1 = pud->map_h;
+
+   for (cy = cy0; cy < cy1; ++cy)
+     for (cx = cx0; cx < cx1; ++cx)
+       vp->dirty[cy * pud->map_w + cx] = 1;
+}
+
+static void
+_unit_invalidate(War2_Viewport       *vp,
+                 const Pud_Unit_Info *u)
+{
+   const War2_Unit_Sprite *sp;
+   const unsigned int size = pud_unit_size_get(u->type);
+
+   war2_viewport_invalidate(vp, u->x, u->y, (size) ? size : 1, (size) ? size : 1);
+
+   /* Sprites often overflow the footprint of their unit */
+   sp = war2_unit_sprite_get(vp->w2, &(vp->sprites), u->type, u->player);
+   if (sp)
+     _area_invalidate(vp, (int)(u->x * 32) + sp->x, (int)(u->y * 32) + sp->y,
+                      sp->w, sp->h);
+}
+
+static void
+_change_cb(void             *data,
+           Pud              *pud,
+           const Pud_Change *change)
+{
+   War2_Viewport *const vp = data;
+   Pud_Unit_Info from;
+
+   (void) pud;
+
+   switch (change->type)
+     {
+      case PUD_CHANGE_TILE:
+         war2_viewport_invalidate(vp, change->x, change->y, change->w, change->h);
+         break;
+
+      case PUD_CHANGE_UNIT_ADD:
+      case PUD_CHANGE_UNIT_DEL:
+         _unit_invalidate(vp, change->info);
+         break;
+
+      case PUD_CHANGE_UNIT_MOVE:
+         /* The sprite disappears from where it was */
+         from = *(change->info);
+         from.x = change->from_x;
+         from.y = change->from_y;
+         _unit_invalidate(vp, &from);
+         _unit_invalidate(vp, change->info);
+         break;
+     }
+}
+
+static void
+_cell_render(War2_Viewport *vp,
+             unsigned int   cx,
+             unsigned int   cy)
+{
+   const Pud *const pud = vp->pud;
+   const Sprite_Draw *d;
+   Pud_Color cell[32 * 32];
+   unsigned int i;
+   int px, py, ox, oy, x0, x1, y0, y1;
+
+   memset(cell, 0, sizeof(cell));
+   war2_tileset_tile_render(vp->ts, pud->tiles_map[cy * pud->map_w + cx],
+                            cell, 32, 32, 0, 0);
+
+   for (i = 0; i < vp->draws_count; ++i)
+     {
+        d = &(vp->draws[i]);
+        px = d->x - (int)(cx * 32);
+        py = d->y - (int)(cy * 32);
+        if ((px >= 32) || (py >= 32) ||
+            (px + (int)d->sp->w <= 0) || (py + (int)d->sp->h <= 0))
+          continue;
+        war2_sprites_blit(cell, 32, 32, px, py, d->sp->pixels,
+                          d->sp->w, d->sp->h, PUD_FALSE);
+     }
+
+   /* Copy the visible part of the cell */
+   ox = (int)(cx * 32) - vp->x;
+   oy = (int)(cy * 32) - vp->y;
+   x0 = (ox < 0) ? -ox : 0;
+   y0 = (oy < 0) ? -oy : 0;
+   x1 = (ox + 32 > (int)vp->w) ? (int)vp->w - ox : 32;
+   y1 = (oy + 32 > (int)vp->h) ? (int)vp->h - oy : 32;
+   for (py = y0; py < y1; ++py)
+     memcpy(&(vp->fb[(size_t)(oy + py) * vp->w + ox + x0]),
+            &(cell[py * 32 + x0]), (x1 - x0) * sizeof(Pud_Color));
+}
+
+static Pud_Bool
+_draws_collect(War2_Viewport *vp,
+               int            x0,
+               int            y0,
+               int            x1,
+               int            y1)
+{
+   const Pud *const pud = vp->pud;
+   const War2_Unit_Sprite *sp;
+   const Pud_Unit_Info *u;
+   Sprite_Draw *tmp;
+   unsigned int i, pass, alloc;
+   int x, y;
+
+   /* Keeps the sprites that overlap the pixels [x0,x1[ x [y0,y1[ */
+   vp->draws_count = 0;
+   for (pass = 0; pass < 2; ++pass)
+     {
+        for (i = 0; i < pud->units_count; ++i)
+          {
+             u = &(pud->units[i]);
+             if ((pass == 0) == (pud_unit_flying_is(u->type) != PUD_FALSE))
+               continue;
+             sp = war2_unit_sprite_get(vp->w2, &(vp->sprites), u->type, u->player);
+             if (!sp) continue;
+
+             x = (int)(u->x * 32) + sp->x;
+             y = (int)(u->y * 32) + sp->y;
+             if ((x >= x1) || (y >= y1) ||
+                 (x + (int)sp->w <= x0) || (y + (int)sp->h <= y0))
+               continue;
+
+             if (vp->draws_count == vp->draws_alloc)
+               {
+                  alloc = (vp->draws_alloc) ? vp->draws_alloc * 2 : 64;
+                  tmp = realloc(vp->draws, alloc * sizeof(Sprite_Draw));
+                  if (!tmp) DIE_RETURN(PUD_FALSE, "Failed to allocate memory");
+                  vp->draws = tmp;
+                  vp->draws_alloc = alloc;
+               }
+             vp->draws[vp->draws_count].sp = sp;
+             vp->draws[vp->draws_count].x = x;
+             vp->draws[vp->draws_count].y = y;
+             vp->draws_count++;
+          }
+     }
+
+   return PUD_TRUE;
+}
+
+PUDAPI War2_Viewport *
+war2_viewport_new(War2_Data    *w2,
+                  Pud          *pud,
+                  unsigned int  w,
+                  unsigned int  h)
+{
+   War2_Viewport *vp;
+
+   if ((!w2) || (!pud) || (w == 0) || (h == 0))
+     DIE_RETURN(NULL, "Invalid arguments");
+
+   vp = calloc(1, sizeof(War2_Viewport));
+   if (!vp) DIE_RETURN(NULL, "Failed to allocate memory");
+   vp->w2 = w2;
+   vp->pud = pud;
+   vp->w = w;
+   vp->h = h;
+   war2_unit_sprites_init(&(vp->sprites), pud->era);
+
+   vp->fb = calloc((size_t)w * h, sizeof(Pud_Color));
+   vp->dirty = malloc(pud->map_w * pud->map_h + 1);
+   if ((!vp->fb) || (!vp->dirty)) DIE_GOTO(fail, "Failed to allocate memory");
+   memset(vp->dirty, 1, pud->map_w * pud->map_h);
+
+   vp->ts = war2_tileset_open(w2, pud->era);
+   if (!vp->ts) goto fail;
+   if (!war2_unit_sprites_load(w2, &(vp->sprites), pud)) goto fail;
+
+   if (!pud_change_callback_add(pud, _change_cb, vp)) goto fail;
+
+   return vp;
+
+fail:
+   war2_tileset_close(vp->ts);
+   war2_unit_sprites_clear(&(vp->sprites));
+   free(vp->dirty);
+   free(vp->fb);
+   free(vp);
+   return NULL;
+}
+
+PUDAPI void
+war2_viewport_free(War2_Viewport *vp)
+{
+   if (!vp) return;
+   pud_change_callback_del(vp->pud, _change_cb, vp);
+   war2_tileset_close(vp->ts);
+   war2_unit_sprites_clear(&(vp->sprites));
+   free(vp->draws);
+   free(vp->dirty);
+   free(vp->fb);
+   free(vp);
+}
+
+PUDAPI void
+war2_viewport_scroll(War2_Viewport *vp,
+                     int            dx,
+                     int            dy)
+{
+   const int max_x = ((int)(vp->pud->map_w * 32) > (int)vp->w)
+      ? (int)(vp->pud->map_w * 32) - (int)vp->w : 0;
+   const int max_y = ((int)(vp->pud->map_h * 32) > (int)vp->h)
+      ? (int)(vp->pud->map_h * 32) - (int)vp->h : 0;
+   const int w = vp->w, h = vp->h;
+   int nx, ny, r, r_start, r_end, r_step;
+   Pud_Color *row;
+
+   nx = vp->x + dx;
+   ny = vp->y + dy;
+   if (nx < 0) nx = 0; else if (nx > max_x) nx = max_x;
+   if (ny < 0) ny = 0; else if (ny > max_y) ny = max_y;
+   dx = nx - vp->x;
+   dy = ny - vp->y;
+   if ((dx == 0) && (dy == 0)) return;
+   vp->x = nx;
+   vp->y = ny;
+
+   /* Nothing remains visible */
+   if ((abs(dx) >= w) || (abs(dy) >= h))
+     {
+        _area_invalidate(vp, nx, ny, w, h);
+        return;
+     }
+
+   /* Rows are moved in an order that does not overwrite the rows that
+    * are yet to be moved */
+   if (dy >= 0) { r_start = 0; r_end = h - dy; r_step = 1; }
+   else { r_start = h - 1; r_end = -dy - 1; r_step = -1; }
+   for (r = r_start; r != r_end; r += r_step)
+     {
+        row = &(vp->fb[(size_t)r * w]);
+        if (dx >= 0)
+          memmove(row, &(vp->fb[(size_t)(r + dy) * w + dx]),
+                  (w - dx) * sizeof(Pud_Color));
+        else
+          memmove(&(row[-dx]), &(vp->fb[(size_t)(r + dy) * w]),
+                  (w + dx) * sizeof(Pud_Color));
+     }
+
+   /* Exposed areas */
+   if (dx > 0) _area_invalidate(vp, nx + w - dx, ny, dx, h);
+   else if (dx < 0) _area_invalidate(vp, nx, ny, -dx, h);
+   if (dy > 0) _area_invalidate(vp, nx, ny + h - dy, w, dy);
+   else if (dy < 0) _area_invalidate(vp, nx, ny, w, -dy);
+}
+
+PUDAPI void
+war2_viewport_position_get(const War2_Viewport *vp,
+                           int                 *x,
+                           int                 *y)
+{
+   if (x) *x = vp->x;
+   if (y) *y = vp->y;
+}
+
+PUDAPI void
+war2_viewport_invalidate(War2_Viewport *vp,
+                         unsigned int   x,
+                         unsigned int   y,
+                         unsigned int   w,
+                         unsigned int   h)
+{
+   const unsigned int map_w = vp->pud->map_w;
+   const unsigned int map_h = vp->pud->map_h;
+   unsigned int cy;
+
+   if ((x >= map_w) || (y >= map_h)) return;
+   if (w > map_w - x) w = map_w - x;
+   if (h > map_h - y) h = map_h - y;
+
+   for (cy = y; cy < y + h; ++cy)
+     memset(&(vp->dirty[cy * map_w + x]), 1, w);
+}
+
+PUDAPI unsigned int
+war2_viewport_render(War2_Viewport *vp)
+{
+   const Pud *const pud = vp->pud;
+   unsigned int cx, cy, cx0, cy0, cx1, cy1, count = 0;
+   unsigned int dx0 = UINT_MAX, dy0 = UINT_MAX, dx1 = 0, dy1 = 0;
+
+   cx0 = vp->x / 32;
+   cy0 = vp->y / 32;
+   cx1 = (vp->x + vp->w + 31) / 32;
+   cy1 = (vp->y + vp->h + 31) / 32;
+   if (cx1 > pud->map_w) cx1 = pud->map_w;
+   if (cy1 > pud->map_h) cy1 = pud->map_h;
+
+   /* Bounds of the visible dirty cells */
+   for (cy = cy0; cy < cy1; ++cy)
+     for (cx = cx0; cx < cx1; ++cx)
+       {
+          if (!vp->dirty[cy * pud->map_w + cx]) continue;
+          if (cx < dx0) dx0 = cx;
+          if (cx >= dx1) dx1 = cx + 1;
+          if (cy < dy0) dy0 = cy;
+          dy1 = cy + 1;
+       }
+   if (dx0 >= dx1) return 0;
+
+   if (!_draws_collect(vp, dx0 * 32, dy0 * 32, dx1 * 32, dy1 * 32))
+     return 0;
+
+   for (cy = dy0; cy < dy1; ++cy)
+     for (cx = dx0; cx < dx1; ++cx)
+       {
+          if (!vp->dirty[cy * pud->map_w + cx]) continue;
+          _cell_render(vp, cx, cy);
+          vp->dirty[cy * pud->map_w + cx] = 0;
+          count++;
+       }
+
+   return count;
+}
+
+PUDAPI const Pud_Color *
+war2_viewport_framebuffer_get(const War2_Viewport *vp,
+                              unsigned int        *w,
+                              unsigned int        *h)
+{
+   if (w) *w = vp->w;
+   if (h) *h = vp->h;
+   return vp->fb;
+}
@@ -29,6 +29,9 @@
  * and hexdump.
  */
 
+/* Palette entries, indexed by Pud_Era */
+static const unsigned int _palettes[4] = { 2, 18, 10, 438 };
+
 PUDAPI Pud_Bool
 war2_init(void)
 {
@@ -140,10 +143,10 @@ err_free:
         w2->entries[i] = (unsigned char*)(w2->mem_map->map) + l;
      }
 
-   _palette_extract(w2, 2, w2->forest);
-   _palette_extract(w2, 18, w2->winter);
-   _palette_extract(w2, 10, w2->wasteland);
-   _palette_extract(w2, 438, w2->swamp);
+   _palette_extract(w2, _palettes[PUD_ERA_FOREST], w2->forest);
+   _palette_extract(w2, _palettes[PUD_ERA_WINTER], w2->winter);
+   _palette_extract(w2, _palettes[PUD_ERA_WASTELAND], w2->wasteland);
+   _palette_extract(w2, _palettes[PUD_ERA_SWAMP], w2->swamp);
 
    return w2;
 
@@ -165,35 +168,37 @@ war2_palette_get(const War2_Data *w2, Pud_Era era)
 }
 
 
-PUDAPI unsigned char *
-war2_entry_extract(War2_Data    *w2,
-                   unsigned int  entry,
-                   size_t       *size_ret)
+static unsigned char *
+_entry_decode(const War2_Data *w2,
+              unsigned int     entry,
+              size_t          *size_ret)
 {
+   /* The memory map is shared, but each decoding walks it with its own
+    * cursor, so several entries can be decoded concurrently */
+   Pud_Mmap map;
    unsigned char buf[4096];
-   unsigned char *ptr = NULL, *p, *e;
+   unsigned char *volatile ptr = NULL;
+   unsigned char *p, *e;
    uint32_t l, ulen;
    uint16_t w;
    uint8_t bits, b;
    int flags, i, j, bi = 0;
 
-   /* Check the entry is in the range */
-   if (entry >= w2->entries_count)
-     DIE_RETURN(NULL, "Invalid entry [%i]. Entries range is: [0 ; %u].",
-                entry, w2->entries_count - 1);
+   if (!w2->entries[entry])
+     DIE_RETURN(NULL, "Entry [%u] is not within the file", entry);
 
-   WAR2_TRAP_SETUP(w2) {
+   memcpy(&map, w2->mem_map, sizeof(map));
+   COMMON_TRAP_SETUP(&map) {
 fail:
-      if (size_ret) *size_ret = 0;
       free(ptr);
       return NULL;
    }
 
    /* Go at entry */
-   w2->mem_map->ptr = w2->entries[entry];
+   map.ptr = w2->entries[entry];
 
    /* Uncompressed length (3 bytes) & Flags (1 byte) */
-   l = WAR2_READ32(w2);
+   l = common_read32(&map);
    flags = l >> 24;
    ulen = l & 0x00ffffff;
    WAR2_VERBOSE(w2, 2, "Entry %i: uncompressed length: %i. Flags: 0x%02x",
@@ -206,7 +211,7 @@ fail:
    switch (flags)
      {
       case 0x00: // Uncompressed
-         memcpy(ptr, w2->mem_map->ptr, ulen);
+         common_read_buffer(&map, ptr, ulen);
          break;
 
       case 0x20: // Compressed
@@ -215,7 +220,7 @@ fail:
          e = ptr + ulen;
          while (p < e)
            {
-              bits = WAR2_READ8(w2);
+              bits = common_read8(&map);
               for (i = 0; i < 8; i++)
                 {
                    /*
@@ -226,13 +231,13 @@ fail:
                     */
                    if (bits & 1)
                      {
-                        b = WAR2_READ8(w2);
+                        b = common_read8(&map);
                         *(p++) = b;
                         buf[bi++ & 0xfff] = b;
                      }
                    else
                      {
-                        w = WAR2_READ16(w2);
+                        w = common_read16(&map);
                         j = (w >> 12) + 3;
                         w &= 0x0fff;
                         while (j--)
@@ -252,14 +257,208 @@ fail:
      }
 
    WAR2_VERBOSE(w2, 1, "Extracted entry [%i] of size %i bytes", entry, ulen);
-   if (size_ret) *size_ret = ulen;
+   *size_ret = ulen;
+   return ptr;
+}
+
+PUDAPI unsigned char *
+war2_entry_extract(War2_Data    *w2,
+                   unsigned int  entry,
+                   size_t       *size_ret)
+{
+   War2_Entry e;
+   unsigned char *ptr;
+
+   if (!war2_entry_get(w2, entry, &e))
+     {
+        if (size_ret) *size_ret = 0;
+        return NULL;
+     }
+
+   /* Output entry will always be duplicated */
+   ptr = e.allocated;
+   if (!ptr)
+     {
+        ptr = malloc(e.size);
+        if (!ptr)
+          {
+             if (size_ret) *size_ret = 0;
+             DIE_RETURN(NULL, "Failed to allocate memory");
+          }
+        memcpy(ptr, e.data, e.size);
+     }
+
+   if (size_ret) *size_ret = e.size;
    return ptr;
 }
 
+PUDAPI_INTERNAL Pud_Bool
+war2_entry_get(War2_Data    *w2,
+               unsigned int  entry,
+               War2_Entry   *e)
+{
+   /* Check the entry is in the range */
+   if (entry >= w2->entries_count)
+     DIE_RETURN(PUD_FALSE, "Invalid entry [%i]. Entries range is: [0 ; %u].",
+                entry, w2->entries_count - 1);
+
+   /* Prefetched entries are lent, others are decoded for the caller */
+   if ((w2->cache) && (w2->cache[entry].data))
+     {
+        e->data = w2->cache[entry].data;
+        e->size = w2->cache[entry].size;
+        e->allocated = NULL;
+     }
+   else
+     {
+        e->allocated = _entry_decode(w2, entry, &(e->size));
+        if (!e->allocated) return PUD_FALSE;
+        e->data = e->allocated;
+     }
+
+   return PUD_TRUE;
+}
+
+PUDAPI_INTERNAL void
+war2_entry_release(War2_Entry *e)
+{
+   free(e->allocated);
+   e->allocated = NULL;
+   e->data = NULL;
+}
+
+typedef struct
+{
+   War2_Data          *w2;
+   const unsigned int *entries;
+} Prefetch;
+
+static void
+_prefetch_job(void         *data,
+              unsigned int  job)
+{
+   Prefetch *const pf = data;
+   War2_Entry_Cache *const cache = &(pf->w2->cache[pf->entries[job]]);
+
+   /* Entries are unique, so each job owns its cache slot */
+   cache->data = _entry_decode(pf->w2, pf->entries[job], &(cache->size));
+}
+
+PUDAPI Pud_Bool
+war2_entries_prefetch(War2_Data          *w2,
+                      const unsigned int *entries,
+                      unsigned int        count,
+                      unsigned int        nthreads)
+{
+   unsigned int *todo;
+   unsigned char *seen;
+   unsigned int i, todo_count = 0;
+   Pud_Bool ret = PUD_TRUE;
+   Prefetch pf;
+
+   if ((!w2) || ((!entries) && (count > 0)))
+     DIE_RETURN(PUD_FALSE, "Invalid arguments");
+
+   if (!w2->cache)
+     {
+        w2->cache = calloc(w2->entries_count, sizeof(War2_Entry_Cache));
+        if (!w2->cache) DIE_RETURN(PUD_FALSE, "Failed to allocate memory");
+     }
+
+   todo = malloc((count + 1) * sizeof(unsigned int));
+   seen = calloc(w2->entries_count, sizeof(unsigned char));
+   if ((!todo) || (!seen))
+     {
+        free(todo);
+        free(seen);
+        DIE_RETURN(PUD_FALSE, "Failed to allocate memory");
+     }
+
+   /* Only decode each missing entry once */
+   for (i = 0; i < count; ++i)
+     {
+        if (entries[i] >= w2->entries_count)
+          {
+             ERR("Invalid entry [%u]. Entries range is: [0 ; %u].",
+                 entries[i], w2->entries_count - 1);
+             ret = PUD_FALSE;
+             continue;
+          }
+        if ((seen[entries[i]]) || (w2->cache[entries[i]].data)) continue;
+        seen[entries[i]] = 1;
+        todo[todo_count++] = entries[i];
+     }
+
+   WAR2_VERBOSE(w2, 1, "Prefetching %u entries", todo_count);
+
+   pf.w2 = w2;
+   pf.entries = todo;
+   war2_jobs_run(todo_count, nthreads, _prefetch_job, &pf);
+
+   for (i = 0; i < todo_count; ++i)
+     if (!w2->cache[todo[i]].data) ret = PUD_FALSE;
+
+   free(seen);
+   free(todo);
+
+   return ret;
+}
+
+PUDAPI Pud_Bool
+war2_prefetch_for_pud(War2_Data    *w2,
+                      const Pud    *pud,
+                      unsigned int  nthreads)
+{
+   unsigned int entries[4 + PUD_UNIT_NONE];
+   Pud_Bool seen[PUD_UNIT_NONE] = { PUD_FALSE };
+   const unsigned int *ts;
+   unsigned int i, count = 0;
+   Pud_Era era;
+   Pud_Unit type;
+
+   if ((!w2) || (!pud)) DIE_RETURN(PUD_FALSE, "Invalid arguments");
+
+   era = pud->era;
+   if ((unsigned int)era >= ARRAY_SIZE(_palettes))
+     DIE_RETURN(PUD_FALSE, "Invalid era [%i]", era);
+
+   /* Palette and tileset of the era */
+   entries[count++] = _palettes[era];
+   ts = war2_tileset_entries_get(era);
+   for (i = 0; i < 3; ++i)
+     entries[count++] = ts[i];
+
+   /* Sprites of each type of unit on the map */
+   for (i = 0; i < pud->units_count; ++i)
+     {
+        type = pud->units[i].type;
+        if (((unsigned int)type >= PUD_UNIT_NONE) || (seen[type])) continue;
+        seen[type] = PUD_TRUE;
+        if (war2_sprites_entry_for(type, era, &(entries[count]), NULL, NULL))
+          count++;
+     }
+
+   return war2_entries_prefetch(w2, entries, count, nthreads);
+}
+
+PUDAPI void
+war2_entries_cache_flush(War2_Data *w2)
+{
+   unsigned int i;
+
+   if ((!w2) || (!w2->cache)) return;
+
+   for (i = 0; i < w2->entries_count; ++i)
+     free(w2->cache[i].data);
+   free(w2->cache);
+   w2->cache = NULL;
+}
+
 PUDAPI void
 war2_close(War2_Data *w2)
 {
    if (!w2) return;
+   war2_entries_cache_flush(w2);
    common_file_munmap(w2->mem_map);
    free(w2->entries);
    free(w2);
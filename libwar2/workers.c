@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2017 Jean Guyomarc'h
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "war2_private.h"
+
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+# include <unistd.h>
+#endif
+
+/*
+ * Tiny pool of workers: jobs are identified by their index, and workers
+ * pull the next index until all the jobs have been taken. The calling
+ * thread works as well, and the call returns when all the jobs are done.
+ * Without thread support, jobs are run serially in the calling thread.
+ */
+
+#ifdef HAVE_PTHREAD
+typedef struct
+{
+   pthread_mutex_t  lock;
+   War2_Job_Func    func;
+   void            *data;
+   unsigned int     next;
+   unsigned int     count;
+} Jobs;
+
+static void *
+_worker(void *data)
+{
+   Jobs *const jobs = data;
+   unsigned int job;
+
+   for (;;)
+     {
+        pthread_mutex_lock(&jobs->lock);
+        job = jobs->next;
+        if (job < jobs->count) jobs->next++;
+        pthread_mutex_unlock(&jobs->lock);
+
+        if (job >= jobs->count) break;
+        jobs->func(jobs->data, job);
+     }
+
+   return NULL;
+}
+#endif
+
+PUDAPI_INTERNAL unsigned int
+war2_workers_count(unsigned int nthreads)
+{
+#ifdef HAVE_PTHREAD
+   long cpus;
+
+   /* 0 means as many workers as online CPUs */
+   if (nthreads == 0)
+     {
+        cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads = (cpus > 0) ? (unsigned int)cpus : 1;
+     }
+   return nthreads;
+#else
+   (void) nthreads;
+   return 1;
+#endif
+}
+
+PUDAPI_INTERNAL void
+war2_jobs_run(unsigned int   jobs_count,
+              unsigned int   nthreads,
+              War2_Job_Func  func,
+              void          *data)
+{
+   unsigned int i;
+#ifdef HAVE_PTHREAD
+   pthread_t *threads;
+   unsigned int started = 0;
+   Jobs jobs;
+
+   nthreads = war2_workers_count(nthreads);
+   if (nthreads > jobs_count) nthreads = jobs_count;
+   if (nthreads > 1)
+     {
+        threads = malloc((nthreads - 1) * sizeof(pthread_t));
+        if (threads)
+          {
+             pthread_mutex_init(&jobs.lock, NULL);
+             jobs.func = func;
+             jobs.data = data;
+             jobs.next = 0;
+             jobs.count = jobs_count;
+
+             /* If a thread cannot be created, the others do its share */
+             for (i = 0; i < nthreads - 1; ++i)
+               if (pthread_create(&(threads[started]), NULL, _worker, &jobs) == 0)
+                 started++;
+
+             _worker(&jobs);
+             for (i = 0; i < started; ++i)
+               pthread_join(threads[i], NULL);
+
+             pthread_mutex_destroy(&jobs.lock);
+             free(threads);
+             return;
+          }
+     }
+#else
+   (void) nthreads;
+#endif
+
+   for (i = 0; i < jobs_count; ++i)
+     func(data, i);
+}
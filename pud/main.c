@@ -7,6 +7,14 @@
 
 #include "pudutils.h"
 #include <string.h>
+#include <errno.h>
+
+#ifdef HAVE_MSVC
+# include <direct.h>
+# define mkdir(path_, mode_) _mkdir(path_)
+#else
+# include <sys/stat.h>
+#endif
 
 #ifdef HAVE_MSVC
 // See http://botsikas.blogspot.de/2011/12/strcasecmp-identifier-not-found-when.html
@@ -39,6 +47,12 @@ static const struct option _options[] =
      {"sections", no_argument,          0, 's'},
      {"cursor",   optional_argument,    0, 'C'},
      {"war",      no_argument,          0, 'w'},
+     {"data",     required_argument,    0, 'd'},
+     {"render",   no_argument,          0, 'r'},
+     {"pyramid",  required_argument,    0, 'y'},
+     {"indexed",  no_argument,          0, 'i'},
+     {"jobs",     required_argument,    0, 'J'},
+     {"tiles",    required_argument,    0, 'T'},
      {"verbose",  no_argument,          0, 'v'},
      {"help",     no_argument,          0, 'h'},
      {NULL,       0,                    0, '\0'}
@@ -70,10 +84,22 @@ _usage(FILE *stream)
            "    -s | --sections       Gets sections in the PUD file.\n"
            "    -C | --cursor [entry] Extract the cursor for the specified entry. If [entry] is not\n"
            "                          specified, all the cursors are extracted.\n"
+           "    -T | --tiles <era>    Extract the tiles of the tileset of <era> (forest, winter,\n"
+           "                          wasteland or swamp)\n"
            "    -S | --sprite <entry> Extract the graphic entry specified. Only when -W is enabled.\n"
            "                  <color> An output file (with -o) and type (-p,-j,-g) must be provided.\n"
            "                          Color must be a string (red, blue, ...). Arguments must be\n"
            "                          comma-separated\n"
+           "    -d | --data <file>    The .WAR file (maindat.war) that holds the graphics\n"
+           "    -r | --render         Renders the whole map with its units as a png file, using the\n"
+           "                          graphics of --data. If --out is not specified, the output's\n"
+           "                          filename will the the input file plus \".png\"\n"
+           "    -y | --pyramid <dir>  Renders the map as a pyramid of 256x256 png tiles, using the\n"
+           "                          graphics of --data. Tiles are written as <dir>/<z>/<x>/<y>.png\n"
+           "    -i | --indexed        With -S, -U and -C, keeps the palette of the graphics instead of\n"
+           "                          expanding them to RGBA. Much smaller files with --png\n"
+           "    -J | --jobs <n>       How many threads encode the images extracted by -S, -U, -C\n"
+           "                          and -T while they are being decoded. Defaults to one per CPU\n"
            "\n"
            "    -v | --verbose        Activate verbose mode. Cumulate flags increase verbosity level.\n"
            "    -h | --help           Shows this message\n"
@@ -93,6 +119,7 @@ static struct {
    unsigned int  ppm     : 1;
    unsigned int  jpeg    : 1;
    unsigned int  png     : 1;
+   unsigned int  indexed : 1;
    unsigned int  enabled : 1;
 } out;
 
@@ -129,6 +156,26 @@ static struct {
    unsigned int enabled : 1;
 } sqm;
 
+static struct {
+   char         *data;
+   unsigned int  enabled : 1;
+} render;
+
+static struct {
+   char         *dir;
+} pyramid;
+
+static struct {
+   unsigned int  enabled : 1;
+   Pud_Era       era;
+} tiles;
+
+static struct {
+   unsigned int  count;
+} jobs;
+
+static Pipeline *_pipeline = NULL;
+
 
 
 #define ABORT(errcode_, msg, ...) \
@@ -138,7 +185,6 @@ static struct {
 
 #define IS_STR(str_) !strncasecmp(str, str_, sizeof(str_) - 1)
 
-#if 0
 static Pud_Era
 _str2era(const char *str)
 {
@@ -156,7 +202,6 @@ _str2era(const char *str)
         exit(1);
      }
 }
-#endif
 
 static Pud_Player
 _str2color(const char *str)
@@ -199,6 +244,32 @@ _check_output_enabled(void)
      }
 }
 
+static void
+_output_prepare(unsigned int id,
+                char         *file,
+                size_t        size)
+{
+   const char *ext;
+   War2_Encoder_Format format;
+
+   if (out.png)       { format = WAR2_ENCODER_FORMAT_PNG;  ext = "png"; }
+   else if (out.jpeg) { format = WAR2_ENCODER_FORMAT_JPEG; ext = "jpg"; }
+   else               { format = WAR2_ENCODER_FORMAT_PPM;  ext = "ppm"; }
+   snprintf(file, size, "%s_%u.%s", out.file, id, ext);
+
+   /* Images are encoded and written by the pipeline, while the next ones
+    * are being decoded */
+   if (!_pipeline)
+     {
+        _pipeline = pipeline_new(format, jobs.count);
+        if (!_pipeline)
+          {
+             fprintf(stderr, "*** Failed to create encoding pipeline\n");
+             exit(2);
+          }
+     }
+}
+
 static void
 _write_output(const Pud_Color *img,
               unsigned int w,
@@ -206,29 +277,88 @@ _write_output(const Pud_Color *img,
               unsigned int id)
 {
    char file[4096];
-   Pud_Bool chk = PUD_FALSE;
 
-   if (out.png)
-     {
-        snprintf(file, sizeof(file), "%s_%u.png", out.file, id);
-        chk = war2_png_write(file, w, h, (const unsigned char *)img);
-     }
-   else if (out.jpeg)
-     {
-        snprintf(file, sizeof(file), "%s_%u.jpg", out.file, id);
-        chk = war2_jpeg_write(file, w, h, (const unsigned char *)img);
-     }
-   else if (out.ppm)
-     {
-        snprintf(file, sizeof(file), "%s_%u.ppm", out.file, id);
-        chk = war2_ppm_write(file, w, h, (const unsigned char *)img);
-     }
-   if (!chk)
+   _output_prepare(id, file, sizeof(file));
+   pipeline_push(_pipeline, file, w, h, img);
+}
+
+static void
+_write_output_indexed(const unsigned char *indexes,
+                      const Pud_Color     *palette,
+                      unsigned int         w,
+                      unsigned int         h,
+                      unsigned int         id)
+{
+   char file[4096];
+
+   /* Color 0 is transparent in all the palettes */
+   _output_prepare(id, file, sizeof(file));
+   pipeline_push_indexed(_pipeline, file, w, h, indexes, palette, 0);
+}
+
+static Pud_Bool
+_render_rows_cb(void            *data,
+                const Pud_Color *rows,
+                unsigned int     w,
+                unsigned int     y,
+                unsigned int     count)
+{
+   (void) w;
+   (void) y;
+   return war2_png_writer_rows_write(data, rows, count);
+}
+
+static Pud_Bool
+_map_render(War2_Data  *w2,
+            const Pud  *pud,
+            const char *file)
+{
+   War2_Png_Writer *png;
+   War2_Map_Sink sink;
+   Pud_Bool chk;
+
+   /* Rows are streamed to the png file as they are rendered */
+   png = war2_png_writer_new(file, pud->map_w * 32, pud->map_h * 32);
+   if (!png) return PUD_FALSE;
+
+   sink.rows = _render_rows_cb;
+   sink.data = png;
+   chk = war2_map_render(w2, pud, NULL, &sink);
+   if (!war2_png_writer_close(png)) chk = PUD_FALSE;
+
+   return chk;
+}
+
+static Pud_Bool
+_mkdir(const char *path)
+{
+   if ((mkdir(path, 0755) != 0) && (errno != EEXIST))
      {
-        fprintf(stderr, "*** Failed to save to [%s]", file);
-        exit(2);
+        ERR("Failed to create directory [%s]", path);
+        return PUD_FALSE;
      }
-   printf("Saving image at '%s'\n", file);
+   return PUD_TRUE;
+}
+
+static Pud_Bool
+_pyramid_tile_cb(void            *data,
+                 const Pud_Color *tile,
+                 unsigned int     level,
+                 unsigned int     x,
+                 unsigned int     y)
+{
+   const char *const dir = data;
+   char path[4096];
+
+   /* Called from several threads: directories may be created concurrently */
+   snprintf(path, sizeof(path), "%s/%u", dir, level);
+   if (!_mkdir(path)) return PUD_FALSE;
+   snprintf(path, sizeof(path), "%s/%u/%u", dir, level, x);
+   if (!_mkdir(path)) return PUD_FALSE;
+   snprintf(path, sizeof(path), "%s/%u/%u/%u.png", dir, level, x, y);
+
+   return war2_png_write(path, WAR2_PYRAMID_TILE_SIZE, WAR2_PYRAMID_TILE_SIZE,
+                         (const unsigned char *)tile);
 }
 
 static void
@@ -241,8 +371,23 @@ _war2_entry_cb(void                          *data,
                const War2_Sprites_Descriptor *ud,
                uint16_t                       img_nb)
 {
-   _write_output(img, w, h, img_nb);
-   (void) ud;
+   if (ud->indexes)
+     _write_output_indexed(ud->indexes, ud->palette, w, h, img_nb);
+   else
+     _write_output(img, w, h, img_nb);
+}
+
+static void
+_tile_cb(void                          *data,
+         const Pud_Color               *img,
+         unsigned int                   w,
+         unsigned int                   h,
+         const War2_Tileset_Descriptor *ts,
+         uint16_t                       tile)
+{
+   (void) data;
+   (void) ts;
+   _write_output(img, w, h, tile);
 }
 
 int
@@ -262,7 +407,7 @@ main(int    argc,
    /* Getopt */
    while (1)
      {
-        c = getopt_long(argc, argv, "o:pjsS:hgwPRQvt:C:U:", _options, &opt_idx);
+        c = getopt_long(argc, argv, "o:pjsS:hgwPRQvt:C:U:d:ry:iJ:T:", _options, &opt_idx);
         if (c == -1) break;
 
         switch (c)
@@ -307,6 +452,35 @@ main(int    argc,
               war2 = PUD_TRUE;
               break;
 
+           case 'd':
+              free(render.data);
+              render.data = strdup(optarg);
+              if (!render.data) ABORT(2, "Failed to strdup [%s]", optarg);
+              break;
+
+           case 'r':
+              render.enabled = 1;
+              break;
+
+           case 'i':
+              out.indexed = 1;
+              break;
+
+           case 'J':
+              jobs.count = strtoul(optarg, NULL, 10);
+              break;
+
+           case 'T':
+              tiles.enabled = 1;
+              tiles.era = _str2era(optarg);
+              break;
+
+           case 'y':
+              free(pyramid.dir);
+              pyramid.dir = strdup(optarg);
+              if (!pyramid.dir) ABORT(2, "Failed to strdup [%s]", optarg);
+              break;
+
            case 't':
               tile_at.enabled = 1;
               sscanf(optarg, "%i,%i", &tile_at.x, &tile_at.y);
@@ -358,6 +532,8 @@ main(int    argc,
             print.enabled   ||
             regm.enabled    ||
             sqm.enabled     ||
+            render.enabled  ||
+            pyramid.dir     ||
             sections.enabled)
           ABORT(1, "Invalid option when --war,-W is specified");
 
@@ -368,12 +544,17 @@ main(int    argc,
         if (sprite.enabled)
           {
              _check_output_enabled();
-             war2_sprites_decode_entry(w2, sprite.color, sprite.entry, _war2_entry_cb, NULL);
+             war2_sprites_decode_entry_full(w2, sprite.color, sprite.entry,
+                                            (out.indexed) ? WAR2_SPRITES_DECODE_INDEXED
+                                                          : WAR2_SPRITES_DECODE_NONE,
+                                            _war2_entry_cb, NULL);
           }
         else if (cursor.enabled)
           {
              int hotx, hoty;
              unsigned int w, h;
+             const Pud_Color *const palette = war2_palette_get(w2, PUD_ERA_FOREST);
+             unsigned char *indexes;
              Pud_Color *img;
              War2_Cursor it, first, last;
 
@@ -390,26 +571,55 @@ main(int    argc,
                }
              for (it = first; it <= last; it++)
                {
-                  img = war2_cursors_decode(w2, it, &hotx, &hoty, &w, &h);
-                  printf("hotx: %i, hoty: %i\n", hotx, hoty);
-                  _write_output(img, w, h, it);
-                  free(img);
+                  if (out.indexed)
+                    {
+                       indexes = war2_cursors_decode_indexed(w2, it, &hotx, &hoty, &w, &h);
+                       if (!indexes) ABORT(4, "Failed to decode cursor [%u]", it);
+                       printf("hotx: %i, hoty: %i\n", hotx, hoty);
+                       _write_output_indexed(indexes, palette, w, h, it);
+                       free(indexes);
+                    }
+                  else
+                    {
+                       img = war2_cursors_decode(w2, it, &hotx, &hoty, &w, &h);
+                       if (!img) ABORT(4, "Failed to decode cursor [%u]", it);
+                       printf("hotx: %i, hoty: %i\n", hotx, hoty);
+                       _write_output(img, w, h, it);
+                       free(img);
+                    }
                }
           }
+        else if (tiles.enabled)
+          {
+             _check_output_enabled();
+             if (!war2_tileset_decode(w2, tiles.era, _tile_cb, NULL))
+               ABORT(4, "Failed to decode the tileset of [%s]", pud_era_to_string(tiles.era));
+          }
         else if (ui.enabled)
           {
              Pud_Color *img;
+             unsigned char *indexes;
              unsigned int w, h;
 
              _check_output_enabled();
-             img = war2_ui_decode(w2, ui.entry, &w, &h);
-             _write_output(img, w, h, ui.entry);
-             free(img);
+             if (out.indexed)
+               {
+                  indexes = war2_ui_decode_indexed(w2, ui.entry, &w, &h);
+                  _write_output_indexed(indexes, war2_palette_get(w2, PUD_ERA_FOREST),
+                                        w, h, ui.entry);
+                  free(indexes);
+               }
+             else
+               {
+                  img = war2_ui_decode(w2, ui.entry, &w, &h);
+                  _write_output(img, w, h, ui.entry);
+                  free(img);
+               }
           }
      }
    else
      {
-        if (sprite.enabled)
+        if (sprite.enabled || tiles.enabled)
           ABORT(1, "Invalid option when --war,-W is not specified");
 
         /* Open file */
@@ -430,8 +640,47 @@ main(int    argc,
                      w, pud->action_map[idx], pud->movement_map[idx]);
           }
 
+        /* --pyramid */
+        if (pyramid.dir)
+          {
+             if (!render.data) ABORT(1, "--pyramid requires --data");
+             if (!_mkdir(pyramid.dir)) ABORT(4, "Failed to render [%s]", file);
+
+             w2 = war2_open(render.data);
+             if (w2 == NULL) ABORT(3, "Failed to create War2_Data from [%s]", render.data);
+             war2_verbosity_set(w2, verbose);
+
+             if (!war2_map_pyramid_render(w2, pud, NULL, _pyramid_tile_cb, pyramid.dir))
+               ABORT(4, "Failed to render [%s] to [%s]", file, pyramid.dir);
+          }
+
+        /* --render */
+        if (render.enabled)
+          {
+             if (!render.data) ABORT(1, "--render requires --data");
+             if (out.jpeg || out.ppm) ABORT(1, "--render only outputs png files");
+             if (!out.file)
+               {
+                  char buf[4096];
+                  int len;
+
+                  len = snprintf(buf, sizeof(buf), "%s.png", file);
+                  out.file = strndup(buf, len);
+                  if (!out.file) ABORT(2, "Failed to strdup [%s]", buf);
+               }
+
+             if (!w2)
+               {
+                  w2 = war2_open(render.data);
+                  if (w2 == NULL) ABORT(3, "Failed to create War2_Data from [%s]", render.data);
+                  war2_verbosity_set(w2, verbose);
+               }
+
+             if (!_map_render(w2, pud, out.file))
+               ABORT(4, "Failed to render [%s] to [%s]", file, out.file);
+          }
         /* --output,--ppm,--jpeg,--png */
-        if (out.enabled)
+        else if (out.enabled)
           {
              if (regm.enabled)
                ABORT(1, "--regm is not compatible with --output");
@@ -509,6 +758,11 @@ main(int    argc,
      }
 
 end:
+   /* Wait for the images still being encoded */
+   if ((!pipeline_free(_pipeline)) && (ret_status == EXIT_SUCCESS))
+     ret_status = 2;
+   free(render.data);
+   free(pyramid.dir);
    free(out.file);
    pud_close(pud);
    war2_close(w2);
@@ -0,0 +1,334 @@
+/*
+ * pipeline.c
+ * pud
+ *
+ * Copyright (c) 2017 Jean Guyomarc'h
+ */
+
+#include "pudutils.h"
+
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+# include <unistd.h>
+#endif
+
+/*
+ * Images are decoded by the main thread, and encoded by a pool of
+ * workers. The decoder hands copies of its images over through a bounded
+ * queue, so it blocks when the encoders cannot keep up, and no more than
+ * a few images are held in memory at once. Each worker has an encoder of
+ * its own. With a single job (or without thread support), images are
+ * encoded right away in the calling thread.
+ */
+
+typedef struct
+{
+   char          *file;
+   unsigned char *data; /* RGBA pixels, or indexes when palette is set */
+   Pud_Color     *palette;
+   unsigned int   w;
+   unsigned int   h;
+   int            transparent;
+} Job;
+
+struct _Pipeline
+{
+   War2_Encoder_Format  format;
+   unsigned int         workers_count;
+   Pud_Bool             failed;
+
+   /* Encoder of the calling thread, when there are no workers */
+   War2_Encoder        *encoder;
+
+#ifdef HAVE_PTHREAD
+   pthread_t           *workers;
+   pthread_mutex_t      lock;
+   pthread_cond_t       not_empty;
+   pthread_cond_t       not_full;
+   Job                 *queue;
+   unsigned int         queue_size;
+   unsigned int         head;
+   unsigned int         count;
+   Pud_Bool             closing;
+#endif
+};
+
+static void
+_job_clear(Job *job)
+{
+   free(job->file);
+   free(job->data);
+   free(job->palette);
+}
+
+static Pud_Bool
+_job_run(War2_Encoder *enc,
+         const Job    *job)
+{
+   Pud_Bool chk;
+
+   if (job->palette)
+     chk = war2_encoder_write_indexed(enc, job->file, job->w, job->h,
+                                      job->data, job->palette,
+                                      job->transparent);
+   else
+     chk = war2_encoder_write(enc, job->file, job->w, job->h, job->data);
+
+   if (chk) printf("Saving image at '%s'\n", job->file);
+   else fprintf(stderr, "*** Failed to save to [%s]\n", job->file);
+
+   return chk;
+}
+
+#ifdef HAVE_PTHREAD
+static void *
+_worker(void *data)
+{
+   Pipeline *const pl = data;
+   War2_Encoder *enc;
+   Job job;
+   Pud_Bool chk;
+
+   enc = war2_encoder_new(pl->format, NULL);
+
+   pthread_mutex_lock(&pl->lock);
+   for (;;)
+     {
+        while ((pl->count == 0) && (!pl->closing))
+          pthread_cond_wait(&pl->not_empty, &pl->lock);
+        if (pl->count == 0) break; /* Closing, and nothing left */
+
+        job = pl->queue[pl->head];
+        pl->head = (pl->head + 1) % pl->queue_size;
+        pl->count--;
+        pthread_cond_signal(&pl->not_full);
+        pthread_mutex_unlock(&pl->lock);
+
+        chk = (enc) && _job_run(enc, &job);
+        _job_clear(&job);
+
+        pthread_mutex_lock(&pl->lock);
+        if (!chk) pl->failed = PUD_TRUE;
+     }
+   pthread_mutex_unlock(&pl->lock);
+
+   war2_encoder_free(enc);
+   return NULL;
+}
+#endif
+
+Pipeline *
+pipeline_new(War2_Encoder_Format format,
+             unsigned int        jobs)
+{
+   Pipeline *pl;
+#ifdef HAVE_PTHREAD
+   unsigned int i;
+   long cpus;
+#endif
+
+   pl = calloc(1, sizeof(Pipeline));
+   if (!pl) DIE_RETURN(NULL, "Failed to allocate memory");
+   pl->format = format;
+
+#ifdef HAVE_PTHREAD
+   /* 0 means as many jobs as online CPUs */
+   if (jobs == 0)
+     {
+        cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        jobs = (cpus > 0) ? (unsigned int)cpus : 1;
+     }
+   if (jobs > 1)
+     {
+        /* Enough room for the workers to always have an image ready */
+        pl->queue_size = jobs * 2;
+        pl->queue = calloc(pl->queue_size, sizeof(Job));
+        pl->workers = malloc(jobs * sizeof(pthread_t));
+        if ((!pl->queue) || (!pl->workers))
+          {
+             free(pl->queue);
+             free(pl->workers);
+             free(pl);
+             DIE_RETURN(NULL, "Failed to allocate memory");
+          }
+        pthread_mutex_init(&pl->lock, NULL);
+        pthread_cond_init(&pl->not_empty, NULL);
+        pthread_cond_init(&pl->not_full, NULL);
+
+        /* If a thread cannot be created, the others do its share */
+        for (i = 0; i < jobs; i++)
+          if (pthread_create(&(pl->workers[pl->workers_count]), NULL,
+                             _worker, pl) == 0)
+            pl->workers_count++;
+        if (pl->workers_count > 0)
+          return pl;
+
+        pthread_cond_destroy(&pl->not_full);
+        pthread_cond_destroy(&pl->not_empty);
+        pthread_mutex_destroy(&pl->lock);
+        free(pl->workers);
+        free(pl->queue);
+        pl->workers = NULL;
+        pl->queue = NULL;
+     }
+#else
+   (void) jobs;
+#endif
+
+   pl->encoder = war2_encoder_new(format, NULL);
+   if (!pl->encoder)
+     {
+        free(pl);
+        return NULL;
+     }
+   return pl;
+}
+
+static void
+_pipeline_fail(Pipeline *pl)
+{
+#ifdef HAVE_PTHREAD
+   if (pl->workers_count)
+     {
+        pthread_mutex_lock(&pl->lock);
+        pl->failed = PUD_TRUE;
+        pthread_mutex_unlock(&pl->lock);
+        return;
+     }
+#endif
+   pl->failed = PUD_TRUE;
+}
+
+static Pud_Bool
+_pipeline_push(Pipeline *pl,
+               Job      *job)
+{
+   Pud_Bool chk;
+
+   if (!pl->workers_count)
+     {
+        chk = _job_run(pl->encoder, job);
+        if (!chk) pl->failed = PUD_TRUE;
+        _job_clear(job);
+        return chk;
+     }
+
+#ifdef HAVE_PTHREAD
+   pthread_mutex_lock(&pl->lock);
+   while (pl->count == pl->queue_size)
+     pthread_cond_wait(&pl->not_full, &pl->lock);
+   pl->queue[(pl->head + pl->count) % pl->queue_size] = *job;
+   pl->count++;
+   chk = !pl->failed;
+   pthread_cond_signal(&pl->not_empty);
+   pthread_mutex_unlock(&pl->lock);
+
+   return chk;
+#else
+   return PUD_FALSE;
+#endif
+}
+
+Pud_Bool
+pipeline_push(Pipeline        *pl,
+              const char      *file,
+              unsigned int     w,
+              unsigned int     h,
+              const Pud_Color *img)
+{
+   const size_t size = (size_t)w * h * sizeof(Pud_Color);
+   Job job;
+
+   if (!pl) return PUD_FALSE;
+   memset(&job, 0, sizeof(job));
+   if (!img) goto fail;
+
+   /* The image belongs to the decoder: it is copied */
+   job.file = strdup(file);
+   job.data = malloc(size);
+   if ((!job.file) || (!job.data))
+     DIE_GOTO(fail, "Failed to allocate memory");
+   memcpy(job.data, img, size);
+   job.w = w;
+   job.h = h;
+
+   return _pipeline_push(pl, &job);
+
+fail:
+   /* A lost image fails the whole pipeline */
+   _job_clear(&job);
+   _pipeline_fail(pl);
+   return PUD_FALSE;
+}
+
+Pud_Bool
+pipeline_push_indexed(Pipeline            *pl,
+                      const char          *file,
+                      unsigned int         w,
+                      unsigned int         h,
+                      const unsigned char *indexes,
+                      const Pud_Color     *palette,
+                      int                  transparent)
+{
+   const size_t size = (size_t)w * h;
+   Job job;
+
+   if (!pl) return PUD_FALSE;
+   memset(&job, 0, sizeof(job));
+   if ((!indexes) || (!palette)) goto fail;
+
+   job.file = strdup(file);
+   job.data = malloc(size);
+   job.palette = malloc(WAR2_PALETTE_SIZE * sizeof(Pud_Color));
+   if ((!job.file) || (!job.data) || (!job.palette))
+     DIE_GOTO(fail, "Failed to allocate memory");
+   memcpy(job.data, indexes, size);
+   memcpy(job.palette, palette, WAR2_PALETTE_SIZE * sizeof(Pud_Color));
+   job.w = w;
+   job.h = h;
+   job.transparent = transparent;
+
+   return _pipeline_push(pl, &job);
+
+fail:
+   _job_clear(&job);
+   _pipeline_fail(pl);
+   return PUD_FALSE;
+}
+
+Pud_Bool
+pipeline_free(Pipeline *pl)
+{
+   Pud_Bool chk;
+#ifdef HAVE_PTHREAD
+   unsigned int i;
+#endif
+
+   if (!pl) return PUD_TRUE;
+
+#ifdef HAVE_PTHREAD
+   if (pl->workers_count)
+     {
+        /* Workers drain the queue before leaving */
+        pthread_mutex_lock(&pl->lock);
+        pl->closing = PUD_TRUE;
+        pthread_cond_broadcast(&pl->not_empty);
+        pthread_mutex_unlock(&pl->lock);
+
+        for (i = 0; i < pl->workers_count; i++)
+          pthread_join(pl->workers[i], NULL);
+
+        pthread_cond_destroy(&pl->not_full);
+        pthread_cond_destroy(&pl->not_empty);
+        pthread_mutex_destroy(&pl->lock);
+        free(pl->workers);
+        free(pl->queue);
+     }
+#endif
+
+   chk = !pl->failed;
+   war2_encoder_free(pl->encoder);
+   free(pl);
+
+   return chk;
+}
@@ -29,4 +29,11 @@ Pud_Bool pud_minimap_to_jpeg(Pud *pud, const char *file);
 Pud_Bool pud_minimap_to_png(Pud *pud, const char *file);
 Pud_Bool pud_minimap_to_ppm(Pud *pud, const char *file);
 
+typedef struct _Pipeline Pipeline;
+
+Pipeline *pipeline_new(War2_Encoder_Format format, unsigned int jobs);
+Pud_Bool pipeline_push(Pipeline *pl, const char *file, unsigned int w, unsigned int h, const Pud_Color *img);
+Pud_Bool pipeline_push_indexed(Pipeline *pl, const char *file, unsigned int w, unsigned int h, const unsigned char *indexes, const Pud_Color *palette, int transparent);
+Pud_Bool pipeline_free(Pipeline *pl);
+
 #endif /* ! _PUDUTILS_H_ */
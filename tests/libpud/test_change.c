@@ -0,0 +1,139 @@
+#include "tests.h"
+#include <pud.h>
+
+typedef struct
+{
+   unsigned int calls;
+   Pud_Change last;
+   Pud_Unit last_unit;
+} Changes;
+
+static void
+_change_cb(void             *data,
+           Pud              *pud,
+           const Pud_Change *change)
+{
+   Changes *const c = data;
+
+   (void) pud;
+   c->calls++;
+   c->last = *change;
+   /* The unit may not outlive the callback */
+   if (change->info) c->last_unit = change->info->type;
+}
+
+static void
+_change_once_cb(void             *data,
+                Pud              *pud,
+                const Pud_Change *change)
+{
+   /* Unregister from within the emission */
+   _change_cb(data, pud, change);
+   fail_if(pud_change_callback_del(pud, _change_once_cb, data) != PUD_TRUE);
+}
+
+START_TEST(change_callbacks)
+{
+   Pud *p;
+   Changes c1, c2;
+   const Pud_Rect region = { 1, 2, 3, 4 };
+
+   fail_if(pud_init() != PUD_TRUE);
+
+   p = pud_open(TESTS_SOURCE_DIR"/libpud/cibola.pud", PUD_OPEN_MODE_RW);
+   fail_if(p == NULL);
+
+   memset(&c1, 0, sizeof(c1));
+   memset(&c2, 0, sizeof(c2));
+   fail_if(pud_change_callback_add(p, _change_cb, &c1) != PUD_TRUE);
+   fail_if(pud_change_callback_add(p, _change_cb, &c2) != PUD_TRUE);
+
+   /* Tiles */
+   fail_if(pud_tile_set(p, 3, 4, 0x0010) != PUD_TRUE);
+   fail_if((c1.calls != 1) || (c2.calls != 1));
+   fail_if(c1.last.type != PUD_CHANGE_TILE);
+   fail_if((c1.last.x != 3) || (c1.last.y != 4));
+   fail_if((c1.last.w != 1) || (c1.last.h != 1));
+
+   /* Randomized areas */
+   fail_if(pud_tiles_randomize(p, 0, &region) != PUD_TRUE);
+   fail_if((c1.calls != 2) || (c2.calls != 2));
+   fail_if(c1.last.type != PUD_CHANGE_TILE);
+   fail_if((c1.last.x != 1) || (c1.last.y != 2));
+   fail_if((c1.last.w != 3) || (c1.last.h != 4));
+
+   /* Invalid modifications are not notified */
+   fail_if(pud_tile_set(p, p->map_w, 0, 0x0010) != PUD_FALSE);
+   fail_if(c1.calls != 2);
+
+   /* Units */
+   fail_if(pud_unit_add(p, 10, 12, PUD_PLAYER_RED, PUD_UNIT_GREAT_HALL, 1) != PUD_TRUE);
+   fail_if((c1.calls != 3) || (c2.calls != 3));
+   fail_if(c1.last.type != PUD_CHANGE_UNIT_ADD);
+   fail_if((c1.last.x != 10) || (c1.last.y != 12));
+   fail_if((c1.last.w != 4) || (c1.last.h != 4));
+   fail_if(c1.last.unit != p->units_count - 1);
+   fail_if(p->units[c1.last.unit].type != PUD_UNIT_GREAT_HALL);
+
+   fail_if(pud_unit_move(p, c1.last.unit, 30, 31) != PUD_TRUE);
+   fail_if(c1.last.type != PUD_CHANGE_UNIT_MOVE);
+   fail_if((c1.last.x != 30) || (c1.last.y != 31));
+   fail_if((c1.last.from_x != 10) || (c1.last.from_y != 12));
+   fail_if((c1.last.w != 4) || (c1.last.h != 4));
+
+   fail_if(pud_unit_remove(p, c1.last.unit) != PUD_TRUE);
+   fail_if((c1.calls != 5) || (c2.calls != 5));
+   fail_if(c1.last.type != PUD_CHANGE_UNIT_DEL);
+   fail_if(c1.last_unit != PUD_UNIT_GREAT_HALL);
+   fail_if((c1.last.x != 30) || (c1.last.y != 31));
+   fail_if(c1.last.unit != p->units_count);
+
+   /* Removed callbacks are not called anymore */
+   fail_if(pud_change_callback_del(p, _change_cb, &c1) != PUD_TRUE);
+   fail_if(pud_change_callback_del(p, _change_cb, &c1) != PUD_FALSE);
+   fail_if(pud_tile_set(p, 0, 0, 0x0010) != PUD_TRUE);
+   fail_if((c1.calls != 5) || (c2.calls != 6));
+
+   pud_close(p);
+   pud_shutdown();
+}
+END_TEST
+
+START_TEST(change_callbacks_del)
+{
+   Pud *p;
+   Changes c1, c2, c3;
+
+   fail_if(pud_init() != PUD_TRUE);
+
+   p = pud_open(TESTS_SOURCE_DIR"/libpud/cibola.pud", PUD_OPEN_MODE_RW);
+   fail_if(p == NULL);
+
+   memset(&c1, 0, sizeof(c1));
+   memset(&c2, 0, sizeof(c2));
+   memset(&c3, 0, sizeof(c3));
+   fail_if(pud_change_callback_add(p, _change_once_cb, &c1) != PUD_TRUE);
+   fail_if(pud_change_callback_add(p, _change_cb, &c2) != PUD_TRUE);
+   fail_if(pud_change_callback_add(p, _change_once_cb, &c3) != PUD_TRUE);
+
+   /* The callbacks that follow one that removes itself still fire */
+   fail_if(pud_tile_set(p, 0, 0, 0x0010) != PUD_TRUE);
+   fail_if((c1.calls != 1) || (c2.calls != 1) || (c3.calls != 1));
+
+   /* And the removed ones are gone */
+   fail_if(pud_tile_set(p, 0, 0, 0x0010) != PUD_TRUE);
+   fail_if((c1.calls != 1) || (c2.calls != 2) || (c3.calls != 1));
+   fail_if(pud_change_callback_del(p, _change_once_cb, &c1) != PUD_FALSE);
+   fail_if(pud_change_callback_del(p, _change_cb, &c2) != PUD_TRUE);
+
+   pud_close(p);
+   pud_shutdown();
+}
+END_TEST
+
+void
+test_change(TCase *tc)
+{
+   tcase_add_test(tc, change_callbacks);
+   tcase_add_test(tc, change_callbacks_del);
+}
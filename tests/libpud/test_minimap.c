@@ -0,0 +1,291 @@
+#include "tests.h"
+#include <pud.h>
+
+START_TEST(minimap_colors)
+{
+   Pud *p;
+   unsigned char *rgba, *argb, *covered;
+   unsigned int size, i, x, y;
+   const Pud_Unit_Info *u;
+   Pud_Color c;
+   uint16_t tile;
+   const unsigned char *px;
+   Pud_Era era;
+
+   fail_if(pud_init() != PUD_TRUE);
+
+   p = pud_open(TESTS_SOURCE_DIR"/libpud/cibola.pud", PUD_OPEN_MODE_RW);
+   fail_if(p == NULL);
+
+   /* Tiles covered by units have the color of the unit */
+   covered = calloc(p->tiles, 1);
+   fail_if(covered == NULL);
+   for (i = 0; i < p->units_count; i++)
+     {
+        u = &(p->units[i]);
+        for (y = u->y; y < u->y + p->units_descr[u->type].size_h; y++)
+          for (x = u->x; x < u->x + p->units_descr[u->type].size_w; x++)
+            covered[y * p->map_w + x] = 1;
+     }
+
+   /* Each pixel is the color of its tile, in both pixel formats */
+   for (era = PUD_ERA_FOREST; era <= PUD_ERA_SWAMP; era++)
+     {
+        pud_era_set(p, era);
+
+        rgba = pud_minimap_bitmap_generate(p, &size, PUD_PIXEL_FORMAT_RGBA);
+        argb = pud_minimap_bitmap_generate(p, NULL, PUD_PIXEL_FORMAT_ARGB);
+        fail_if((rgba == NULL) || (argb == NULL));
+        fail_if(size != p->tiles * 4);
+
+        for (i = 0; i < p->tiles; i++)
+          {
+             if (covered[i]) continue;
+
+             tile = pud_tile_get(p, i % p->map_w, i / p->map_w);
+             c = pud_minimap_tile_to_color(era, tile);
+             px = &(rgba[i * 4]);
+             fail_if((px[0] != c.r) || (px[1] != c.g) ||
+                     (px[2] != c.b) || (px[3] != c.a));
+             px = &(argb[i * 4]);
+             fail_if((px[0] != c.b) || (px[1] != c.g) ||
+                     (px[2] != c.r) || (px[3] != c.a));
+          }
+        free(rgba);
+        free(argb);
+     }
+
+   free(covered);
+
+   /* Unknown tiles are flashy */
+   c = pud_minimap_tile_to_color(PUD_ERA_FOREST, 0xffff);
+   fail_if((c.r != 0xff) || (c.g != 0x00) || (c.b != 0xff));
+
+   pud_close(p);
+   pud_shutdown();
+}
+END_TEST
+
+START_TEST(minimap_render)
+{
+   Pud *p;
+   unsigned char *full, *tiles, *dst;
+   unsigned int x, y, k, i, sum, stride, units;
+   const unsigned char *px;
+   uint16_t rgb565;
+
+   fail_if(pud_init() != PUD_TRUE);
+
+   p = pud_open(TESTS_SOURCE_DIR"/libpud/cibola.pud", PUD_OPEN_MODE_RW);
+   fail_if(p == NULL);
+
+   /* A unit sticking out of the map is clipped */
+   fail_if(pud_unit_add(p, p->map_w - 1, p->map_h - 1, PUD_PLAYER_RED,
+                        PUD_UNIT_GREAT_HALL, 1) != PUD_TRUE);
+
+   full = pud_minimap_bitmap_generate(p, NULL, PUD_PIXEL_FORMAT_RGBA);
+   fail_if(full == NULL);
+   tiles = malloc(p->tiles * 4);
+   fail_if(tiles == NULL);
+   fail_if(pud_minimap_render(p, tiles, p->map_w, p->map_h, 0,
+                              PUD_PIXEL_FORMAT_RGBA,
+                              PUD_MINIMAP_RENDER_NO_UNITS) != PUD_TRUE);
+   dst = malloc(p->tiles * 4 * 4);
+   fail_if(dst == NULL);
+
+   /* Same size, same pixels */
+   fail_if(pud_minimap_render(p, dst, p->map_w, p->map_h, 0,
+                              PUD_PIXEL_FORMAT_RGBA, 0) != PUD_TRUE);
+   fail_if(memcmp(dst, full, p->tiles * 4) != 0);
+
+   /* Half size: each pixel averages 2x2 tiles, unless a unit covers one
+    * of them, which then fills the pixel */
+   fail_if(pud_minimap_render(p, dst, p->map_w / 2, p->map_h / 2, 0,
+                              PUD_PIXEL_FORMAT_RGBA, 0) != PUD_TRUE);
+   for (y = 0; y < p->map_h / 2; y++)
+     for (x = 0; x < p->map_w / 2; x++)
+       {
+          px = &(dst[(y * (p->map_w / 2) + x) * 4]);
+          units = 0;
+          for (i = 0; i < 4; i++)
+            {
+               k = ((2 * y + i / 2) * p->map_w + (2 * x + i % 2)) * 4;
+               if (memcmp(&(full[k]), &(tiles[k]), 4) == 0) continue;
+               units++;
+               if (memcmp(&(full[k]), px, 4) == 0) break;
+            }
+          if (units)
+            {
+               fail_if(i == 4);
+               continue;
+            }
+          for (k = 0; k < 4; k++)
+            {
+               sum = tiles[((2 * y) * p->map_w + (2 * x)) * 4 + k] +
+                  tiles[((2 * y) * p->map_w + (2 * x + 1)) * 4 + k] +
+                  tiles[((2 * y + 1) * p->map_w + (2 * x)) * 4 + k] +
+                  tiles[((2 * y + 1) * p->map_w + (2 * x + 1)) * 4 + k];
+               fail_if(px[k] != (sum + 2) / 4);
+            }
+       }
+
+   /* Double size: each tile is a 2x2 block */
+   fail_if(pud_minimap_render(p, dst, p->map_w * 2, p->map_h * 2, 0,
+                              PUD_PIXEL_FORMAT_RGBA, 0) != PUD_TRUE);
+   for (y = 0; y < p->map_h * 2; y++)
+     for (x = 0; x < p->map_w * 2; x++)
+       fail_if(memcmp(&(dst[(y * p->map_w * 2 + x) * 4]),
+                      &(full[((y / 2) * p->map_w + (x / 2)) * 4]), 4) != 0);
+
+   /* Other pixel formats, with padded rows left untouched */
+   stride = p->map_w * 3 + 5;
+   memset(dst, 0x42, stride * p->map_h);
+   fail_if(pud_minimap_render(p, dst, p->map_w, p->map_h, stride,
+                              PUD_PIXEL_FORMAT_RGB, 0) != PUD_TRUE);
+   for (y = 0; y < p->map_h; y++)
+     {
+        for (x = 0; x < p->map_w; x++)
+          fail_if(memcmp(&(dst[y * stride + x * 3]),
+                         &(full[(y * p->map_w + x) * 4]), 3) != 0);
+        fail_if(dst[y * stride + p->map_w * 3] != 0x42);
+     }
+
+   fail_if(pud_minimap_render(p, dst, p->map_w, p->map_h, 0,
+                              PUD_PIXEL_FORMAT_BGRA, 0) != PUD_TRUE);
+   px = &(full[((p->map_h - 1) * p->map_w + p->map_w - 1) * 4]);
+   fail_if((dst[(p->tiles - 1) * 4 + 0] != px[2]) ||
+           (dst[(p->tiles - 1) * 4 + 2] != px[0]));
+
+   fail_if(pud_minimap_render(p, dst, p->map_w, p->map_h, 0,
+                              PUD_PIXEL_FORMAT_RGB565, 0) != PUD_TRUE);
+   memcpy(&rgb565, &(dst[(p->tiles - 1) * 2]), sizeof(rgb565));
+   fail_if(rgb565 != (((px[0] >> 3) << 11) | ((px[1] >> 2) << 5) | (px[2] >> 3)));
+
+   /* Invalid arguments */
+   fail_if(pud_minimap_render(p, dst, 0, p->map_h, 0,
+                              PUD_PIXEL_FORMAT_RGBA, 0) != PUD_FALSE);
+   fail_if(pud_minimap_render(p, dst, p->map_w, p->map_h, 4,
+                              PUD_PIXEL_FORMAT_RGBA, 0) != PUD_FALSE);
+
+   free(dst);
+   free(tiles);
+   free(full);
+   pud_close(p);
+   pud_shutdown();
+}
+END_TEST
+
+static void
+_minimap_check(const Pud         *p,
+               const Pud_Minimap *mm,
+               Pud_Pixel_Format   pfmt,
+               unsigned char     *ref)
+{
+   const unsigned char *px;
+   unsigned int stride;
+
+   px = pud_minimap_pixels_get(mm, &stride);
+   fail_if(px == NULL);
+   fail_if(stride != p->map_w * pud_pixel_format_size_get(pfmt));
+   fail_if(pud_minimap_render(p, ref, p->map_w, p->map_h, 0, pfmt, 0) != PUD_TRUE);
+   fail_if(memcmp(px, ref, stride * p->map_h) != 0);
+}
+
+START_TEST(minimap_live)
+{
+   Pud *p;
+   Pud_Minimap *rgba, *rgb565;
+   unsigned char *ref;
+   unsigned int x, y, w, h, i;
+
+   fail_if(pud_init() != PUD_TRUE);
+
+   p = pud_open(TESTS_SOURCE_DIR"/libpud/cibola.pud", PUD_OPEN_MODE_RW);
+   fail_if(p == NULL);
+
+   ref = malloc(p->tiles * 4);
+   fail_if(ref == NULL);
+   rgba = pud_minimap_new(p, PUD_PIXEL_FORMAT_RGBA);
+   rgb565 = pud_minimap_new(p, PUD_PIXEL_FORMAT_RGB565);
+   fail_if((rgba == NULL) || (rgb565 == NULL));
+   _minimap_check(p, rgba, PUD_PIXEL_FORMAT_RGBA, ref);
+
+   /* The first damage is the whole map */
+   fail_if(pud_minimap_damage_get(rgba, &x, &y, &w, &h) != PUD_TRUE);
+   fail_if((x != 0) || (y != 0) || (w != p->map_w) || (h != p->map_h));
+   fail_if(pud_minimap_damage_get(rgba, NULL, NULL, NULL, NULL) != PUD_FALSE);
+
+   /* Tiles */
+   fail_if(pud_tile_set(p, 5, 7, 0x0010) != PUD_TRUE);
+   fail_if(pud_minimap_damage_get(rgba, &x, &y, &w, &h) != PUD_TRUE);
+   fail_if((x != 5) || (y != 7) || (w != 1) || (h != 1));
+   _minimap_check(p, rgba, PUD_PIXEL_FORMAT_RGBA, ref);
+
+   /* Overlapping units, one sticking out of the map */
+   fail_if(pud_unit_add(p, 20, 20, PUD_PLAYER_RED, PUD_UNIT_GREAT_HALL, 1) != PUD_TRUE);
+   fail_if(pud_unit_add(p, 22, 22, PUD_PLAYER_BLUE, PUD_UNIT_FARM, 1) != PUD_TRUE);
+   fail_if(pud_unit_add(p, p->map_w - 1, 0, PUD_PLAYER_GREEN,
+                        PUD_UNIT_TOWN_HALL, 1) != PUD_TRUE);
+   _minimap_check(p, rgba, PUD_PIXEL_FORMAT_RGBA, ref);
+
+   /* A tile under a unit keeps the color of the unit */
+   fail_if(pud_tile_set(p, 21, 21, 0x0020) != PUD_TRUE);
+   _minimap_check(p, rgba, PUD_PIXEL_FORMAT_RGBA, ref);
+
+   /* Moves and removals uncover the units and tiles under them */
+   fail_if(pud_unit_move(p, p->units_count - 2, 40, 41) != PUD_TRUE);
+   fail_if(pud_minimap_damage_get(rgba, NULL, NULL, NULL, NULL) != PUD_TRUE);
+   _minimap_check(p, rgba, PUD_PIXEL_FORMAT_RGBA, ref);
+   fail_if(pud_unit_remove(p, p->units_count - 3) != PUD_TRUE);
+   _minimap_check(p, rgba, PUD_PIXEL_FORMAT_RGBA, ref);
+   for (i = 0; i < 5; i++)
+     fail_if(pud_unit_remove(p, 0) != PUD_TRUE);
+   _minimap_check(p, rgba, PUD_PIXEL_FORMAT_RGBA, ref);
+   _minimap_check(p, rgb565, PUD_PIXEL_FORMAT_RGB565, ref);
+
+   /* Invalid modifications */
+   fail_if(pud_unit_remove(p, p->units_count) != PUD_FALSE);
+   fail_if(pud_unit_move(p, 0, p->map_w, 0) != PUD_FALSE);
+
+   /* Same with the occupancy grid, drawing the units in order */
+   fail_if(pud_units_grid_enable(p, PUD_TRUE) != PUD_TRUE);
+   fail_if(pud_unit_add(p, 30, 30, PUD_PLAYER_RED, PUD_UNIT_GREAT_HALL, 1) != PUD_TRUE);
+   fail_if(pud_unit_add(p, 32, 32, PUD_PLAYER_BLUE, PUD_UNIT_FARM, 1) != PUD_TRUE);
+   fail_if(pud_tile_set(p, 32, 32, 0x0020) != PUD_TRUE);
+   _minimap_check(p, rgba, PUD_PIXEL_FORMAT_RGBA, ref);
+   fail_if(pud_unit_move(p, p->units_count - 2, 33, 33) != PUD_TRUE);
+   _minimap_check(p, rgba, PUD_PIXEL_FORMAT_RGBA, ref);
+   fail_if(pud_unit_remove(p, p->units_count - 1) != PUD_TRUE);
+   _minimap_check(p, rgba, PUD_PIXEL_FORMAT_RGBA, ref);
+
+   /* More units in a repainted area than can be looked up at once */
+   for (i = 0; i < 100; i++)
+     fail_if(pud_unit_add(p, 10, 10, i % 8, PUD_UNIT_PEASANT, 1) != PUD_TRUE);
+   fail_if(pud_tile_set(p, 10, 10, 0x0020) != PUD_TRUE);
+   _minimap_check(p, rgba, PUD_PIXEL_FORMAT_RGBA, ref);
+   fail_if(pud_units_grid_enable(p, PUD_FALSE) != PUD_TRUE);
+
+   /* Unnotified modifications require a refresh */
+   pud_era_set(p, PUD_ERA_WINTER);
+   fail_if(pud_minimap_refresh(rgba) != PUD_TRUE);
+   _minimap_check(p, rgba, PUD_PIXEL_FORMAT_RGBA, ref);
+
+   pud_minimap_free(rgb565);
+   pud_minimap_free(rgba);
+
+   /* Freed minimaps do not follow the Pud anymore */
+   fail_if(pud_tile_set(p, 0, 0, 0x0010) != PUD_TRUE);
+
+   free(ref);
+   pud_close(p);
+   pud_shutdown();
+}
+END_TEST
+
+void
+test_minimap(TCase *tc)
+{
+   tcase_add_test(tc, minimap_colors);
+   tcase_add_test(tc, minimap_render);
+   tcase_add_test(tc, minimap_live);
+}
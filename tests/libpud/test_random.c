@@ -0,0 +1,85 @@
+#include "tests.h"
+#include <pud.h>
+
+static uint16_t
+_variants_get(uint16_t tile)
+{
+   uint16_t mask = 0;
+   unsigned int i;
+
+   /* The variants pud_random_tile_get() may give */
+   for (i = 0; i < 200; i++)
+     mask |= 1 << pud_random_tile_get(tile);
+   return mask;
+}
+
+START_TEST(random_tiles)
+{
+   Pud *p;
+   uint16_t *orig, *first;
+   const size_t size = 128 * 128 * sizeof(uint16_t);
+   const Pud_Rect region = { 10, 20, 30, 40 };
+   const Pud_Rect invalid = { 100, 0, 29, 1 };
+   unsigned int i, x, y;
+   uint16_t tile;
+
+   fail_if(pud_init() != PUD_TRUE);
+
+   p = pud_open(TESTS_SOURCE_DIR"/libpud/cibola.pud", PUD_OPEN_MODE_RW);
+   fail_if(p == NULL);
+   fail_if(p->tiles != 128 * 128);
+
+   orig = malloc(size);
+   first = malloc(size);
+   fail_if((orig == NULL) || (first == NULL));
+   memcpy(orig, p->tiles_map, size);
+
+   /* Only the variants change, and they are valid */
+   fail_if(pud_tiles_randomize(p, 42, NULL) != PUD_TRUE);
+   for (i = 0; i < p->tiles; i++)
+     {
+        tile = p->tiles_map[i];
+        fail_if((tile & 0xfff0) != (orig[i] & 0xfff0));
+        if (tile != orig[i])
+          fail_if(!(_variants_get(tile) & (1 << (tile & 0xf))));
+     }
+   memcpy(first, p->tiles_map, size);
+
+   /* The same seed gives the same map */
+   memcpy(p->tiles_map, orig, size);
+   fail_if(pud_tiles_randomize(p, 42, NULL) != PUD_TRUE);
+   fail_if(memcmp(first, p->tiles_map, size) != 0);
+   fail_if(pud_tiles_randomize(p, 43, NULL) != PUD_TRUE);
+   fail_if(memcmp(first, p->tiles_map, size) == 0);
+
+   /* Nothing changes out of the region */
+   memcpy(p->tiles_map, orig, size);
+   fail_if(pud_tiles_randomize(p, 7, &region) != PUD_TRUE);
+   for (y = 0; y < p->map_h; y++)
+     for (x = 0; x < p->map_w; x++)
+       {
+          if ((x >= region.x) && (x < region.x + region.w) &&
+              (y >= region.y) && (y < region.y + region.h))
+            continue;
+          fail_if(p->tiles_map[y * p->map_w + x] != orig[y * p->map_w + x]);
+       }
+
+   fail_if(pud_tiles_randomize(p, 7, &invalid) != PUD_FALSE);
+
+   /* Invalid tiles have no variants */
+   fail_if(pud_random_tile_get(0x00d0) != 0x00);
+   fail_if(pud_random_tile_get(0x1010) != 0x00);
+   fail_if(_variants_get(0x0010) != 0x00ee);
+
+   free(first);
+   free(orig);
+   pud_close(p);
+   pud_shutdown();
+}
+END_TEST
+
+void
+test_random(TCase *tc)
+{
+   tcase_add_test(tc, random_tiles);
+}
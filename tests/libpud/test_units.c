@@ -0,0 +1,237 @@
+#include "tests.h"
+#include <pud.h>
+
+typedef struct
+{
+   unsigned int adds;
+   unsigned int dels;
+   unsigned int moves;
+   Pud_Change last;
+} Counts;
+
+static void
+_change_cb(void             *data,
+           Pud              *pud,
+           const Pud_Change *change)
+{
+   Counts *const c = data;
+
+   (void) pud;
+   switch (change->type)
+     {
+      case PUD_CHANGE_UNIT_ADD: c->adds++; break;
+      case PUD_CHANGE_UNIT_DEL: c->dels++; break;
+      case PUD_CHANGE_UNIT_MOVE: c->moves++; break;
+      default: break;
+     }
+   c->last = *change;
+}
+
+START_TEST(units_storage)
+{
+   Pud *p;
+   Pud_Unit_Info *units, last;
+   Counts c;
+   unsigned int i, count;
+   const unsigned int n = 10000;
+
+   fail_if(pud_init() != PUD_TRUE);
+
+   p = pud_open(TESTS_SOURCE_DIR"/libpud/cibola.pud", PUD_OPEN_MODE_RW);
+   fail_if(p == NULL);
+   memset(&c, 0, sizeof(c));
+   fail_if(pud_change_callback_add(p, _change_cb, &c) != PUD_TRUE);
+
+   units = calloc(n, sizeof(Pud_Unit_Info));
+   fail_if(units == NULL);
+   for (i = 0; i < n; i++)
+     {
+        units[i].x = i % p->map_w;
+        units[i].y = (i / p->map_w) % p->map_h;
+        units[i].type = PUD_UNIT_FOOTMAN;
+        units[i].player = i % 8;
+        units[i].alter = 1;
+     }
+
+   /* Bulk insertion */
+   count = p->units_count;
+   fail_if(pud_units_reserve(p, count + n) != PUD_TRUE);
+   fail_if(pud_units_add_array(p, units, n) != PUD_TRUE);
+   fail_if(p->units_count != count + n);
+   fail_if(memcmp(&(p->units[count]), units, n * sizeof(Pud_Unit_Info)) != 0);
+   fail_if(c.adds != n);
+   fail_if(c.last.unit != p->units_count - 1);
+
+   /* Nothing is added when a unit is out of the map */
+   units[n / 2].y = p->map_h;
+   fail_if(pud_units_add_array(p, units, n) != PUD_FALSE);
+   fail_if(p->units_count != count + n);
+   fail_if(c.adds != n);
+   fail_if(pud_units_add_array(p, NULL, 0) != PUD_TRUE);
+
+   /* Units added one by one come after the others */
+   for (i = 0; i < 1000; i++)
+     fail_if(pud_unit_add(p, i % p->map_w, 3, PUD_PLAYER_RED,
+                          PUD_UNIT_PEASANT, 1) != PUD_TRUE);
+   fail_if(p->units_count != count + n + 1000);
+   fail_if(p->units[p->units_count - 1].type != PUD_UNIT_PEASANT);
+
+   /* The last unit takes the place of the removed one */
+   last = p->units[p->units_count - 1];
+   fail_if(pud_unit_remove(p, 5) != PUD_TRUE);
+   fail_if(memcmp(&(p->units[5]), &last, sizeof(last)) != 0);
+   fail_if(p->units_count != count + n + 999);
+   fail_if((c.dels != 1) || (c.moves != 1));
+   fail_if((c.last.type != PUD_CHANGE_UNIT_MOVE) || (c.last.unit != 5));
+   fail_if((c.last.x != last.x) || (c.last.from_x != last.x));
+
+   /* Removing the last unit moves nothing */
+   fail_if(pud_unit_remove(p, p->units_count - 1) != PUD_TRUE);
+   fail_if((c.dels != 2) || (c.moves != 1));
+
+   while (p->units_count)
+     fail_if(pud_unit_remove(p, 0) != PUD_TRUE);
+   fail_if(pud_unit_remove(p, 0) != PUD_FALSE);
+   fail_if(pud_unit_add(p, 0, 0, PUD_PLAYER_RED, PUD_UNIT_PEASANT, 1) != PUD_TRUE);
+   fail_if(p->units_count != 1);
+
+   free(units);
+   pud_close(p);
+   pud_shutdown();
+}
+END_TEST
+
+static int
+_index_cmp(const void *a,
+           const void *b)
+{
+   const unsigned int ia = *(const unsigned int *)a;
+   const unsigned int ib = *(const unsigned int *)b;
+
+   return (ia > ib) - (ia < ib);
+}
+
+/* Units that intersect a rectangle, the slow way */
+static unsigned int
+_units_find(const Pud      *p,
+            const Pud_Rect *r,
+            unsigned int   *indexes)
+{
+   const Pud_Unit_Info *u;
+   unsigned int i, w, h, found = 0;
+
+   for (i = 0; i < p->units_count; i++)
+     {
+        u = &(p->units[i]);
+        w = p->units_descr[u->type].size_w;
+        h = p->units_descr[u->type].size_h;
+        if ((u->x < r->x + r->w) && (u->y < r->y + r->h) &&
+            (u->x + w > r->x) && (u->y + h > r->y))
+          indexes[found++] = i;
+     }
+   return found;
+}
+
+static void
+_grid_check(const Pud    *p,
+            unsigned int *a,
+            unsigned int *b)
+{
+   Pud_Rect r;
+   unsigned int i, n;
+
+   for (i = 0; i < 200; i++)
+     {
+        r.x = rand() % p->map_w;
+        r.y = rand() % p->map_h;
+        r.w = 1 + rand() % 6;
+        r.h = 1 + rand() % 6;
+        if (r.x + r.w > p->map_w) r.w = p->map_w - r.x;
+        if (r.y + r.h > p->map_h) r.h = p->map_h - r.y;
+
+        n = _units_find(p, &r, a);
+        fail_if(pud_units_in_rect(p, &r, b, p->units_count) != n);
+        qsort(b, n, sizeof(unsigned int), _index_cmp);
+        fail_if(memcmp(a, b, n * sizeof(unsigned int)) != 0);
+        fail_if(pud_footprint_free(p, &r) != (n == 0));
+
+        r.w = r.h = 1;
+        n = _units_find(p, &r, a);
+        fail_if(pud_units_at(p, r.x, r.y, b, p->units_count) != n);
+        qsort(b, n, sizeof(unsigned int), _index_cmp);
+        fail_if(memcmp(a, b, n * sizeof(unsigned int)) != 0);
+        fail_if(pud_units_at(p, r.x, r.y, NULL, 0) != n);
+     }
+}
+
+START_TEST(units_grid)
+{
+   static const Pud_Unit types[] = {
+      PUD_UNIT_FOOTMAN, PUD_UNIT_FARM, PUD_UNIT_GREAT_HALL,
+      PUD_UNIT_GOLD_MINE, PUD_UNIT_GRYPHON_RIDER,
+   };
+   Pud *p;
+   Pud_Unit_Info units[500];
+   const Pud_Rect out = { 126, 0, 4, 1 };
+   const Pud_Rect in = { 126, 0, 2, 1 };
+   const Pud_Rect none = { 0, 0, 0, 0 };
+   unsigned int *a, *b, i, step;
+
+   fail_if(pud_init() != PUD_TRUE);
+
+   p = pud_open(TESTS_SOURCE_DIR"/libpud/cibola.pud", PUD_OPEN_MODE_RW);
+   fail_if(p == NULL);
+   a = malloc(10000 * sizeof(unsigned int));
+   b = malloc(10000 * sizeof(unsigned int));
+   fail_if((a == NULL) || (b == NULL));
+   srand(42);
+
+   /* Without the grid, then with it */
+   _grid_check(p, a, b);
+   fail_if(pud_units_grid_enable(p, PUD_TRUE) != PUD_TRUE);
+   _grid_check(p, a, b);
+
+   /* The grid follows the modifications of the units */
+   for (step = 0; step < 20; step++)
+     {
+        for (i = 0; i < 500; i++)
+          {
+             units[i].x = rand() % p->map_w;
+             units[i].y = rand() % p->map_h;
+             units[i].type = types[rand() % (sizeof(types) / sizeof(types[0]))];
+             units[i].player = PUD_PLAYER_RED;
+             units[i].alter = 1;
+          }
+        fail_if(pud_units_add_array(p, units, 1 + rand() % 500) != PUD_TRUE);
+        for (i = 0; i < 100; i++)
+          fail_if(pud_unit_move(p, rand() % p->units_count, rand() % p->map_w,
+                                rand() % p->map_h) != PUD_TRUE);
+        for (i = 0; (i < 150) && (p->units_count); i++)
+          fail_if(pud_unit_remove(p, rand() % p->units_count) != PUD_TRUE);
+        _grid_check(p, a, b);
+     }
+
+   /* Disabled again */
+   fail_if(pud_units_grid_enable(p, PUD_FALSE) != PUD_TRUE);
+   _grid_check(p, a, b);
+
+   /* Out of the map is never free */
+   fail_if(pud_footprint_free(p, &out) != PUD_FALSE);
+   fail_if(pud_footprint_free(p, &none) != PUD_FALSE);
+
+   /* Queries are clipped to the map */
+   fail_if(pud_units_in_rect(p, &out, NULL, 0) != pud_units_in_rect(p, &in, NULL, 0));
+
+   free(a);
+   free(b);
+   pud_close(p);
+   pud_shutdown();
+}
+END_TEST
+
+void
+test_units(TCase *tc)
+{
+   tcase_add_test(tc, units_storage);
+   tcase_add_test(tc, units_grid);
+}
@@ -3,6 +3,10 @@
 static const Efl_Test_Case etc[] = {
      { "Standalone", test_standalone },
      { "Open", test_open },
+     { "Change", test_change },
+     { "Minimap", test_minimap },
+     { "Random", test_random },
+     { "Units", test_units },
      { NULL, NULL }
 };
 
@@ -5,5 +5,9 @@
 
 void test_standalone(TCase *tc);
 void test_open(TCase *tc);
+void test_change(TCase *tc);
+void test_minimap(TCase *tc);
+void test_random(TCase *tc);
+void test_units(TCase *tc);
 
 #endif
@@ -6,6 +6,7 @@
  */
 
 #include "war2.h"
+#include "surface.h"
 #include "debug.h"
 
 #include <Eet.h>
@@ -69,31 +70,23 @@ _icons_cb(void                          *data EINA_UNUSED,
           const War2_Sprites_Descriptor *ts EINA_UNUSED,
           uint16_t                       img_nb)
 {
-   Eina_Tmpstr *file;
-   int fd;
    const int px = 0, py = img_nb * ICON_H;
    cairo_surface_t *img;
 
    if ((w != ICON_W) || (h != ICON_H)) return;
 
-   fd = eina_file_mkstemp("tmp.atlas-XXXXXX.png", &file);
-   if (EINA_UNLIKELY(fd < 0))
+   img = surface_from_sprite(tile, w, h);
+   if (cairo_surface_status(img) != CAIRO_STATUS_SUCCESS)
      {
-        fprintf(stderr, "*** Failed to create temporary file\n");
+        fprintf(stderr, "*** Failed to convert icon %u\n", img_nb);
+        cairo_surface_destroy(img);
         return;
      }
-   close(fd);
-   war2_png_write(file, w, h, (unsigned char *)tile);
-
-   img = cairo_image_surface_create_from_png(file);
 
    cairo_set_source_surface(_cairo.cr, img, px, py);
    cairo_mask_surface(_cairo.cr, img, px, py);
    cairo_fill(_cairo.cr);
    cairo_surface_destroy(img);
-
-   ecore_file_unlink(file);
-   eina_tmpstr_del(file);
 }
 
 int
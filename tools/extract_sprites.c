@@ -6,6 +6,7 @@
 
 #include "ppm.h"
 #include "war2.h"
+#include "surface.h"
 
 #include <Eet.h>
 #include <cairo.h>
@@ -52,11 +53,9 @@ _unit_cb(void                          *fdata  EINA_UNUSED,
    char key[64], key2[64];
    const Pud_Unit u = ud->object;
    unsigned int i;
-   int fd;
    const int compress = 1;
    Eina_Bool ok;
    cairo_surface_t *img;
-   Eina_Tmpstr *file;
    int cw, ch;
 
    /* Only handle the 5 first images [0,4] */
@@ -72,17 +71,13 @@ _unit_cb(void                          *fdata  EINA_UNUSED,
           return;
      }
 
-   fd = eina_file_mkstemp("tmp.sprites-XXXXXX.png", &file);
-   if (EINA_UNLIKELY(fd < 0))
+   img = surface_from_sprite(sprite, w, h);
+   if (cairo_surface_status(img) != CAIRO_STATUS_SUCCESS)
      {
-        fprintf(stderr, "*** Failed to create temporary file\n");
+        fprintf(stderr, "*** Failed to convert sprite %u\n", img_nb);
+        cairo_surface_destroy(img);
         return;
      }
-   close(fd);
-
-   war2_png_write(file, w, h, (unsigned char *)sprite);
-
-   img = cairo_image_surface_create_from_png(file);
    cairo_surface_flush(img);
    data = cairo_image_surface_get_data(img);
    cw = cairo_image_surface_get_width(img);
@@ -150,8 +145,6 @@ _unit_cb(void                          *fdata  EINA_UNUSED,
 #endif
 
    cairo_surface_destroy(img);
-   ecore_file_unlink(file);
-   eina_tmpstr_del(file);
 }
 
 static void
@@ -168,24 +161,19 @@ _building_cb(void                          *fdata  EINA_UNUSED,
    int bytes;
    char key[32];
    cairo_surface_t *img;
-   Eina_Tmpstr *file;
-   int fd, cw, ch;
+   int cw, ch;
    const int compress = 1;
 
    /* Only handle the first image */
    if (img_nb > 0) return;
 
-   fd = eina_file_mkstemp("tmp.sprites-XXXXXX.png", &file);
-   if (EINA_UNLIKELY(fd < 0))
+   img = surface_from_sprite(sprite, w, h);
+   if (cairo_surface_status(img) != CAIRO_STATUS_SUCCESS)
      {
-        fprintf(stderr, "*** Failed to create temporary file\n");
+        fprintf(stderr, "*** Failed to convert sprite %u\n", img_nb);
+        cairo_surface_destroy(img);
         return;
      }
-   close(fd);
-
-   war2_png_write(file, w, h, (unsigned char *)sprite);
-
-   img = cairo_image_surface_create_from_png(file);
    cairo_surface_flush(img);
    data = cairo_image_surface_get_data(img);
    cw = cairo_image_surface_get_width(img);
@@ -200,8 +188,6 @@ _building_cb(void                          *fdata  EINA_UNUSED,
      fprintf(stderr, "*** Failed to save key [%s]\n", key);
 
    cairo_surface_destroy(img);
-   ecore_file_unlink(file);
-   eina_tmpstr_del(file);
 
 #if 0
    /* Quick and dirty debug */
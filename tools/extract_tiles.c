@@ -12,10 +12,6 @@
 # include <Eet.h>
 #endif
 
-#ifdef HAVE_CAIRO
-# include <cairo.h>
-#endif
-
 #include <Ecore_File.h>
 #include <unistd.h>
 
@@ -35,23 +31,17 @@ static Export_Type _export_type;
 static Eet_File *_ef = NULL;
 #endif
 
-#ifdef HAVE_CAIRO
-typedef struct
-{
-   cairo_surface_t *img;
-   cairo_t *cr;
-   char *png;
-} Cairo_Ctx;
-
-static Cairo_Ctx _cairo;
-#endif
+static War2_Atlas *_atlas = NULL;
+static char _atlas_path[1024];
 
 static void
 _open_era(const char *era)
 {
    char my_getcwd[1024];
    char my_path2[1024];
+#ifdef HAVE_EET
    char my_path[1024];
+#endif
 
    if (_export_type == EET)
      {
@@ -65,18 +55,13 @@ _open_era(const char *era)
      }
    else if (_export_type == ATLAS)
      {
-#ifdef HAVE_CAIRO
-        _cairo.img = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
-                                                0x10 * TILE_H,
-                                                14 * 9 * TILE_W + 0xc * TILE_W);
-        _cairo.cr = cairo_create(_cairo.img);
+        /* 16 tiles per row */
+        _atlas = war2_atlas_new(0x10 * TILE_W, 0);
 
         snprintf(my_path2, sizeof(my_path2),
                  "%s/tiles/atlas", getcwd(my_getcwd, sizeof(my_getcwd)));
         ecore_file_mkpath(my_path2);
-        snprintf(my_path, sizeof(my_path), "%s/%s.png", my_path2, era);
-        _cairo.png = strdup(my_path);
-#endif
+        snprintf(_atlas_path, sizeof(_atlas_path), "%s/%s", my_path2, era);
      }
 }
 
@@ -91,10 +76,36 @@ _close_current_era(void)
      }
    else if (_export_type == ATLAS)
      {
-        cairo_surface_write_to_png(_cairo.img, _cairo.png);
-        cairo_destroy(_cairo.cr);
-        cairo_surface_destroy(_cairo.img);
-        free(_cairo.png);
+        char path[1200];
+        const War2_Atlas_Rect *rects;
+        const Pud_Color *bitmap;
+        unsigned int w, h, count, i;
+        FILE *f;
+
+        if ((!_atlas) || (!war2_atlas_pack(_atlas)))
+          {
+             fprintf(stderr, "*** Failed to pack atlas %s\n", _atlas_path);
+             goto end;
+          }
+
+        bitmap = war2_atlas_bitmap_get(_atlas, &w, &h);
+        snprintf(path, sizeof(path), "%s.png", _atlas_path);
+        war2_png_write(path, w, h, (const unsigned char *)bitmap);
+
+        /* One line per tile: tile x y w h */
+        snprintf(path, sizeof(path), "%s.txt", _atlas_path);
+        f = fopen(path, "w");
+        if (f)
+          {
+             rects = war2_atlas_rects_get(_atlas, &count);
+             for (i = 0; i < count; i++)
+               fprintf(f, "0x%04x %u %u %u %u\n", rects[i].id,
+                       rects[i].x, rects[i].y, rects[i].w, rects[i].h);
+             fclose(f);
+          }
+end:
+        war2_atlas_free(_atlas);
+        _atlas = NULL;
      }
 }
 
@@ -118,7 +129,7 @@ _era2str(Pud_Era era)
 }
 
 static void
-_export_tile_png(void               *func_data EINA_UNUSED,
+_export_tile_png(void               *func_data,
                  const Pud_Color    *tile,
                  unsigned int        w,
                  unsigned int        h,
@@ -134,10 +145,9 @@ _export_tile_png(void               *func_data EINA_UNUSED,
             "%s/tiles/png/%s", getcwd(buf3, sizeof(buf3)), _era2str(ts->era));
    ecore_file_mkpath(buf);
    snprintf(buf2, sizeof(buf2), "%s/0x%04x.png", buf, img_nb);
-   war2_png_write(buf2, w, h, (unsigned char *)tile);
+   war2_encoder_write(func_data, buf2, w, h, (const unsigned char *)tile);
 }
 
-#ifdef HAVE_CAIRO
 static void
 _export_tile_atlas(void *func_data EINA_UNUSED,
                    const Pud_Color *tile,
@@ -146,49 +156,11 @@ _export_tile_atlas(void *func_data EINA_UNUSED,
                    const War2_Tileset_Descriptor *ts EINA_UNUSED,
                    uint16_t img_nb)
 {
-   Eina_Tmpstr *file;
-   int fd;
-   int major, minor;
-   int x, y;
-   cairo_surface_t *img;
-   const unsigned int solid_offset = (0xd + 1) * 0x9 * 32;
-
    /* Fog of war */
    if (img_nb < 16) return;
 
-   fd = eina_file_mkstemp("tmp.atlas-XXXXXX.png", &file);
-   if (EINA_UNLIKELY(fd < 0))
-     {
-        fprintf(stderr, "*** Failed to create temporary file\n");
-        return;
-     }
-   close(fd);
-   war2_png_write(file, w, h, (unsigned char *)tile);
-
-   major = (img_nb & 0x0f00) >> 8;
-   minor = (img_nb & 0x00f0) >> 4;
-   if (major == 0) /* solid tiles */
-     {
-        y = solid_offset + ((minor - 1) * TILE_H);
-        x = (img_nb & 0x000f) * TILE_W;
-     }
-   else
-     {
-        y = ((major - 1) * TILE_H * (0xd + 1)) + (minor * TILE_H);
-        x = (img_nb & 0x000f) * TILE_W;
-     }
-
-   img = cairo_image_surface_create_from_png(file);
-
-   cairo_set_source_surface(_cairo.cr, img, x, y);
-   cairo_mask_surface(_cairo.cr, img, x, y);
-   cairo_fill(_cairo.cr);
-   cairo_surface_destroy(img);
-
-   ecore_file_unlink(file);
-   eina_tmpstr_del(file);
+   war2_atlas_add_frame(_atlas, img_nb, tile, w, h, 0, 0);
 }
-#endif
 
 #ifdef HAVE_EET
 static void
@@ -247,6 +219,7 @@ main(int    argc,
    int ret = EXIT_FAILURE;
    char buf[1024];
    War2_Tileset_Decode_Func func;
+   War2_Encoder *enc = NULL;
    const char *dest;
 
    if (argc >= 3)
@@ -295,39 +268,37 @@ main(int    argc,
 
       case ATLAS:
          dest = "atlas";
-#ifdef HAVE_CAIRO
          func = _export_tile_atlas;
-#else
-         fprintf(stderr, "*** ATLAS not supported (no cairo)\n");
-         goto deinit;
-#endif
          break;
 
       case PNG:
       default:
          dest = "png";
          func = _export_tile_png;
+         /* A single encoder for all the tiles */
+         enc = war2_encoder_new(WAR2_ENCODER_FORMAT_PNG, NULL);
+         if (!enc) goto deinit;
          break;
      }
 
 
    _open_era("forest");
-   tiles = war2_tileset_decode(w2, PUD_ERA_FOREST, func, NULL);
+   tiles = war2_tileset_decode(w2, PUD_ERA_FOREST, func, enc);
    if (!tiles) DIE_RETURN(2, "Failed to decode tileset FOREST");
    _close_current_era();
 
    _open_era("winter");
-   tiles = war2_tileset_decode(w2, PUD_ERA_WINTER, func, NULL);
+   tiles = war2_tileset_decode(w2, PUD_ERA_WINTER, func, enc);
    if (!tiles) DIE_RETURN(2, "Failed to decode tileset WINTER");
    _close_current_era();
 
    _open_era("wasteland");
-   tiles = war2_tileset_decode(w2, PUD_ERA_WASTELAND, func, NULL);
+   tiles = war2_tileset_decode(w2, PUD_ERA_WASTELAND, func, enc);
    if (!tiles) DIE_RETURN(2, "Failed to decode tileset WASTELAND");
    _close_current_era();
 
    _open_era("swamp");
-   tiles = war2_tileset_decode(w2, PUD_ERA_SWAMP, func, NULL);
+   tiles = war2_tileset_decode(w2, PUD_ERA_SWAMP, func, enc);
    if (!tiles) DIE_RETURN(2, "Failed to decode tileset SWAMP");
    _close_current_era();
 
@@ -337,6 +308,7 @@ main(int    argc,
 
    goto deinit; /* This is just here to silent a pointless warning */
 deinit:
+   war2_encoder_free(enc);
    war2_close(w2);
    war2_shutdown();
    ecore_file_shutdown();
@@ -38,7 +38,7 @@ struct _Sprite
    int y;
    unsigned int w;
    unsigned int h;
-   Pud_Color *data;
+   unsigned char *data; /* Palette indexes */
    Sprite *next;
 };
 
@@ -47,6 +47,7 @@ typedef struct
    Pud_Unit unit;
    Sprite sprites;
    unsigned int sprites_count;
+   Pud_Color palette[WAR2_PALETTE_SIZE];
    Eina_Tmpstr *file;
    const char *path;
 } Unit;
@@ -66,9 +67,9 @@ static const Animation _animations[] =
 static void
 _unit_sprite_add(Unit *u, int x, int y,
                  unsigned int w, unsigned int h,
-                 const Pud_Color *data)
+                 const unsigned char *data)
 {
-   const size_t size = w * h * sizeof(Pud_Color);
+   const size_t size = w * h;
    Sprite *const s = malloc(sizeof(Sprite));
 
    s->x = x;
@@ -124,7 +125,7 @@ _draw(const Unit *u,
         cairo_transform(cr, &mat);
      }
 
-   war2_png_write(u->file, s->w, s->h, (unsigned char *)s->data);
+   war2_png_write_indexed(u->file, s->w, s->h, s->data, u->palette, 0);
    im = cairo_image_surface_create_from_png(u->file);
 
 
@@ -228,7 +229,9 @@ _decode_sprite_cb(void                          *fdata,
 {
    Unit *const unit = fdata;
 
-   _unit_sprite_add(unit, x, y, w, h, sprite);
+   /* Frames are kept as palette indexes, which are 4 times smaller */
+   memcpy(unit->palette, ud->palette, sizeof(unit->palette));
+   _unit_sprite_add(unit, x, y, w, h, ud->indexes);
 }
 
 int
@@ -283,8 +286,9 @@ main(int                argc,
                      .path = path,
                   };
 
-                  if (war2_sprites_decode(w2, color - 1, era, object,
-                                          _decode_sprite_cb, &unit))
+                  if (war2_sprites_decode_full(w2, color - 1, era, object,
+                                               WAR2_SPRITES_DECODE_INDEXED,
+                                               _decode_sprite_cb, &unit))
                     {
                        if (pud_unit_building_is(object))
                          {
@@ -311,8 +315,9 @@ main(int                argc,
            .path = "animations",
         };
         ecore_file_mkpath(unit.path);
-        war2_sprites_decode_entry(w2, PUD_PLAYER_RED, a->section,
-                                  _decode_sprite_cb, &unit);
+        war2_sprites_decode_entry_full(w2, PUD_PLAYER_RED, a->section,
+                                       WAR2_SPRITES_DECODE_INDEXED,
+                                       _decode_sprite_cb, &unit);
         _animation_process(&unit);
         _unit_clean(&unit);
      }
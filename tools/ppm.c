@@ -26,8 +26,9 @@ ppm_parse(const char *file,
    char comment = 0;
    int w = 0, h = 0;
    char col_st = 0;
+   char binary = 0;
 
-   f = fopen(file, "r");
+   f = fopen(file, "rb");
    if (!f)
      {
         fprintf(stderr, "*** Failed to open [%s]\n", file);
@@ -54,15 +55,16 @@ ppm_parse(const char *file,
                   buf[k] = 0;
                   if (status == 0)
                     {
-                       /* Find PP3 */
-                       if (strncmp(buf, "P3", 2) &&
-                           strncmp(buf, "p3", 2))
+                       /* Find P3 (ASCII) or P6 (binary) */
+                       if (!strncmp(buf, "P6", 2) || !strncmp(buf, "p6", 2))
+                         binary = 1;
+                       else if (strncmp(buf, "P3", 2) &&
+                                strncmp(buf, "p3", 2))
                          {
                             fprintf(stderr, "*** Missing header\n");
                             goto end;
                          }
-                       else
-                         status++;
+                       status++;
                     }
                   else if (status == 1)
                     {
@@ -89,6 +91,28 @@ ppm_parse(const char *file,
                             fprintf(stderr, "*** Failed to alloc\n");
                             goto end;
                          }
+
+                       /* Raw pixels follow the single whitespace that
+                        * ended the header */
+                       if (binary)
+                         {
+                            for (i = 0; i < w * h; i++)
+                              {
+                                 unsigned char rgb[3];
+
+                                 if (fread(rgb, 1, 3, f) != 3)
+                                   {
+                                      fprintf(stderr, "*** Truncated file\n");
+                                      free(ptr);
+                                      ptr = NULL;
+                                      goto end;
+                                   }
+                                 ptr[i].r = rgb[0];
+                                 ptr[i].g = rgb[1];
+                                 ptr[i].b = rgb[2];
+                              }
+                            break;
+                         }
                     }
                   else
                     {
@@ -0,0 +1,55 @@
+/*
+ * surface.c
+ *
+ * Copyright (c) 2016 Jean Guyomarc'h
+ */
+
+#include "surface.h"
+
+#include <stdint.h>
+
+/* Rounds like the PNG loader of cairo */
+static inline uint32_t
+_premul(unsigned int c,
+        unsigned int a)
+{
+   const unsigned int t = c * a + 0x80;
+   return (t + (t >> 8)) >> 8;
+}
+
+cairo_surface_t *
+surface_from_sprite(const Pud_Color *sprite,
+                    unsigned int     w,
+                    unsigned int     h)
+{
+   cairo_surface_t *img;
+   const Pud_Color *c;
+   unsigned char *data;
+   uint32_t *row;
+   unsigned int x, y;
+   int stride;
+
+   img = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, w, h);
+   if (cairo_surface_status(img) != CAIRO_STATUS_SUCCESS)
+     return img;
+
+   /* Cairo wants native-endian words with premultiplied alpha */
+   cairo_surface_flush(img);
+   data = cairo_image_surface_get_data(img);
+   stride = cairo_image_surface_get_stride(img);
+   for (y = 0; y < h; y++)
+     {
+        row = (uint32_t *)(data + (size_t)y * stride);
+        for (x = 0; x < w; x++)
+          {
+             c = &(sprite[y * w + x]);
+             row[x] = ((uint32_t)c->a << 24) |
+                (_premul(c->r, c->a) << 16) |
+                (_premul(c->g, c->a) << 8) |
+                _premul(c->b, c->a);
+          }
+     }
+   cairo_surface_mark_dirty(img);
+
+   return img;
+}
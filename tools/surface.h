@@ -0,0 +1,20 @@
+/*
+ * surface.h
+ *
+ * Copyright (c) 2016 Jean Guyomarc'h
+ */
+
+#ifndef _SURFACE_H_
+#define _SURFACE_H_
+
+#include <cairo.h>
+
+#include "pud.h"
+
+/*
+ * Creates a cairo image surface (ARGB32) from RGBA pixels. Check the
+ * result with cairo_surface_status(), and destroy it in all cases.
+ */
+cairo_surface_t *surface_from_sprite(const Pud_Color *sprite, unsigned int w, unsigned int h);
+
+#endif /* ! _SURFACE_H_ */
@@ -0,0 +1,273 @@
+/*
+ * Copyright (c) 2017 Jean Guyomarc'h
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Compares war2_tileset_decode() against a reference decoder, which
+ * resolves the flips of the minitiles pixel per pixel. Both must deliver
+ * exactly the same tiles.
+ */
+
+#include <war2.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct
+{
+   uint32_t hash;
+   unsigned int tiles;
+   Pud_Bool verify;
+} Bench;
+
+static const struct {
+   const Pud_Era era;
+   const char *const str;
+   const unsigned int entries[3];
+} _eras[] = {
+     { PUD_ERA_FOREST,    "forest",    {   3,   4,   5 } },
+     { PUD_ERA_WINTER,    "winter",    {  19,  20,  21 } },
+     { PUD_ERA_WASTELAND, "wasteland", {  11,  12,  13 } },
+     { PUD_ERA_SWAMP,     "swamp",     { 439, 440, 441 } },
+};
+
+static double
+_now(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void
+_bench_tile(Bench           *b,
+            const Pud_Color *img,
+            uint16_t         tile)
+{
+   const unsigned char *bytes = (const unsigned char *)img;
+   unsigned int i;
+
+   b->tiles++;
+   if (!b->verify)
+     {
+        /* Touch the tile, so the decoding cannot be optimized out */
+        b->hash += bytes[tile & 0xfff];
+        return;
+     }
+
+   /* FNV-1a on the tile ID and its pixels */
+   b->hash = (b->hash ^ tile) * 16777619u;
+   for (i = 0; i < 1024 * sizeof(Pud_Color); i++)
+     b->hash = (b->hash ^ bytes[i]) * 16777619u;
+}
+
+static void
+_decode_cb(void                          *data,
+           const Pud_Color               *img,
+           unsigned int                   w,
+           unsigned int                   h,
+           const War2_Tileset_Descriptor *ts,
+           uint16_t                       tile)
+{
+   (void) w;
+   (void) h;
+   (void) ts;
+   _bench_tile(data, img, tile);
+}
+
+static void
+_ref_tile_decode(Bench               *b,
+                 const Pud_Color     *palette,
+                 const unsigned char *info,
+                 const unsigned char *minitiles,
+                 const unsigned char *map,
+                 uint16_t             tile)
+{
+   const int ft[8] = { 7, 6, 5, 4, 3, 2, 1, 0 };
+   const Pud_Color black = { 0, 0, 0, 0xff };
+   Pud_Color img[1024];
+   int j, i_img, off, offset, o, x, y, xb, yb;
+   Pud_Bool flip_x, flip_y;
+
+   off = ((tile >> 4) * 42) + ((tile & 0xf) * 2);
+   offset = 0;
+   memcpy(&offset, &(map[off]), sizeof(uint16_t));
+   offset *= 32;
+   if (offset == 0) return;
+
+   for (j = 0, i_img = 0; j < 32; j += 2, i_img++)
+     {
+        o = 0;
+        memcpy(&o, &(info[offset + j]), sizeof(uint16_t));
+        flip_x = o & 2;
+        flip_y = o & 1;
+        o = (o & 0xfffc) * 16;
+
+        for (y = 0; y < 8; y++)
+          for (x = 0; x < 8; x++)
+            {
+               xb = x + ((i_img % 4) * 8);
+               yb = y + ((i_img / 4) * 8);
+               img[xb + 32 * yb] =
+                  palette[minitiles[o + ((flip_x ? ft[x] : x) +
+                                         (flip_y ? ft[y] : y) * 8)]];
+            }
+     }
+   if (memcmp(&(img[0]), &black, 3))
+     _bench_tile(b, img, tile);
+}
+
+static Pud_Bool
+_ref_decode(War2_Data          *w2,
+            Pud_Era             era,
+            const unsigned int *entries,
+            Bench              *b)
+{
+   unsigned char *info, *minitiles, *map;
+   const Pud_Color *palette;
+   unsigned int i, j, k;
+
+   palette = war2_palette_get(w2, era);
+   info = war2_entry_extract(w2, entries[0], NULL);
+   minitiles = war2_entry_extract(w2, entries[1], NULL);
+   map = war2_entry_extract(w2, entries[2], NULL);
+   if ((!palette) || (!info) || (!minitiles) || (!map))
+     {
+        free(info);
+        free(minitiles);
+        free(map);
+        return PUD_FALSE;
+     }
+
+   for (j = 0x1; j <= 0xc; j++)
+     for (i = 0; i <= 0xf; i++)
+       _ref_tile_decode(b, palette, info, minitiles, map, (j * 0x10) + i);
+   for (j = 0x1; j <= 0x9; j++)
+     for (i = 0x0; i <= 0xd; i++)
+       for (k = 0x0; k <= 0xf; k++)
+         _ref_tile_decode(b, palette, info, minitiles, map,
+                          (j * 0x100) + (i * 0x10) + k);
+
+   free(info);
+   free(minitiles);
+   free(map);
+   return PUD_TRUE;
+}
+
+int
+main(int    argc,
+     char **argv)
+{
+   War2_Data *w2;
+   Bench ref, lib;
+   double t0, t_ref, t_lib;
+   unsigned int e, n, iterations = 20;
+   int ret = EXIT_FAILURE;
+
+   if ((argc != 2) && (argc != 3))
+     {
+        fprintf(stderr, "*** Usage: %s <maindat.war> [iterations]\n", argv[0]);
+        return 1;
+     }
+   if (argc == 3) iterations = strtoul(argv[2], NULL, 10);
+   if (iterations == 0) iterations = 1;
+
+   war2_init();
+   w2 = war2_open(argv[1]);
+   if (!w2)
+     {
+        fprintf(stderr, "*** Failed to open '%s'\n", argv[1]);
+        goto end;
+     }
+
+   printf("%-10s %8s %12s %12s %8s\n",
+          "era", "tiles", "ref (ms)", "lib (ms)", "speedup");
+   for (e = 0; e < sizeof(_eras) / sizeof(_eras[0]); e++)
+     {
+        /* First check that both decoders agree... */
+        memset(&ref, 0, sizeof(ref));
+        memset(&lib, 0, sizeof(lib));
+        ref.verify = lib.verify = PUD_TRUE;
+        if (!_ref_decode(w2, _eras[e].era, _eras[e].entries, &ref))
+          {
+             fprintf(stderr, "*** Failed to decode %s\n", _eras[e].str);
+             goto close;
+          }
+        war2_tileset_decode(w2, _eras[e].era, _decode_cb, &lib);
+        if ((ref.hash != lib.hash) || (ref.tiles != lib.tiles))
+          {
+             fprintf(stderr, "*** %s: tiles differ (%u vs %u)\n",
+                     _eras[e].str, ref.tiles, lib.tiles);
+             goto close;
+          }
+
+        /* ... then time them */
+        ref.verify = lib.verify = PUD_FALSE;
+        t0 = _now();
+        for (n = 0; n < iterations; n++)
+          _ref_decode(w2, _eras[e].era, _eras[e].entries, &ref);
+        t_ref = (_now() - t0) * 1000.0 / iterations;
+
+        t0 = _now();
+        for (n = 0; n < iterations; n++)
+          war2_tileset_decode(w2, _eras[e].era, _decode_cb, &lib);
+        t_lib = (_now() - t0) * 1000.0 / iterations;
+
+        printf("%-10s %8u %12.3f %12.3f %7.2fx\n", _eras[e].str,
+               ref.tiles / (iterations + 1), t_ref, t_lib,
+               (t_lib > 0.0) ? t_ref / t_lib : 0.0);
+     }
+
+   /* All the eras, one after the other then on all the CPUs */
+   memset(&ref, 0, sizeof(ref));
+   memset(&lib, 0, sizeof(lib));
+   t0 = _now();
+   for (n = 0; n < iterations; n++)
+     for (e = 0; e < sizeof(_eras) / sizeof(_eras[0]); e++)
+       war2_tileset_decode(w2, _eras[e].era, _decode_cb, &ref);
+   t_ref = (_now() - t0) * 1000.0 / iterations;
+
+   t0 = _now();
+   for (n = 0; n < iterations; n++)
+     war2_tileset_decode_parallel(w2, WAR2_ERA_MASK_ALL, 0, PUD_TRUE,
+                                  _decode_cb, &lib);
+   t_lib = (_now() - t0) * 1000.0 / iterations;
+
+   if (ref.tiles != lib.tiles)
+     {
+        fprintf(stderr, "*** parallel: tiles differ (%u vs %u)\n",
+                ref.tiles / iterations, lib.tiles / iterations);
+        goto close;
+     }
+   printf("%-10s %8u %12.3f %12.3f %7.2fx\n", "parallel",
+          lib.tiles / iterations, t_ref, t_lib,
+          (t_lib > 0.0) ? t_ref / t_lib : 0.0);
+
+   ret = EXIT_SUCCESS;
+close:
+   war2_close(w2);
+end:
+   war2_shutdown();
+   return ret;
+}